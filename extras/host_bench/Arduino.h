@@ -0,0 +1,54 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : Arduino.h
+  * @brief          : host replacement of Arduino core for host_bench.cpp
+  ******************************************************************************
+  * @attention
+  *
+  *   just enough for the portable modules (calendar, fmt, misc, disp_tile,
+  *   glyph_cache, disp_layout, disp_clock, clcd_buf). ARDUINO is not defined,
+  *   so U8g2 builds without Print / Wire / SPI.
+  *   millis() / micros() : simulated clock source, set by the bench.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+#define PROGMEM
+
+/* Macros --------------------------------------------------------------------*/
+#define noInterrupts()
+#define interrupts()
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint32_t host_dwMillis;
+
+/* Functions prototypes ------------------------------------------------------*/
+static inline uint32_t millis(void)  { return host_dwMillis; }
+static inline uint32_t micros(void)  { return host_dwMillis * 1000UL; }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HOST_ARDUINO_H__ */
@@ -0,0 +1,33 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : LiquidCrystal_I2C.h
+  * @brief          : host CLCD sink for host_bench.cpp
+  ******************************************************************************
+  * @attention
+  *
+  *   counts what clcd_buf.cpp sends : cursor commands & characters.
+  *   on target, each of them is 4 PCF8574 bytes (two 4-bit nibbles, E strobe).
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __HOST_LIQUIDCRYSTAL_I2C_H__
+#define __HOST_LIQUIDCRYSTAL_I2C_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+
+/* Types ---------------------------------------------------------------------*/
+class LiquidCrystal_I2C {
+  public:
+    uint32_t  dwCmds  = 0;
+    uint32_t  dwChars = 0;
+
+    void    setCursor(uint8_t bCol, uint8_t bRow)   { (void)bCol; (void)bRow; dwCmds++; }
+    size_t  write(uint8_t bChar)                    { (void)bChar; dwChars++; return 1; }
+};
+
+#endif /* __HOST_LIQUIDCRYSTAL_I2C_H__ */
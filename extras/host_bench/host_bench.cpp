@@ -0,0 +1,374 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : host_bench.cpp
+  * @brief          : host benchmark & check of rendering and time paths
+  ******************************************************************************
+  * @attention
+  *
+  *   runs the firmware modules (not copies) over every second of a year :
+  *     calendar    : calendar_update() / calendar_get_midnight()
+  *                   (= utc_timestamp_to_date() / GetTodayBaseTimeStamp())
+  *     oled xxx    : disp_clock_render() + disp_tile_flush(), per layout
+  *     clcd 20x4   : clcd_layout_20x4_t::render()
+  *   and reports ns/frame, heap allocations/frame and bytes sent to the
+  *   display per frame. calendar & "hh:mm:ss" are checked against libc
+  *   gmtime_r() / strftime(), exit code 1 on mismatch.
+  *
+  *   root page is a constant PROGMEM string (nothing is generated), so it is
+  *   not measured.
+  *
+  *   build (Linux / glibc, from repository root) :
+  *     mkdir -p /tmp/hb && unzip -q -o extras/U8g2-2.34.22.zip -d /tmp/hb
+  *     U=/tmp/hb/U8g2-2.34.22/src
+  *     gcc -O2 -c -I$U/clib $U/clib/u8g2_*.c $U/clib/u8x8_*.c
+  *     gcc -O2 -Wall -Wextra -c -Iextras/host_bench -Isource -I$U source/calendar.c source/fmt.c source/misc.c
+  *     ar rcs /tmp/hb/libhb.a *.o && rm -f *.o
+  *     g++ -std=gnu++17 -O2 -Wall -Wextra -DFW_VER=3 -Iextras/host_bench -Isource -I$U -I$U/clib \
+  *         extras/host_bench/host_bench.cpp source/disp_tile.cpp source/glyph_cache.cpp \
+  *         source/disp_clock.cpp source/clcd_buf.cpp $U/U8g2lib.cpp /tmp/hb/libhb.a -o /tmp/hb/host_bench
+  *     /tmp/hb/host_bench [year [step_sec]]
+  *
+  *   -DDISP_LAYOUT_OLED_128X32 (all files) : 128x32 layout set.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include <LiquidCrystal_I2C.h>
+#include <stdio.h>
+#include <time.h>
+#include <chrono>
+#include <new>
+#include "calendar.h"
+#include "fmt.h"
+#include "i2c_bus.h"
+#include "disp_tile.h"
+#include "glyph_cache.h"
+#include "disp_layout.h"
+#include "disp_clock.h"
+#include "clcd_buf.h"
+
+/* Defines -------------------------------------------------------------------*/
+#ifndef FW_VER
+#define FW_VER                        0       // pass -DFW_VER=n (same as sketch)
+#endif
+
+#define BENCH_YEAR_DEFAULT            2025
+#define BENCH_SENSOR_PERIOD_SEC       2       // sensor source : new value every 2 sec
+#define BENCH_CIVIL_DAY_MAX           49710   // 2106-02-07, end of 32-bit epoch
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+typedef struct {
+	const char  *szName;
+	uint64_t    qwNs;
+	uint64_t    qwAllocs;
+	uint64_t    qwBytes;
+	uint32_t    dwFrames;
+} bench_result_t;
+
+/* Variables -----------------------------------------------------------------*/
+extern "C" {
+uint32_t                host_dwMillis     = 0;
+}
+
+static uint64_t         qwSinkBytes       = 0;      // display sink
+static uint64_t         qwAllocs          = 0;
+static uint8_t          bCountAllocs      = 0;
+
+static const char       *szWeekday[8]     = { "", "MON", "TUE", "WED", "THU", "FRI", "SAT", "SUN" };
+
+/* Function prototypes -------------------------------------------------------*/
+
+/* User code -----------------------------------------------------------------*/
+
+/*** allocation counter (C++ new & glibc malloc) ***/
+
+extern "C" void *__libc_malloc(size_t nSize);
+extern "C" void *__libc_calloc(size_t n, size_t nSize);
+extern "C" void *__libc_realloc(void *p, size_t nSize);
+
+extern "C" void *malloc(size_t nSize)               { if(bCountAllocs) qwAllocs++; return __libc_malloc(nSize); }
+extern "C" void *calloc(size_t n, size_t nSize)     { if(bCountAllocs) qwAllocs++; return __libc_calloc(n, nSize); }
+extern "C" void *realloc(void *p, size_t nSize)     { if(bCountAllocs) qwAllocs++; return __libc_realloc(p, nSize); }
+void *operator new(size_t nSize)                    { if(bCountAllocs) qwAllocs++; return __libc_malloc(nSize ? nSize : 1); }
+void *operator new[](size_t nSize)                  { if(bCountAllocs) qwAllocs++; return __libc_malloc(nSize ? nSize : 1); }
+void operator delete(void *p) noexcept              { free(p); }
+void operator delete[](void *p) noexcept            { free(p); }
+void operator delete(void *p, size_t) noexcept      { free(p); }
+void operator delete[](void *p, size_t) noexcept    { free(p); }
+
+
+/*** bus arbitration : single host "bus", always free ***/
+
+uint8_t i2c_bus_acquire(uint8_t dev)  { (void)dev; return 1; }
+void    i2c_bus_release(uint8_t dev)  { (void)dev; }
+
+
+/*** display sink ***/
+
+/**
+  * @brief      u8x8 byte callback : count bytes instead of sending them
+  */
+static uint8_t host_byte_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+  (void)u8x8;
+  (void)arg_ptr;
+
+  if(U8X8_MSG_BYTE_SEND == msg)
+    qwSinkBytes += arg_int;
+  return 1;
+}
+
+static uint8_t host_gpio_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+  (void)u8x8; (void)msg; (void)arg_int; (void)arg_ptr;
+  return 1;
+}
+
+/**
+  * @brief      same controller & buffer as sketch, bytes go to host_byte_cb()
+  */
+class U8G2_HOST : public U8G2 {
+  public:
+    U8G2_HOST(void) : U8G2()
+    {
+#if defined(DISP_LAYOUT_OLED_128X32)
+      u8g2_Setup_ssd1306_i2c_128x32_univision_f(&u8g2, U8G2_R0, host_byte_cb, host_gpio_cb);
+#else
+      u8g2_Setup_ssd1306_i2c_128x64_noname_f(&u8g2, U8G2_R0, host_byte_cb, host_gpio_cb);
+#endif
+    }
+};
+
+static U8G2_HOST          u8g2;
+static LiquidCrystal_I2C  lcd;
+
+
+/*** sources ***/
+
+/**
+  * @brief      sensor source : deterministic slow waveform
+  */
+static void bench_sensor_source(uint32_t dwEpoch)
+{
+  uint32_t dwStep = (dwEpoch / BENCH_SENSOR_PERIOD_SEC) % 400;
+  int32_t  lTri   = (dwStep < 200) ? (int32_t)dwStep : (int32_t)(400 - dwStep);   // 0 ~ 200
+
+  fmt_set_temp(-500 + (lTri * 17));     // -5.00 ~ 29.00 'C
+  fmt_set_humid(3000 + (lTri * 25));    // 30.00 ~ 80.00 %
+}
+
+static uint32_t bench_year_start(uint16_t wYear)
+{
+  struct tm t;
+
+  memset(&t, 0, sizeof(t));
+  t.tm_year = wYear - 1900;
+  t.tm_mday = 1;
+  return (uint32_t)timegm(&t);
+}
+
+
+/*** checks ***/
+
+/**
+  * @brief      calendar & time string vs libc, every dwStep seconds
+  * @return     number of mismatches
+  */
+static uint32_t bench_check_calendar(uint32_t dwStart, uint32_t dwEnd, uint32_t dwStep)
+{
+  uint32_t    dwErr = 0;
+  datetime_t  datetime;
+  struct tm   t;
+  char        szRef[16];
+
+  // date of every day until end of 32-bit epoch
+  for(uint32_t dwDay = 0; dwDay <= BENCH_CIVIL_DAY_MAX; dwDay++)
+  {
+    time_t    tRef = (time_t)dwDay * CALENDAR_ONE_DAY;
+    uint16_t  wYear, wDoy;
+    uint8_t   bMonth, bDay;
+
+    gmtime_r(&tRef, &t);
+    calendar_civil_from_days(dwDay, &wYear, &bMonth, &bDay, &wDoy);
+    if( (wYear != (t.tm_year + 1900)) || (bMonth != (t.tm_mon + 1)) || (bDay != t.tm_mday) || (wDoy != t.tm_yday) )
+    {
+      if(dwErr++ < 5)
+        printf("  civil day %u : %u-%u-%u (%u), libc %d-%d-%d (%d)\n", dwDay, wYear, bMonth, bDay, wDoy,
+               t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_yday);
+    }
+  }
+
+  for(uint32_t dwEpoch = dwStart; dwEpoch < dwEnd; dwEpoch += dwStep)
+  {
+    time_t tRef = dwEpoch;
+
+    gmtime_r(&tRef, &t);
+    calendar_update(dwEpoch, &datetime);
+
+    uint8_t bOk = (datetime.year    == (t.tm_year + 1900))                &&
+                  (datetime.month   == (t.tm_mon + 1))                    &&
+                  (datetime.day     == t.tm_mday)                         &&
+                  (datetime.hour    == t.tm_hour)                         &&
+                  (datetime.minute  == t.tm_min)                          &&
+                  (datetime.second  == t.tm_sec)                          &&
+                  (datetime.weekday == (((t.tm_wday + 6) % 7) + 1))       &&
+                  (calendar_get_midnight() == (dwEpoch - (t.tm_hour * 3600 + t.tm_min * 60 + t.tm_sec)));
+
+    strftime(szRef, sizeof(szRef), "%Y-%m-%d", &t);
+    bOk = bOk && (0 == strcmp(szRef, calendar_get_date_str()));
+    strftime(szRef, sizeof(szRef), "%H:%M:%S", &t);
+    bOk = bOk && (0 == strcmp(szRef, fmt_get_time(dwEpoch)));
+
+    if(!bOk)
+    {
+      if(dwErr++ < 5)
+        printf("  epoch %u : %s %s, libc %s\n", dwEpoch, calendar_get_date_str(), fmt_get_time(dwEpoch), szRef);
+    }
+  }
+
+  return dwErr;
+}
+
+
+/*** benchmarks ***/
+
+static void bench_begin(void)
+{
+  qwAllocs      = 0;
+  bCountAllocs  = 1;
+}
+
+static void bench_end(bench_result_t *pRes, std::chrono::steady_clock::time_point tStart, uint64_t qwBytes)
+{
+  bCountAllocs    = 0;
+  pRes->qwNs      = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tStart).count();
+  pRes->qwAllocs  = qwAllocs;
+  pRes->qwBytes   = qwBytes;
+}
+
+static void bench_calendar(bench_result_t *pRes, uint32_t dwStart, uint32_t dwEnd, uint32_t dwStep)
+{
+  volatile uint32_t dwSink = 0;
+  datetime_t        datetime;
+
+  pRes->szName    = "calendar";
+  pRes->dwFrames  = 0;
+
+  bench_begin();
+  auto tStart = std::chrono::steady_clock::now();
+  for(uint32_t dwEpoch = dwStart; dwEpoch < dwEnd; dwEpoch += dwStep)
+  {
+    calendar_update(dwEpoch, &datetime);
+    dwSink += dwEpoch - calendar_get_midnight();
+    pRes->dwFrames++;
+  }
+  bench_end(pRes, tStart, 0);
+}
+
+static void bench_oled(bench_result_t *pRes, const char *szName, uint8_t bLayout, uint32_t dwStart, uint32_t dwEnd, uint32_t dwStep)
+{
+  datetime_t datetime;
+
+  pRes->szName    = szName;
+  pRes->dwFrames  = 0;
+
+  // screen as after boot : clock zone is cleared by first frame
+  u8g2.clearBuffer();
+  disp_tile_send_all();
+  qwSinkBytes = 0;
+
+  bench_begin();
+  auto tStart = std::chrono::steady_clock::now();
+  for(uint32_t dwEpoch = dwStart; dwEpoch < dwEnd; dwEpoch += dwStep)
+  {
+    host_dwMillis = (dwEpoch - dwStart) * 1000UL;
+    if(0 == (dwEpoch % BENCH_SENSOR_PERIOD_SEC))
+      bench_sensor_source(dwEpoch);
+
+    disp_clock_render(&u8g2, dwEpoch, bLayout, szWeekday[((dwEpoch / CALENDAR_ONE_DAY) + 3) % 7 + 1], &datetime);
+    disp_tile_flush();
+    pRes->dwFrames++;
+  }
+  bench_end(pRes, tStart, qwSinkBytes);
+}
+
+static void bench_clcd(bench_result_t *pRes, uint32_t dwStart, uint32_t dwEnd, uint32_t dwStep)
+{
+  disp_layout_ctx_t ctx;
+  datetime_t        datetime;
+
+  pRes->szName    = "clcd 20x4";
+  pRes->dwFrames  = 0;
+
+  clcd_buf_init(&lcd, 20, 4);
+  lcd.dwCmds  = 0;
+  lcd.dwChars = 0;
+
+  bench_begin();
+  auto tStart = std::chrono::steady_clock::now();
+  for(uint32_t dwEpoch = dwStart; dwEpoch < dwEnd; dwEpoch += dwStep)
+  {
+    calendar_update(dwEpoch, &datetime);
+    ctx.pDisp   = &u8g2;
+    ctx.dwEpoch = dwEpoch;
+    ctx.szWday  = szWeekday[datetime.weekday];
+    clcd_layout_20x4_t::render(&ctx);
+    pRes->dwFrames++;
+  }
+  bench_end(pRes, tStart, (uint64_t)(lcd.dwCmds + lcd.dwChars) * 4);
+}
+
+static void bench_print(const bench_result_t *pRes)
+{
+  double dFrames = pRes->dwFrames ? (double)pRes->dwFrames : 1.0;
+
+  printf("%-14s %10u %10.1f %12.3f %12.2f\n", pRes->szName, pRes->dwFrames,
+         (double)pRes->qwNs / dFrames, (double)pRes->qwAllocs / dFrames, (double)pRes->qwBytes / dFrames);
+}
+
+
+int main(int argc, char *argv[])
+{
+  uint16_t        wYear   = (argc > 1) ? (uint16_t)atoi(argv[1]) : BENCH_YEAR_DEFAULT;
+  uint32_t        dwStep  = (argc > 2) ? (uint32_t)atoi(argv[2]) : 1;
+  uint32_t        dwStart = bench_year_start(wYear);
+  uint32_t        dwEnd   = bench_year_start(wYear + 1);
+  uint32_t        dwErr;
+  bench_result_t  res;
+
+  if(0 == dwStep)
+    dwStep = 1;
+
+  u8g2.begin();
+  disp_tile_init(&u8g2);
+  glyph_cache_init(&u8g2);
+
+  printf("host_bench : FW_VER %d, %u-01-01 ~ %u-12-31, every %u sec, %ux%u\n",
+         FW_VER, wYear, wYear, dwStep, u8g2.getDisplayWidth(), u8g2.getDisplayHeight());
+  printf("%-14s %10s %10s %12s %12s\n", "path", "frames", "ns/frame", "alloc/frame", "bytes/frame");
+
+  bench_calendar(&res, dwStart, dwEnd, dwStep);
+  bench_print(&res);
+  bench_oled(&res, "oled clock",   DISP_LAYOUT_CLOCK,   dwStart, dwEnd, dwStep);
+  bench_print(&res);
+  bench_oled(&res, "oled bars",    DISP_LAYOUT_BARS,    dwStart, dwEnd, dwStep);
+  bench_print(&res);
+  bench_oled(&res, "oled sensors", DISP_LAYOUT_SENSORS, dwStart, dwEnd, dwStep);
+  bench_print(&res);
+  bench_oled(&res, "oled s+bars",  DISP_LAYOUT_SENSOR_BARS, dwStart, dwEnd, dwStep);
+  bench_print(&res);
+  bench_clcd(&res, dwStart, dwEnd, dwStep);
+  bench_print(&res);
+
+  dwErr = bench_check_calendar(dwStart, dwEnd, dwStep);
+  printf("calendar vs libc : %s (%u mismatches)\n", dwErr ? "FAIL" : "OK", dwErr);
+
+  return dwErr ? 1 : 0;
+}
@@ -17,7 +17,6 @@
   *    ESP8266 board support package
   *       http://arduino.esp8266.com/stable/package_esp8266com_index.json
   *    U8g2-2.34.22
-  *    NTPClient-3.2.1
   *    AM2302-Sensor-1.3.2
   *    LiquidCrystal_I2C-1.1.2
   *    Adafruit AHTX0-2.0.5     (+incl. req. dep.)
@@ -42,7 +41,6 @@
 #include <U8g2lib.h>              // U8g2 graphic lib
 #include <ESP8266WiFi.h>          // ESP8266 Wi-Fi
 #include <WiFiUdp.h>              //
-#include <NTPClient.h>            // NTP Time
 #include <time.h>                 // for getting timestamp from date
 
 #include <AM2302-Sensor.h>        // AM2302 Sensor
@@ -51,6 +49,24 @@
 #include <Adafruit_BMP280.h>      // BMP280
 
 #include "misc.h"
+#include "disp_tile.h"
+#include "i2c_bus.h"
+#include "rtc_store.h"
+#include "sys_clock.h"
+#include "ntp_async.h"
+#include "calendar.h"
+#include "fmt.h"
+#include "sched.h"
+#include "clcd_buf.h"
+#include "sensor.h"
+#include "history.h"
+#include "sse.h"
+#include "glyph_cache.h"
+#include "prof.h"
+#include "time_mesh.h"
+#include "ota.h"
+#include "disp_layout.h"
+#include "disp_clock.h"
 
 #include <ESP8266WebServer.h>
 // #include <ESP8266WebServer-impl.h>
@@ -66,6 +82,8 @@
 // #define DBG_LOG_EN_LOOP            1
 // #define DBG_LOG_EN                 1
 // #define DBG_DISP_ALL_FOUND_AP      1
+// #define DBG_LOG_EN_PROF            1     // prof_dump() every PROF_DUMP_PERIOD_SEC
+#define PROF_DUMP_PERIOD_SEC          60
 
 
 /*** LCD Control ***/
@@ -74,10 +92,13 @@
 #define LCD_Y_OFFSET_STARTBLUE        16
 
 #define LCD_Y_INC_u8g2_font_tiny5_tr  6   // u8g2_font_tiny5_tr : 5 x 5 small
-#define LCD_X_OFFSET_CLOCK            14
-#define LCD_X_OFFSET_DATE             82
-#define LCD_Y_OFFSET_CLOCK            30
-#define LCD_Y_OFFSET_PROGRESSBAR      52
+#define LCD_WIDTH                     128
+#ifdef DISP_LAYOUT_OLED_128X32
+#define LCD_HEIGHT                    32
+#else
+#define LCD_HEIGHT                    64
+#endif
+// positions of clock screen widgets : disp_layout.h
 
 
 /*** Font ***/
@@ -94,9 +115,34 @@
 /*** Internal Macro ***/
 #define INTERVAL_WIFI_CONNECTION_CHK  10      // seconds
 #define INTERVAL_WIFI_RECONNECTION    59      // (num+1)*(INTERVAL_WIFI_CONNECTION_CHK) seconds  (set 10 min @ release)
-#define INTERVAL_GET_TIME_FROM_NET    1800    // seconds // (set 30 min @ release)
+#define INTERVAL_GET_TIME_FROM_NET    1800    // seconds // (set 30 min @ release) - initial / minimum
+#define INTERVAL_GET_TIME_FROM_NET_MAX 14400  // seconds // sync interval grows up to 4 hours while drift is stable
 #define INTERVAL_READ_SENSOR          10      // 10 seconds
 
+#define WLAN_SCAN_TIMEOUT_MS          10000   // async scan (incl. hidden SSID)
+#define WLAN_CONNECT_TIMEOUT_MS       15000   // WiFi.begin() -> WL_CONNECTED
+#define WLAN_FAST_CONNECT_TIMEOUT_MS  3000    // cached BSSID/channel, fall back to scan after this
+#define WLAN_FAST_CONNECT_STATIC_IP   0       // 1 : reuse last DHCP lease (skip DHCP) / 0 : always DHCP
+                                              //     1 only with a DHCP reservation : lease expiry is not tracked,
+                                              //     router may give the address to another host (IP conflict)
+#define BOOT_RETRY_MS                 1000    // Wi-Fi / NTP retry while booting
+
+#define PORTAL_KEY_HOLD_MS            3000    // hold FLASH key while booting to enter provisioning portal
+#define PORTAL_PORT                   80
+#define PORTAL_AP_SSID_PREFIX         "WiFi-Clock-"
+#define PORTAL_TZ_DEFAULT_SEC         32400   // GMT+9, until provisioned
+
+/*** Wi-Fi connection state machine ***/
+#define WLAN_STATE_IDLE               0
+#define WLAN_STATE_SCAN_START         1
+#define WLAN_STATE_SCAN_WAIT          2
+#define WLAN_STATE_CONNECT_START      3
+#define WLAN_STATE_CONNECT_WAIT       4
+#define WLAN_STATE_CONNECTED          5
+#define WLAN_STATE_FAILED             6
+
+#define WLAN_IS_BUSY()                ( (WLAN_STATE_SCAN_START <= g_wlan.bState) && (g_wlan.bState <= WLAN_STATE_CONNECT_WAIT) )
+
 /**
  * @brief TIMER
  *  prescaler : TIM_DIV16
@@ -108,6 +154,8 @@
  *   600000               120 ms (valid using oscilloscope)
  */
 #define ESP8266_TIMER1_CNT_VAL        500000
+#define ESP8266_TIMER1_TICK_PER_SEC   10      // 100 ms tick (ESP8266_TIMER1_CNT_VAL)
+#define ESP8266_TIMER1_PERIOD_US      (ESP8266_TIMER1_CNT_VAL / 5)  // TIM_DIV16 : 5 MHz
 #define ESP8266_FLASH_KEY             0       // FLASH key is connected with IO0. when pressed, it is LOW.
 #define ESP8266_LED_PIN               2       // LOW ON / HIGH OFF
 #define ESP8266_LED_ON                LOW
@@ -129,24 +177,89 @@
 #define CLCD_COL_NUM                  20
 #define CLCD_ROW_NUM                  4
 
+// CLCD clock screen (disp_layout.h), chosen by geometry at compile time
+typedef std::conditional<((CLCD_ROW_NUM > 2) && (CLCD_COL_NUM > 16)), clcd_layout_20x4_t, clcd_layout_16x2_t>::type clcd_layout_t;
+
+/**
+ * @brief OLED bus backend
+ * @note  default : bit-banged SW_I2C on OLED pins, CLCD & sensors on Wire (SDA/SCL).
+ *        OLED_USE_HW_I2C : OLED uses hardware Wire at fast-mode, every I2C device
+ *                          shares one bus on OLED pins and arbitrated by i2c_bus.
+ */
+// #define OLED_USE_HW_I2C            1
+#define OLED_I2C_SCL_PIN              14
+#define OLED_I2C_SDA_PIN              12
+#define OLED_I2C_BUS_CLOCK            I2C_BUS_CLOCK_FAST
+
+/**
+ * @brief Low-power operating mode
+ * @note  LOW_POWER_MODE_EN : station only (no Soft-AP beacons), modem-sleep while associated.
+ *                            radio is switched off between wake-up windows for web / API
+ *                            access and NTP sync. OLED is dimmed, CLCD backlight is off.
+ */
+// #define LOW_POWER_MODE_EN          1
+#define LOW_POWER_WEB_PERIOD_SEC      600     // radio wake-up period (web / API window)
+#define LOW_POWER_WEB_WINDOW_SEC      60      // radio stays on at least this long after wake-up
+#define LOW_POWER_RETRY_SEC           300     // radio-off time before retrying a pending time sync
+#define LOW_POWER_OLED_CONTRAST       16      // 0 ~ 255
+#define LOW_POWER_IDLE_MS             5       // delay() when no task is ready, lets SDK sleep
+
+/**
+ * @brief Time sharing between clocks on one LAN
+ * @note  TIME_MESH_EN : one elected clock asks NTP & broadcasts beacons, others sync
+ *                       from it (UDP TIME_MESH_PORT). NTP only while no leader is heard.
+ *                       see time_mesh.h
+ */
+// #define TIME_MESH_EN               1
+
+/**
+ * @brief Firmware update over Wi-Fi
+ * @note  OTA_EN : ArduinoOTA (Arduino IDE / espota.py) & HTTP upload to OTA_UPLOAD_URI.
+ *                 timer1, display, sensor & SSE work is paused while image is written,
+ *                 progress is shown on OLED. see ota.h
+ *        OTA_PASSWORD : ArduinoOTA password & HTTP basic auth (user OTA_USER).
+ *                       required with OTA_EN : build fails while it is empty.
+ */
+// #define OTA_EN                     1
+#define OTA_PASSWORD                  ""
+
+#ifdef OTA_EN
+static_assert(sizeof(OTA_PASSWORD) > 1, "OTA_EN : set OTA_PASSWORD, otherwise anyone on the LAN can flash firmware");
+#endif
+
+#ifdef OLED_USE_HW_I2C
+#define I2C_BUS_SDA_PIN               OLED_I2C_SDA_PIN
+#define I2C_BUS_SCL_PIN               OLED_I2C_SCL_PIN
+#else
+#define I2C_BUS_SDA_PIN               SDA
+#define I2C_BUS_SCL_PIN               SCL
+#endif
+
 /* Types ---------------------------------------------------------------------*/
 
+// timestamp_t, datetime_t : see calendar.h
+
 /**
-  * @brief      convert unix-time to human-readable time
-  * @note       reference : https://blog.naver.com/chandong83/222273392541
+  * @brief      last rendered state of clock screen
+  * @note       frame is skipped when nothing visible is changed.
   */
-typedef uint32_t timestamp_t; //seconds
+typedef struct {
+	uint32_t    dwEpoch;        // epoch second of last frame
+	uint8_t     bLayout;        // progress bar / sensor layout
+	uint8_t     bSensorSeq;     // sensor readout sequence number
+	uint8_t     bValid;         // 0 : nothing rendered yet
+} disp_render_state_t;
 
+/**
+  * @brief      Wi-Fi scan & connect state machine context
+  */
 typedef struct {
-	uint16_t    year;
-	uint8_t     month;
-	uint8_t     day;
-	uint8_t     hour;
-	uint8_t     minute;
-	uint8_t     second;
-	uint8_t     week;
-	uint8_t     weekday;
-} datetime_t;
+	uint8_t     bState;         // WLAN_STATE_*
+	uint8_t     bMode;          // see WLAN_Connect_Start()
+	uint8_t     bDispEn;        // display procedure on OLED
+	uint8_t     bFast;          // 1 : connect by cached SSID/BSSID/channel without scan
+	uint32_t    dwTimeStamp;    // millis() when current step is started
+} wlan_conn_t;
 
 /* Variables -----------------------------------------------------------------*/
 
@@ -156,41 +269,58 @@ char        daysOfTheWeek[7][12]  = {"SUN", "MON", "TUE", "WED", "THU", "FRI", "
 // char currHour[4];
 // char currMinute[4];
 // char currSecond[4];
-const char  *strTimeSvrURL        = "time2.kriss.re.kr";
-int         dwLocalTimeZoneOffset = 32400;          // GMT+9
-String      strCurrDate;
-String      strTimeSynced         = "CLOCK SYNCHRONIZED :)";
-String      strWiFiScanOngoing    = "SCANNING...";
-
-/*** hard-coded progress bar ***/
-extern char dispBar[60][63];
-
+#define NTP_SERVER_NUM                  3     // max. NTP_ASYNC_SERVER_MAX
+const char  *strTimeSvrList[NTP_SERVER_NUM] =     // queried together, lowest delay wins
+{
+  "time2.kriss.re.kr",
+  "time.kriss.re.kr",
+  "pool.ntp.org",
+};
+int         dwLocalTimeZoneOffset = PORTAL_TZ_DEFAULT_SEC;   // replaced by g_net_config
+const char  *strTimeSynced         = "CLOCK SYNCHRONIZED :)";
+const char  *strWiFiScanOngoing    = "SCANNING...";
 
 /*** Wi-Fi Access Point information ***/
-String      foundmyAPssid;
-const char  *my_own_ap_ssid     = "TERRA-****";
-const char  *my_own_ap_password = "****";
-String      disp_no_connection  = "OFFLINE";
-const char  *softap_password    = "****";
+char        foundmyAPssid[33];                      // max. SSID length + NUL
+net_config_t g_net_config       = {0};              // SSID / password / NTP / time zone (provisioning portal)
+uint8_t     bNetConfigValid     = 0;
+const char  *disp_no_connection  = "OFFLINE";
+const char  *softap_password    = "****";           // portal AP, open network when shorter than 8
 
 
 /*** NTP Time ***/
 WiFiUDP ntpUDP;
+#ifdef TIME_MESH_EN
+WiFiUDP meshUDP;                                    // LAN time beacons (not shared with NTP)
+#endif
 
-/*** Strings of Current Temperature & Humidity ***/
-String StrTemp;
-String StrHumid;
+/*** Strings of Current Temperature & Humidity : see fmt.h ***/
 
 /*** Internal ***/
 char              currFwVer[2];                // for string
-volatile uint32_t uptime_WiFiconnection = 0;
-volatile uint32_t uptime_WiFiLost       = 0;
-volatile uint32_t uptime_LastTimeSynced = 0;
-volatile uint32_t uptime_LastSensorRead = 0;  // AM2302
+volatile uint32_t g_dwTimerTick         = 0;  // timer1 tick counter, monotonic (written by ISR only)
+uint32_t          uptime_WiFiconnection = 0;  // uptime_WiFiconnection ~ uptime_LastTimeSynced : GetUptimeSec()
+uint32_t          uptime_WiFiLost       = 0;
+uint32_t          uptime_LastTimeSynced = 0;
+uint32_t          dwTimeSyncInterval    = INTERVAL_GET_TIME_FROM_NET;   // adaptive, by clock discipline
 volatile uint8_t  bLEDState             = 0;  // reserved
-volatile uint32_t dwFLASHKEYpressedtime = 0;
+volatile uint32_t dwFLASHKEYpressedtime = 0;  // ISR only
 
 uint8_t           bProgressBarStatus    = 0;  // 0: NOT display   / else: display
+uint8_t           bSensorReadSeq        = 0;  // increased on every sensor readout
+uint32_t          dwSensorSampleUtc     = 0;  // UTC of last sensor readout, 0 : clock not set
+disp_render_state_t g_disp_render       = {0};
+uint8_t           bClockResumed         = RTC_STORE_CLOCK_NONE;   // time at boot is from RTC memory
+uint64_t          qwResumeUtcMs         = 0;
+int32_t           lResumeDriftPpb       = 0;
+uint8_t           bRadioOn              = 1;  // 0 : radio is force-slept (LOW_POWER_MODE_EN)
+uint32_t          uptime_RadioChanged   = 0;  // GetUptimeSec() of last radio on / off
+wlan_conn_t       g_wlan                = {0};
+uint8_t           g_bTaskDisp           = SCHED_TASK_INVALID;   // task ids (sched_add()), paused during OTA
+uint8_t           g_bTaskSensor         = SCHED_TASK_INVALID;
+uint8_t           g_bTaskSse            = SCHED_TASK_INVALID;
+uint8_t           g_bTaskPower          = SCHED_TASK_INVALID;
+wlan_cache_t      g_wlan_cache          = {0};
 uint32_t          g_lcd_yPos            = 10;
 const char        *my_board_name        = "[Wi-Fi Clock]";
 const char        *my_board_name2       = "::: Wi-Fi  Clock :::";
@@ -205,6 +335,8 @@ const char        *my_board_name2       = "::: Wi-Fi  Clock :::";
  *
  *       (else)         (reserved)
  *
+ *        modified from loop() context only. requests from ISR are posted
+ *        to scheduler as events (EV_xxx).
  */
 volatile uint32_t g_state               = 0;
 
@@ -220,13 +352,50 @@ volatile uint32_t g_state               = 0;
 #define G_STATE_BIT_POS_WIFI_CONN_STATE         0
 #define G_STATE_BIT_POS_NTP_CLIENT_STATE        1   // ?
 #define G_STATE_BIT_POS_TIME_SYNC_STATE         2   // ?
-#define G_STATE_BIT_POS_CLOCK_DISP_REDRAW_REQ   16
-#define G_STATE_BIT_POS_WIFI_RECONNECT_REQ      17
-#define G_STATE_BIT_POS_WIFI_STATE_CHK_REQ      18
-#define G_STATE_BIT_POS_TIME_RESYNC_REQ         19
-#define G_STATE_BIT_POS_KEYPRESS_SHORT_REQ      20
-#define G_STATE_BIT_POS_KEYPRESS_LONG_REQ       21
-#define G_STATE_BIT_POS_SENSOR_READ_REQ         22
+
+/*** scheduler events (requests), posted by sched_post() / sched_post_isr() ***/
+#define EV_CLOCK_DISP_REDRAW_REQ                SCHED_EV(0)
+#define EV_CLOCK_DISP_FORCE_REQ                 SCHED_EV(1)   // fast path : redraw now regardless of epoch
+#define EV_WIFI_RECONNECT_REQ                   SCHED_EV(2)
+#define EV_WIFI_STATE_CHK_REQ                   SCHED_EV(3)
+#define EV_TIME_RESYNC_REQ                      SCHED_EV(4)
+#define EV_KEYPRESS_SHORT_REQ                   SCHED_EV(5)
+#define EV_KEYPRESS_LONG_REQ                    SCHED_EV(6)
+#define EV_TIMER_TICK                           SCHED_EV(8)   // every timer1 tick, interval checks
+
+/*** scheduler tasks : priority / period (ms) / deadline (ms) / budget (us) ***/
+#define TASK_DISP_PRIO                0       // second-tick render, latency critical
+#define TASK_DISP_BUDGET_US           30000
+#define TASK_KEY_PRIO                 1
+#define TASK_KEY_BUDGET_US            1000
+#define TASK_TIMER_PRIO               1
+#define TASK_TIMER_BUDGET_US          200
+#define TASK_SYS_PRIO                 1
+#define TASK_SYS_PERIOD_MS            1000
+#define TASK_WLAN_PRIO                2
+#define TASK_WLAN_PERIOD_MS           20      // scan & connect state machine step
+#define TASK_WLAN_DEADLINE_MS         500
+#define TASK_WLAN_BUDGET_US           20000
+#define TASK_NTP_PRIO                 2
+#define TASK_NTP_PERIOD_MS            10      // reply polling
+#define TASK_NTP_DEADLINE_MS          200
+#define TASK_NTP_BUDGET_US            5000
+#define TASK_SENSOR_PRIO              3
+#define TASK_SENSOR_PERIOD_MS         20      // result polling
+#define TASK_SENSOR_DEADLINE_MS       2000
+#define TASK_SENSOR_BUDGET_US         8000    // AM2302 bit-banging (~5 ms), others < 1 ms
+#define TASK_HTTP_PRIO                4
+#define TASK_HTTP_PERIOD_MS           5
+#define TASK_HTTP_DEADLINE_MS         100
+#define TASK_HTTP_BUDGET_US           50000
+#define TASK_SSE_PRIO                 4
+#define TASK_SSE_PERIOD_MS            100     // second change & new sensor readout polling
+#define TASK_SSE_BUDGET_US            5000
+#define TASK_POWER_PRIO               3
+#define TASK_POWER_PERIOD_MS          1000    // radio window check (LOW_POWER_MODE_EN)
+#define TASK_MESH_PRIO                2
+#define TASK_MESH_PERIOD_MS           10      // receive time stamp is taken on poll (TIME_MESH_EN)
+#define TASK_MESH_BUDGET_US           3000
 
 /*** (Global) Sensor ***/
 volatile uint8_t  isSensorPresent = 0;
@@ -252,11 +421,48 @@ int       is_leap_year(uint16_t year);
 void      utc_timestamp_to_date(timestamp_t timestamp, datetime_t* datetime);
 
 unsigned long GetTodayBaseTimeStamp(datetime_t *datetime);
+void      disp_clear_area(int16_t x, int16_t y, int16_t w, int16_t h);
 void      disp_ssid(uint8_t MODE);
+uint8_t   is_disp_clock_changed(void);
 void      update_disp_clock(uint8_t MODE);
 void      update_disp_clock_CLCD(uint8_t MODE);
-void      blinkInternalLED_Polling(uint32_t dwRepeatCount, uint32_t dwDelay_ms);
-uint8_t   WLAN_Connect(uint8_t MODE, uint8_t LCD_DISP_EN);
+bool      WLAN_FindMyAP(int scanResult);
+void      WLAN_Connect_Start(uint8_t MODE, uint8_t LCD_DISP_EN);
+uint8_t   WLAN_Connect_Process(void);
+void      WLAN_Save_Cache(void);
+uint8_t   boot_poll(void);
+uint8_t   portal_is_requested(void);
+void      portal_run(void);
+void      task_disp(uint32_t dwEvents);
+void      task_key(uint32_t dwEvents);
+void      task_sys(uint32_t dwEvents);
+void      task_wlan(uint32_t dwEvents);
+void      task_ntp(uint32_t dwEvents);
+void      time_sync_apply(int64_t qOffsetMs);
+void      task_mesh(uint32_t dwEvents);
+void      update_sensor_strings(void);
+void      task_sensor(uint32_t dwEvents);
+void      task_http(uint32_t dwEvents);
+void      ota_on_state(uint8_t bState, uint32_t dwDone, uint32_t dwTotal);
+void      disp_ota(uint8_t bState, uint32_t dwDone, uint32_t dwTotal);
+void      task_sse(uint32_t dwEvents);
+void      power_radio_on(void);
+void      power_radio_off(void);
+void      task_power(uint32_t dwEvents);
+void      myServer_Root(void);
+void      myServer_ApiNow(void);
+void      myServer_ApiSensors(void);
+void      myServer_ApiEvents(void);
+void      myServer_ApiStats(void);
+void      myServer_ApiHistory(void);
+static uint8_t     myServer_NotModified(const char *szETag);
+static const char *myServer_JsonCenti(char *pBuf, int32_t lCenti);
+static void        web_json_now(char *pBuf, size_t nSize, uint32_t dwUtc);
+static void        web_json_sensors(char *pBuf, size_t nSize);
+static uint8_t     disp_get_layout(void);
+
+uint32_t  GetUptimeSec(void);
+void      task_timer(uint32_t dwEvents);
 
 void ICACHE_RAM_ATTR onTimerISR();
 
@@ -269,21 +475,18 @@ void ICACHE_RAM_ATTR onTimerISR();
  * some clone boards uses different pin assign.
  * modify pin number of SCL/SDA if CLCD doesn't work.
  */
-U8G2_SSD1306_128X64_NONAME_F_SW_I2C u8g2(U8G2_R0, 14, 12, U8X8_PIN_NONE);     // case 1
+#if defined(DISP_LAYOUT_OLED_128X32)
+#ifdef OLED_USE_HW_I2C
+U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C u8g2(U8G2_R0, U8X8_PIN_NONE, OLED_I2C_SCL_PIN, OLED_I2C_SDA_PIN);
+#else
+U8G2_SSD1306_128X32_UNIVISION_F_SW_I2C u8g2(U8G2_R0, OLED_I2C_SCL_PIN, OLED_I2C_SDA_PIN, U8X8_PIN_NONE);
+#endif
+#elif defined(OLED_USE_HW_I2C)
+U8G2_SSD1306_128X64_NONAME_F_HW_I2C u8g2(U8G2_R0, U8X8_PIN_NONE, OLED_I2C_SCL_PIN, OLED_I2C_SDA_PIN);
+#else
+U8G2_SSD1306_128X64_NONAME_F_SW_I2C u8g2(U8G2_R0, OLED_I2C_SCL_PIN, OLED_I2C_SDA_PIN, U8X8_PIN_NONE);     // case 1
 // U8G2_SSD1306_128X64_NONAME_F_SW_I2C u8g2(U8G2_R0, 12, 14, U8X8_PIN_NONE);  // case 2
-
-/**
- * @brief
- * You can specify the time server pool and the offset (in seconds).
- *  to change timezone offset, use offset_sec.
- *  example) when you are in South Korea(GMT+9), offset_sec is 32400.
- *
- * You can specify the update interval (in milliseconds).
- *
- *  NTPClient timeClient(ntpUDP, "europe.pool.ntp.org", 3600, 60000);
- *                        udp / poolservername / offset_sec / updateinterval_ms
- */
-NTPClient timeClient(ntpUDP, strTimeSvrURL, dwLocalTimeZoneOffset, 60000);
+#endif
 
 /**
  * @brief
@@ -305,14 +508,14 @@ LiquidCrystal_I2C lcd(CLCD_I2C_ADDR, CLCD_ROW_NUM, CLCD_COL_NUM);
  */
 #define PORT_WEBSERVER  2000    // default : 80
 ESP8266WebServer myServer(PORT_WEBSERVER);
+const char *web_collect_headers[] = { "If-None-Match" };  // request headers kept by web server (for ETag)
 
 /**
  * @brief
  * AHTx0 & BMP280
  */
 Adafruit_BMP280   bmp280;
-Adafruit_AHTX0    ahtx0;
-sensors_event_t   aht_humid, aht_temp;
+Adafruit_AHTX0    ahtx0;                // detection & calibration only. measurement : sensor.cpp
 
 
 
@@ -342,9 +545,6 @@ typedef struct {
 // UTC 시작 시간
 #define UTC_TIME_WEEKDAY_OFFSET (4) /* 1970,1,1은 목요일이기때문에 */
 
-//날짜                    x, 1월, 2월 ..... 11월, 12월
-uint8_t month_days[13] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
-
 //타임 스탬프를 기준으로 요일 얻기
 uint8_t timestamp_to_weekday(timestamp_t timestamp_sec)
 {
@@ -365,125 +565,44 @@ int is_leap_year(uint16_t year)
 		return false;
 }
 
-//utc 타임 스탬프를 날짜로 변환
+/**
+  * @brief      utc 타임 스탬프를 날짜로 변환
+  * @param      timestamp   seconds (local time)
+  * @param      datetime    (out)
+  * @note       date part is recomputed only when the day changes (see calendar.c),
+  *             "YYYY-MM-DD" string is shared by calendar_get_date_str()
+  */
 void utc_timestamp_to_date(timestamp_t timestamp, datetime_t* datetime)
 {
-	uint8_t  month;
-	uint32_t days;
-	uint16_t days_in_year;
-	uint16_t year;
-	timestamp_t second_in_day;
-
-    // 시/분/초 계산
-	second_in_day = timestamp % ONE_DAY;
-
-	//초
-	datetime->second = second_in_day % 60;
-
-	//분
-	second_in_day /= 60;
-	datetime->minute = second_in_day % 60;
-
-	//시
-	second_in_day /= 60;
-	datetime->hour = second_in_day % 24;
-
-
-	//1970-1-1 0:0:0부터 현재까지 총 일수
-	days = timestamp / ONE_DAY;
-
-	//days를 계속 차감하면서 해당 년도 계산
-	for (year = 1970; year <= 2200; year++) {
-		if (is_leap_year(year))
-			days_in_year = 366;
-		else
-			days_in_year = 365;
-
-		if (days >= days_in_year)
-			days -= days_in_year;
-		else
-			break;
-	}
-
-	//년
-	datetime->year = year;
-
-	//요일
-	datetime->weekday = timestamp_to_weekday(timestamp);
-
-	//해당 년도 1월 1일을 기준으로 지금까지의 주(week) 계산
-	datetime->week = (days + 11 - datetime->weekday) / 7;
-
-	//월 계산하기
-	if (is_leap_year(datetime->year)) //윤달의 경우 2월이 29일이다.
-		month_days[2] = 29;
-	else
-		month_days[2] = 28;
-
-	//년도와 마찬가지로 일에서 계속 차감해서 찾는다.
-	for (month = 1; month <= 12; month++) {
-		if (days >= month_days[month])
-			days -= month_days[month];
-		else
-			break;
-	}
-	datetime->month = month;
-	datetime->day = days + 1;
-
-
-  /****    _m_ create final string for display    ****/
-  String strTmpYear, strTmpMonth, strTmpDate, strTmpWeekDay;
-
-  //    year
-  strTmpYear     = String(datetime->year);
-
-  //    month
-  if(datetime->month > 9 )
-    strTmpMonth = String(datetime->month);
-  else
-  {
-      strTmpMonth = String(0);
-      strTmpMonth += String(datetime->month);
-  }
-
-  //    day
-  if(datetime->day > 9 )
-    strTmpDate = String(datetime->day);
-  else
-  {
-      strTmpDate = String(0);
-      strTmpDate += String(datetime->day);
-  }
-
-  //    weekday
-  // strTmpWeekDay  = String ( daysOfTheWeek[datetime->weekday] );  // sunday ?
-  // strTmpWeekDay  = String ( daysOfTheWeek[timeClient.getDay()] );
-
-  //    concatenate all
-  // strCurrDate = String(strTmpYear+"-"+strTmpMonth+"-"+strTmpDate+" "+strTmpWeekDay);
-  strCurrDate = String(strTmpYear+"-"+strTmpMonth+"-"+strTmpDate);
-
+  calendar_update(timestamp, datetime);
 }
 
 
 /**
   * @brief      return timestamp of today 0:00:00
-  * @param      datetime  datetime_t
+  * @param      datetime  datetime_t (unused, kept for compatibility)
   * @return     timestamp of today 0:00:00
-  * @note       requires <time.h>
+  * @note       cached midnight of last utc_timestamp_to_date() call, no mktime()
   */
 unsigned long GetTodayBaseTimeStamp(datetime_t *datetime)
 {
-  struct tm t = {0};
+  (void)datetime;
+  return calendar_get_midnight();
+}
+
 
-  t.tm_year = datetime->year-1900;
-  t.tm_mon = datetime->month-1;
-  t.tm_mday = datetime->day;
-  t.tm_hour = 0;
-  t.tm_min = 0;
-  t.tm_sec = 0;
 
-  return mktime(&t);
+/**
+  * @brief      clear area of framebuffer and mark it for next partial refresh
+  * @param      x, y    top-left pixel
+  * @param      w, h    size in pixels
+  * @return     none
+  * @note       widgets call this before drawing, then disp_tile_flush() sends
+  *             only the touched tiles.
+  */
+void disp_clear_area(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  disp_tile_clear_area(x, y, w, h);
 }
 
 
@@ -500,11 +619,10 @@ unsigned long GetTodayBaseTimeStamp(datetime_t *datetime)
 void disp_ssid(uint8_t MODE)
 {
   uint32_t old_yPos = g_lcd_yPos;
+  char     szLine[48];            // "OFFLINE (ssid)"
 
   // clear top area
-  u8g2.setDrawColor(0);
-  u8g2.drawBox(0, 0, 128, 16);
-  u8g2.setDrawColor(1);
+  disp_clear_area(0, 0, LCD_WIDTH, LCD_Y_OFFSET_STARTBLUE);
 
   // icon (line1 & line2)
   g_lcd_yPos = LCD_Y_POS_INIT;
@@ -527,119 +645,99 @@ void disp_ssid(uint8_t MODE)
 
   // line2
   if(0 == MODE)         // offline
-    u8g2.drawStr(16, g_lcd_yPos, (String(disp_no_connection+" ("+foundmyAPssid+")")).c_str());
+  {
+    snprintf(szLine, sizeof(szLine), "%s (%s)", disp_no_connection, foundmyAPssid);
+    u8g2.drawStr(16, g_lcd_yPos, szLine);
+  }
   else if(1 == MODE)    // online
-    u8g2.drawStr(16, g_lcd_yPos, foundmyAPssid.c_str());
+    u8g2.drawStr(16, g_lcd_yPos, foundmyAPssid);
   else if(2 == MODE)    // time syncing
-    u8g2.drawStr(16, g_lcd_yPos, strTimeSynced.c_str());
+    u8g2.drawStr(16, g_lcd_yPos, strTimeSynced);
   else if(3 == MODE)    // conncting
-    u8g2.drawStr(16, g_lcd_yPos, strWiFiScanOngoing.c_str());
+    u8g2.drawStr(16, g_lcd_yPos, strWiFiScanOngoing);
 
   g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
 
-  // display!
-  u8g2.sendBuffer();
+  // display! (top area only)
+  disp_tile_flush();
 
 }
 
 
 
 /**
-  * @brief      update clock display
-  * @param      MODE    (reserved for further use)
-  * @return     none
-  * @note       note
+  * @brief      layout of clock screen
+  * @param      none
+  * @return     DISP_LAYOUT_xxx
+  * @note       progress bars (key toggle) win over sensor values,
+  *             date moves up on sensor board (same as before layouts).
   */
-void update_disp_clock(uint8_t MODE)
+static uint8_t disp_get_layout(void)
 {
-  uint32_t    old_yPos = g_lcd_yPos;
-  unsigned long currentEpochTime = timeClient.getEpochTime();
-  datetime_t  datetime;
+  if(bProgressBarStatus)
+    return (isSensorPresent) ? DISP_LAYOUT_SENSOR_BARS : DISP_LAYOUT_BARS;
 
-  // returns epoch time. uncomment for debug purpose.
-  //Serial.println(timeClient.getEpochTime());
+  return (isSensorPresent) ? DISP_LAYOUT_SENSORS : DISP_LAYOUT_CLOCK;
+}
 
-  g_lcd_yPos = LCD_Y_OFFSET_STARTBLUE;
 
-  // clear pervious time display zone (blue area)
-  u8g2.setDrawColor(0);
-  u8g2.drawBox(0, g_lcd_yPos, 128, 128);
-  u8g2.setDrawColor(1);
 
-  // check bar is display (1)
-  if(isSensorPresent)
-  {
-    g_lcd_yPos = 28;
-  }
-  else
+/**
+  * @brief      render scheduler - check whether clock screen has to be redrawn
+  * @param      none
+  * @return     0 : same as last frame (skip) / 1 : redraw required
+  * @note       timer requests redraw every 100 ms, but visible content changes
+  *             at most once a second. compares epoch & widget state of last frame.
+  */
+uint8_t is_disp_clock_changed(void)
+{
+  uint32_t dwEpoch  = sys_clock_get_epoch();
+  uint8_t  bLayout  = disp_get_layout();
+
+  if( (g_disp_render.bValid)                        &&
+      (g_disp_render.dwEpoch    == dwEpoch)         &&
+      (g_disp_render.bLayout    == bLayout)         &&
+      (g_disp_render.bSensorSeq == bSensorReadSeq) )
   {
-    (bProgressBarStatus) ? (g_lcd_yPos = LCD_Y_OFFSET_CLOCK) : (g_lcd_yPos = LCD_Y_OFFSET_CLOCK+8);
+    return 0;
   }
-  // update date
-  utc_timestamp_to_date(currentEpochTime, &datetime);
-  u8g2.setFont(u8g2_font_tiny5_tr);   // font for date
-  u8g2.drawStr(LCD_X_OFFSET_DATE, g_lcd_yPos, strCurrDate.c_str() );                // YYYY-MM-DD
-  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-  u8g2.drawStr(LCD_X_OFFSET_DATE, g_lcd_yPos, daysOfTheWeek[timeClient.getDay()]);  // (weekday)
 
-  // update time
-  u8g2.setFont(u8g2_font_12x6LED_mn); // font for clock digit
-  u8g2.drawStr(LCD_X_OFFSET_CLOCK, g_lcd_yPos, timeClient.getFormattedTime().c_str() );
+  g_disp_render.dwEpoch     = dwEpoch;
+  g_disp_render.bLayout     = bLayout;
+  g_disp_render.bSensorSeq  = bSensorReadSeq;
+  g_disp_render.bValid      = 1;
 
-  // check bar is display (2)
-  if(bProgressBarStatus)
-  {
-    // update bar
-    u8g2.setFont(u8g2_font_tiny5_tr);   // font for date
-    g_lcd_yPos = LCD_Y_OFFSET_PROGRESSBAR;
+  return 1;
+}
 
-    //  day - update every 1440 seconds from today 0:00
-    u8g2.drawStr(0, g_lcd_yPos, dispBar[( (currentEpochTime - GetTodayBaseTimeStamp(&datetime))/1440 )] );
-    g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-    //  minute
-    u8g2.drawStr(0, g_lcd_yPos, dispBar[( (currentEpochTime % 3600)/60 )] );
-    g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-    //  second
-    u8g2.drawStr(0, g_lcd_yPos, dispBar[( currentEpochTime % 60 )] );
-  }
-  else
-  {
-    if(isSensorPresent)
-    {
-      if(isAHTx0Present)
-      {
-        StrTemp  = String(aht_temp.temperature);
-        StrHumid = String(aht_humid.relative_humidity);
-      }
-      else if(isAM2302Present)
-      {
-        StrTemp  = String(am2302.get_Temperature());
-        StrHumid = String(am2302.get_Humidity());
-      }
-      else if(isBMP280Present)
-      {
-        StrTemp  = String(bmp280.readTemperature());
-        StrHumid = "--.-";
-      }
 
-      g_lcd_yPos = LCD_Y_OFFSET_PROGRESSBAR;
 
-      u8g2.setFont(u8g2_font_spleen5x8_me);   // font for text
-      u8g2.drawStr(LCD_X_OFFSET_CLOCK, (g_lcd_yPos-3), "Temp('C) ");
-      u8g2.setFont(u8g2_font_9x6LED_mn);      // font for value
-      u8g2.drawStr(LCD_X_OFFSET_CLOCK+55, g_lcd_yPos, StrTemp.c_str());
-      g_lcd_yPos = g_lcd_yPos + 10;
+/**
+  * @brief      update clock display
+  * @param      MODE    (reserved for further use)
+  * @return     none
+  * @note       frame itself : disp_clock_render() (disp_clock.cpp, also built on host)
+  */
+void update_disp_clock(uint8_t MODE)
+{
+  uint32_t          currentEpochTime = sys_clock_get_epoch();
+  datetime_t        datetime;
+  uint8_t           bLayout;
+  uint32_t          dwProf;
+
+  // returns epoch time. uncomment for debug purpose.
+  //Serial.println(sys_clock_get_epoch());
+
+  bLayout = disp_get_layout();
 
-      u8g2.setFont(u8g2_font_spleen5x8_me);   // font for text
-      u8g2.drawStr(LCD_X_OFFSET_CLOCK, (g_lcd_yPos-3), "Humid(%) ");
-      u8g2.setFont(u8g2_font_9x6LED_mn);      // font for value
-      u8g2.drawStr(LCD_X_OFFSET_CLOCK+55, g_lcd_yPos, StrHumid.c_str());
-    }
-  }
-  // display
-  u8g2.sendBuffer();
+  dwProf = prof_start();
+  disp_clock_render(&u8g2, currentEpochTime, bLayout, daysOfTheWeek[sys_clock_get_day()], &datetime);
+  prof_stop(PROF_ID_RENDER, dwProf);
 
-  g_lcd_yPos = old_yPos;
+  // display (touched tiles only)
+  dwProf = prof_start();
+  disp_tile_flush();
+  prof_stop(PROF_ID_FLUSH, dwProf);
 
   // blink LED on every minutes
   (0 == datetime.second) ? (digitalWrite(ESP8266_LED_PIN, ESP8266_LED_ON)) : (digitalWrite(ESP8266_LED_PIN, ESP8266_LED_OFF));
@@ -661,128 +759,42 @@ void update_disp_clock(uint8_t MODE)
   *                 "                    "      " YYYY-MM-DD MMM "
   *                 "      hh:mm:ss      "
   *                 "   YYYY-MM-DD MMM   "
+  *             written into shadow buffer, only changed characters are sent
+  *             (usually 1~2 digits of seconds). layout : clcd_layout_t (disp_layout.h)
   */
 void update_disp_clock_CLCD(uint8_t MODE)
 {
+  disp_layout_ctx_t ctx;
+
   if(!isCLCDPresent)
     return;
 
-  if((CLCD_ROW_NUM > 2) && (CLCD_COL_NUM > 16))     // 20x4
-  {
-    lcd.setCursor(6,2);
-    lcd.print(timeClient.getFormattedTime().c_str());
-    lcd.setCursor(3,3);
-    lcd.print(strCurrDate.c_str());
-    lcd.setCursor(14,3);
-    lcd.print(daysOfTheWeek[timeClient.getDay()]);
-  }
-  else                                              // 16x2
-  {
-    lcd.setCursor(5,0);
-    lcd.print(timeClient.getFormattedTime().c_str());
-    lcd.setCursor(1,1);
-    lcd.print(strCurrDate.c_str());
-    lcd.setCursor(13,1);
-    lcd.print(daysOfTheWeek[timeClient.getDay()]);
-  }
-
-}
-
-
-
-/**
-  * @brief      blink LED of ESP8266
-  * @param      dwRepeatCount   blink count. 0 means 1.
-  * @param      dwDelay_ms      millisecond delay time of LED ON/OFF
-  * @return     none
-  * @note       note
-  */
-void      blinkInternalLED_Polling(uint32_t dwRepeatCount, uint32_t dwDelay_ms)
-{
-
-#ifdef DBG_LOG_EN
-  Serial.printf("LED %d %d\r\n", dwRepeatCount, dwDelay_ms);
-#endif
-
-  for(uint32_t i=0; i<dwRepeatCount; i++)
-  {
-  digitalWrite(ESP8266_LED_PIN, ESP8266_LED_ON);
-  delay(dwDelay_ms);
-  digitalWrite(ESP8266_LED_PIN, ESP8266_LED_OFF);
-  delay(dwDelay_ms);
-
-#ifdef DBG_LOG_EN
-    Serial.printf("%d\r\n", i);
-#endif
-  }
-
-  digitalWrite(ESP8266_LED_PIN, ESP8266_LED_OFF); // LED off after blank
+  ctx.pDisp   = &u8g2;
+  ctx.dwEpoch = sys_clock_get_epoch();
+  ctx.szWday  = daysOfTheWeek[sys_clock_get_day()];
 
-  return;
+  clcd_layout_t::render(&ctx);
 
 }
 
 
 
 /**
-  * @brief      Search my Wi-Fi Access Point & Connect
-  * @param      MODE
-  *               DEC 70   : connect directly by hard-coded information ('F')
-  *               else     : search and connect
-  *
-  * @param      LCD_DISP_EN
-  *               0       : NOT display connection procedure on LCD
-  *               (else)  : display connection procedure on LCD
-  * @return     uint8_t
-  *               0       : connection not established.
-  *               (else)  : connection established.
-  * @note       to direct connect to AP, use " WiFi.begin(ssid, password) "
+  * @brief      check scan result & find my Wi-Fi Access Point (g_net_config.szSSID)
+  * @param      scanResult    number of found networks
+  * @return     true : found (foundmyAPssid is updated) / false : not found
   */
-uint8_t   WLAN_Connect(uint8_t MODE, uint8_t LCD_DISP_EN)
+bool      WLAN_FindMyAP(int scanResult)
 {
-  uint8_t bRet = 0;
-
   String  ssid;
   int32_t rssi;
   uint8_t encryptionType;
   uint8_t *bssid;
   int32_t channel;
   bool    hidden;
-  int     scanResult;
 
   bool    isfindmyAP    = false;
 
-
-  if(LCD_DISP_EN)
-  {
-    // update display
-    // clear display
-    u8g2.clearDisplay();
-    // clear buffer
-    u8g2.clearBuffer();
-    // icon (line1 & line2)
-    g_lcd_yPos = LCD_Y_POS_INIT;
-    u8g2.setFont(u8g2_font_siji_t_6x10);
-    u8g2.drawGlyph(2, (g_lcd_yPos+2), ICO_WIFI_NOCARRIER);
-    // text
-    u8g2.setFont(u8g2_font_tiny5_tr);
-    // line1
-    u8g2.drawStr(16, g_lcd_yPos, my_board_name);
-    g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-    // line2
-    // u8g2.drawStr(16, g_lcd_yPos, "NO CARRIER");
-    g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-    // line3
-    u8g2.drawStr(2, g_lcd_yPos, "Searching Wi-Fi...");
-    g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-    // display!
-    u8g2.sendBuffer();
-  }
-
-  Serial.printf(">> [%s] Searching Wi-Fi... ", __FUNCTION__);
-
-  scanResult = WiFi.scanNetworks(/*async=*/false, /*hidden=*/true);
-
   if (scanResult == 0)
   {
     Serial.println(F("No networks found"));
@@ -792,13 +804,12 @@ uint8_t   WLAN_Connect(uint8_t MODE, uint8_t LCD_DISP_EN)
     Serial.printf(PSTR("total %03d networks found :\n"), scanResult);
 
     // Print unsorted scan results
-    // and find my Wi-Fi Access Point ("TERRA-****")
-    isfindmyAP = false;
-
+    // and find my Wi-Fi Access Point (provisioned SSID)
     for (int8_t i = 0; i < scanResult; i++)
     {
       WiFi.getNetworkInfo(i, ssid, encryptionType, rssi, bssid, channel, hidden);
 
+#ifdef DBG_DISP_ALL_FOUND_AP
       // get extra info
       const bss_info *bssInfo = WiFi.getScanInfoByIndex(i);
       String phyMode;
@@ -828,171 +839,301 @@ uint8_t   WLAN_Connect(uint8_t MODE, uint8_t LCD_DISP_EN)
           wps = PSTR("WPS");
         }
       }
-#ifdef DBG_DISP_ALL_FOUND_AP
       Serial.printf(PSTR("  %02d: [CH %03d] [%02X:%02X:%02X:%02X:%02X:%02X] %ddBm %c %c %-11s %3S %s\n"), \
                               i, channel, bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5], rssi, (encryptionType == ENC_TYPE_NONE) ? ' ' : '*', hidden ? 'H' : 'V', phyMode.c_str(), wps, ssid.c_str());
 #endif /** DBG_DISP_ALL_FOUND_AP **/
 
       // check it is my Wi-Fi Acceses Point
-      if( (false == isfindmyAP) && (0 == ssid.indexOf("TERRA-")) )
+      if( (false == isfindmyAP) && (0 == strcmp(ssid.c_str(), g_net_config.szSSID)) )
       {
-        foundmyAPssid = ssid;
+        strncpy(foundmyAPssid, ssid.c_str(), sizeof(foundmyAPssid)-1);
         isfindmyAP = true;
       }
-      yield();
     }
   }
   else
   {
-    Serial.printf(PSTR("WiFi scan error %d"), scanResult);
-  }
-
-  /////////////////////////////////////////////////////////////////////////////
-
-  // FW V03 : bug fix <- can't continue when MODE=true
-  if(MODE==70)  isfindmyAP=true;
-
-  if(isfindmyAP)  // found my AP. proceed to connect
-  {
-    Serial.printf(">> [%s] Found! connecting to '%s'...\r\n", __FUNCTION__, foundmyAPssid.c_str());
-
-    // connect to my AP
-    if(MODE==70)    // connect directly by hard-coded information. previous scan routines are useless :)
-      WiFi.begin(my_own_ap_ssid, my_own_ap_password);
-    else        // connect to found AP
-      WiFi.begin(foundmyAPssid, my_own_ap_password);
-
-    if(LCD_DISP_EN)
-    {
-      // update display
-      //line4
-      u8g2.drawStr(2, g_lcd_yPos, "Connect to :");
-      g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-      u8g2.drawStr(2, g_lcd_yPos, foundmyAPssid.c_str());
-      g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-
-      // icon (line1 & line2)
-      g_lcd_yPos = LCD_Y_POS_INIT;
-      u8g2.setFont(u8g2_font_siji_t_6x10);
-      u8g2.drawGlyph(2, (g_lcd_yPos+2), ICO_BLANK);      // clear previous icon
-      u8g2.drawGlyph(2, (g_lcd_yPos+2), ICO_WIFI_FULL);
-
-      // display!
-      u8g2.sendBuffer();
-    }
-
-    // before exit, update state flag
-    G_STATE_SET_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
-
-    return 1;
-  }
-  else            // can't found my AP.
-  {
-    Serial.printf(">> [%s] Not Found!\r\n", __FUNCTION__);
-
-    if(LCD_DISP_EN)
-    {
-      // update display
-      //line4
-      u8g2.drawStr(2, g_lcd_yPos, "Error! Not Found my AP!");
-      g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-      u8g2.drawStr(2, g_lcd_yPos, foundmyAPssid.c_str());
-      g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-      // display!
-      u8g2.sendBuffer();
-    }
-
-    // before exit, update state flag
-    G_STATE_CLR_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
-
-    return 0;
+    Serial.printf(PSTR("WiFi scan error %d\r\n"), scanResult);
   }
 
-  // unreachable.
-  G_STATE_CLR_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
-  return 0;
+  return isfindmyAP;
 }
 
 
 
-/*****************************************************************************/
-
 /**
-  * @brief      ESP8266 Timer1 ISR
-  * @param      none
+  * @brief      start searching my Wi-Fi Access Point & connect (non-blocking)
+  * @param      MODE
+  *               DEC 70   : connect directly by provisioned information ('F')
+  *               else     : search and connect
+  *
+  * @param      LCD_DISP_EN
+  *               0       : NOT display connection procedure on LCD
+  *               (else)  : display connection procedure on LCD
   * @return     none
-  * @note       in this routine, just set flag and exit. next action is performed in loop().
+  * @note       each step is performed by WLAN_Connect_Process() from loop().
   */
-void ICACHE_RAM_ATTR onTimerISR()
+void      WLAN_Connect_Start(uint8_t MODE, uint8_t LCD_DISP_EN)
 {
+  g_wlan.bMode        = MODE;
+  g_wlan.bDispEn      = LCD_DISP_EN;
+  g_wlan.dwTimeStamp  = millis();
 
-  // update clock display
-  G_STATE_SET_BIT(G_STATE_BIT_POS_CLOCK_DISP_REDRAW_REQ);
-
-  // check Wi-Fi connection (every INTERVAL_WIFI_CONNECTION_CHK sec)
-  if( (timeClient.getEpochTime() - uptime_WiFiconnection) > INTERVAL_WIFI_CONNECTION_CHK)
-  {
-    uptime_WiFiconnection = timeClient.getEpochTime();
-
-    if(!(G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE)))
-      uptime_WiFiLost++;
-
-    G_STATE_SET_BIT(G_STATE_BIT_POS_WIFI_STATE_CHK_REQ);
-  }
-
-  // check Wi-Fi Reconnection request (every INTERVAL_WIFI_RECONNECTION sec)
-  if( uptime_WiFiLost > INTERVAL_WIFI_RECONNECTION)
-  {
-    uptime_WiFiLost = 0;
-    G_STATE_SET_BIT(G_STATE_BIT_POS_WIFI_RECONNECT_REQ);
-  }
-
-  // check time re-synchronize period is elapsed (every INTERVAL_GET_TIME_FROM_NET sec)
-  if( (timeClient.getEpochTime() - uptime_LastTimeSynced) > INTERVAL_GET_TIME_FROM_NET)
+  if(LCD_DISP_EN)
   {
-    // clear time sync state
-    G_STATE_CLR_BIT(G_STATE_BIT_POS_TIME_SYNC_STATE);
-    uptime_LastTimeSynced = timeClient.getEpochTime();
+    // update display
+    // clear display
+    u8g2.clearDisplay();
+    // clear buffer
+    u8g2.clearBuffer();
+    // icon (line1 & line2)
+    g_lcd_yPos = LCD_Y_POS_INIT;
+    u8g2.setFont(u8g2_font_siji_t_6x10);
+    u8g2.drawGlyph(2, (g_lcd_yPos+2), ICO_WIFI_NOCARRIER);
+    // text
+    u8g2.setFont(u8g2_font_tiny5_tr);
+    // line1
+    u8g2.drawStr(16, g_lcd_yPos, my_board_name);
+    g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
+    // line2
+    // u8g2.drawStr(16, g_lcd_yPos, "NO CARRIER");
+    g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+    // line3
+    u8g2.drawStr(2, g_lcd_yPos, "Searching Wi-Fi...");
+    g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+    // display!
+    u8g2.sendBuffer();
+  }
 
-    // set flag to do update
-    G_STATE_SET_BIT(G_STATE_BIT_POS_TIME_RESYNC_REQ);
+  // FW V03 : bug fix <- can't continue when MODE=true
+  // connect directly by provisioned information. scan routines are useless :)
+  g_wlan.bFast  = 0;
+  g_wlan.bState = (MODE==70) ? WLAN_STATE_CONNECT_START : WLAN_STATE_SCAN_START;
+
+  // last connection is known. try it directly, scan only as a fallback.
+  if((MODE!=70) && rtc_store_load_wlan(&g_wlan_cache))
+  {
+    g_wlan.bFast  = 1;
+    g_wlan.bState = WLAN_STATE_CONNECT_START;
   }
+}
 
-  // Temperature & Humidity Sensor Read
-  if(isSensorPresent)
+
+
+/**
+  * @brief      remember current connection for fast reconnect
+  * @param      none
+  * @return     none
+  */
+void      WLAN_Save_Cache(void)
+{
+  memset(&g_wlan_cache, 0, sizeof(wlan_cache_t));
+
+  strncpy(g_wlan_cache.szSSID, WiFi.SSID().c_str(), sizeof(g_wlan_cache.szSSID)-1);
+  memcpy(g_wlan_cache.bBSSID, WiFi.BSSID(), sizeof(g_wlan_cache.bBSSID));
+  g_wlan_cache.bChannel   = WiFi.channel();
+  g_wlan_cache.dwIP       = (uint32_t)WiFi.localIP();
+  g_wlan_cache.dwGateway  = (uint32_t)WiFi.gatewayIP();
+  g_wlan_cache.dwSubnet   = (uint32_t)WiFi.subnetMask();
+  g_wlan_cache.dwDNS      = (uint32_t)WiFi.dnsIP();
+
+  rtc_store_save_wlan(&g_wlan_cache);
+}
+
+
+
+/**
+  * @brief      perform one step of Wi-Fi scan & connect state machine
+  * @param      none
+  * @return     current state (WLAN_STATE_*)
+  * @note       never blocks. call repeatedly from loop() while WLAN_IS_BUSY().
+  *               SCAN_START    : start async scan (incl. hidden SSID)
+  *               SCAN_WAIT     : poll scanComplete(), pick my AP
+  *               CONNECT_START : WiFi.begin() (fast : with cached channel/BSSID)
+  *               CONNECT_WAIT  : wait WL_CONNECTED with timeout
+  *                               (fast : fall back to SCAN_START on timeout)
+  */
+uint8_t   WLAN_Connect_Process(void)
+{
+  int     scanResult;
+
+  switch(g_wlan.bState)
   {
-    if( (timeClient.getEpochTime() - uptime_LastSensorRead) > INTERVAL_READ_SENSOR)
-    {
-      uptime_LastSensorRead = timeClient.getEpochTime();
+    case WLAN_STATE_SCAN_START:
+      Serial.printf(">> [%s] Searching Wi-Fi... ", __FUNCTION__);
+      WiFi.scanDelete();
+      WiFi.scanNetworks(/*async=*/true, /*hidden=*/true);
+      g_wlan.dwTimeStamp  = millis();
+      g_wlan.bState       = WLAN_STATE_SCAN_WAIT;
+      break;
 
-      // set flag to do update
-      G_STATE_SET_BIT(G_STATE_BIT_POS_SENSOR_READ_REQ);
-    }
+    case WLAN_STATE_SCAN_WAIT:
+      scanResult = WiFi.scanComplete();
+
+      if(WIFI_SCAN_RUNNING == scanResult)
+      {
+        if((millis() - g_wlan.dwTimeStamp) > WLAN_SCAN_TIMEOUT_MS)
+        {
+          Serial.printf(">> [%s] Scan timeout!\r\n", __FUNCTION__);
+          WiFi.scanDelete();
+          g_wlan.bState = WLAN_STATE_FAILED;
+        }
+        break;
+      }
+
+      if(WLAN_FindMyAP(scanResult))
+      {
+        g_wlan.bState = WLAN_STATE_CONNECT_START;
+      }
+      else
+      {
+        Serial.printf(">> [%s] Not Found!\r\n", __FUNCTION__);
+
+        if(g_wlan.bDispEn)
+        {
+          // update display
+          //line4
+          u8g2.drawStr(2, g_lcd_yPos, "Error! Not Found my AP!");
+          g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+          u8g2.drawStr(2, g_lcd_yPos, foundmyAPssid);
+          g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+          // display!
+          u8g2.sendBuffer();
+        }
+        g_wlan.bState = WLAN_STATE_FAILED;
+      }
+      WiFi.scanDelete();    // free scan result
+      break;
+
+    case WLAN_STATE_CONNECT_START:
+      if(g_wlan.bFast)
+      {
+        strncpy(foundmyAPssid, g_wlan_cache.szSSID, sizeof(foundmyAPssid)-1);
+        Serial.printf(">> [%s] Fast reconnect to '%s' (CH %d)...\r\n", __FUNCTION__, foundmyAPssid, g_wlan_cache.bChannel);
+
+#if WLAN_FAST_CONNECT_STATIC_IP
+        if(g_wlan_cache.dwIP)
+          WiFi.config(IPAddress(g_wlan_cache.dwIP), IPAddress(g_wlan_cache.dwGateway), IPAddress(g_wlan_cache.dwSubnet), IPAddress(g_wlan_cache.dwDNS));
+#endif
+        WiFi.begin(g_wlan_cache.szSSID, g_net_config.szPass, g_wlan_cache.bChannel, g_wlan_cache.bBSSID);
+      }
+      else
+      {
+        Serial.printf(">> [%s] Found! connecting to '%s'...\r\n", __FUNCTION__, foundmyAPssid);
+
+        // connect to my AP
+        if(g_wlan.bMode==70)    // connect directly by provisioned information.
+          WiFi.begin(g_net_config.szSSID, g_net_config.szPass);
+        else                    // connect to found AP
+          WiFi.begin(foundmyAPssid, g_net_config.szPass);
+      }
+
+      if(g_wlan.bDispEn)
+      {
+        // update display
+        //line4
+        u8g2.drawStr(2, g_lcd_yPos, "Connect to :");
+        g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+        u8g2.drawStr(2, g_lcd_yPos, foundmyAPssid);
+        g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+        // display!
+        u8g2.sendBuffer();
+      }
+
+      g_wlan.dwTimeStamp  = millis();
+      g_wlan.bState       = WLAN_STATE_CONNECT_WAIT;
+      break;
+
+    case WLAN_STATE_CONNECT_WAIT:
+      if(WL_CONNECTED == WiFi.status())
+      {
+        if(g_wlan.bDispEn)
+        {
+          // icon (line1 & line2)
+          uint32_t old_yPos = g_lcd_yPos;
+          g_lcd_yPos = LCD_Y_POS_INIT;
+          u8g2.setFont(u8g2_font_siji_t_6x10);
+          u8g2.drawGlyph(2, (g_lcd_yPos+2), ICO_BLANK);      // clear previous icon
+          u8g2.drawGlyph(2, (g_lcd_yPos+2), ICO_WIFI_FULL);
+          u8g2.setFont(u8g2_font_tiny5_tr);
+          g_lcd_yPos = old_yPos;
+
+          // display!
+          u8g2.sendBuffer();
+        }
+
+        // for next reconnect / boot
+        WLAN_Save_Cache();
+
+        // update state flag
+        G_STATE_SET_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
+        g_wlan.bState = WLAN_STATE_CONNECTED;
+      }
+      else if( (g_wlan.bFast) && ((millis() - g_wlan.dwTimeStamp) > WLAN_FAST_CONNECT_TIMEOUT_MS) )
+      {
+        Serial.printf(">> [%s] Fast reconnect failed. scan...\r\n", __FUNCTION__);
+
+        // AP is moved or changed. forget it, restore DHCP and search again.
+        rtc_store_invalidate_wlan();
+        WiFi.disconnect();
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());
+        g_wlan.bFast  = 0;
+        g_wlan.bState = WLAN_STATE_SCAN_START;
+      }
+      else if((millis() - g_wlan.dwTimeStamp) > WLAN_CONNECT_TIMEOUT_MS)
+      {
+        Serial.printf(">> [%s] Connect timeout! (%d)\r\n", __FUNCTION__, WiFi.status());
+        g_wlan.bState = WLAN_STATE_FAILED;
+      }
+      break;
+
+    case WLAN_STATE_IDLE:
+    case WLAN_STATE_FAILED:
+    case WLAN_STATE_CONNECTED:
+    default:
+      break;
   }
 
-  // check key pressed
-  if( 0 == digitalRead(ESP8266_FLASH_KEY) )
+  return g_wlan.bState;
+}
+
+
+
+/*****************************************************************************/
+
+/**
+  * @brief      ESP8266 Timer1 ISR
+  * @param      none
+  * @return     none
+  * @note       in this routine, just count tick, sample FLASH key and post events.
+  *             no flash (non-IRAM) function, no millis() / time base access here.
+  *             interval checks are done by task_timer().
+  */
+void ICACHE_RAM_ATTR onTimerISR()
+{
+  prof_isr_enter();
+
+  g_dwTimerTick++;
+
+  // update clock display & interval checks
+  sched_post_isr(EV_CLOCK_DISP_REDRAW_REQ | EV_TIMER_TICK);
+
+  // check key pressed (read GPIO input register directly, digitalRead() is not in IRAM)
+  if( 0 == (GPI & (1 << ESP8266_FLASH_KEY)) )
   {
     // key is pressed. increase value for long press.
     dwFLASHKEYpressedtime += 1;
   }
   else
   {
-    // key is released. set flag.
+    // key is released. post event.
     if (dwFLASHKEYpressedtime >= KEYPRESS_LONG_TH)
     {
-      G_STATE_SET_BIT(G_STATE_BIT_POS_KEYPRESS_LONG_REQ);
-      G_STATE_CLR_BIT(G_STATE_BIT_POS_KEYPRESS_SHORT_REQ);
+      sched_post_isr(EV_KEYPRESS_LONG_REQ);
     }
     else if ( (KEYPRESS_SHORT_TH <= dwFLASHKEYpressedtime) && (dwFLASHKEYpressedtime < KEYPRESS_LONG_TH) )
     {
-      G_STATE_SET_BIT(G_STATE_BIT_POS_KEYPRESS_SHORT_REQ);
-      G_STATE_CLR_BIT(G_STATE_BIT_POS_KEYPRESS_LONG_REQ);
-    }
-    else
-    {
-      G_STATE_CLR_BIT(G_STATE_BIT_POS_KEYPRESS_SHORT_REQ);
-      G_STATE_CLR_BIT(G_STATE_BIT_POS_KEYPRESS_LONG_REQ);
+      sched_post_isr(EV_KEYPRESS_SHORT_REQ);
     }
 
     dwFLASHKEYpressedtime = 0;
@@ -1008,119 +1149,490 @@ void ICACHE_RAM_ATTR onTimerISR()
 
 
 /**
-  * @brief      arduino setup()
+  * @brief      monotonic uptime
   * @param      none
+  * @return     seconds since timer1 is started
+  * @note       not affected by time sync (step / slew). 32-bit read is atomic.
+  */
+uint32_t GetUptimeSec(void)
+{
+  return (g_dwTimerTick / ESP8266_TIMER1_TICK_PER_SEC);
+}
+
+
+
+/**
+  * @brief      task - interval checks (moved from ISR)
+  * @param      dwEvents    EV_TIMER_TICK
   * @return     none
-  * @note       put your setup code here, to run once
   */
-void setup()
+void task_timer(uint32_t dwEvents)
 {
-  /**
-   *    Initialize hardware & libraries (1)
-   */
-  // Built-in LED
-  pinMode(ESP8266_LED_PIN, OUTPUT);
-  digitalWrite(ESP8266_LED_PIN, HIGH);
+  uint32_t dwNow;
 
-  // FLASH key
-  pinMode(ESP8266_FLASH_KEY, INPUT_PULLUP);
+  prof_isr_serviced();
 
-  // Serial Monitor
-  Serial.begin(115200);
+  dwNow = GetUptimeSec();
 
-  // LCD Graphic Library
-  u8g2.begin();
+  // check Wi-Fi connection (every INTERVAL_WIFI_CONNECTION_CHK sec)
+  if( (dwNow - uptime_WiFiconnection) > INTERVAL_WIFI_CONNECTION_CHK)
+  {
+    uptime_WiFiconnection = dwNow;
 
-  // ...
-  delay(2500);
-  blinkInternalLED_Polling(5, 100);
+    // radio switched off on purpose is not a lost connection
+    if( !(G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE)) && bRadioOn )
+      uptime_WiFiLost++;
 
-  // 1st splash - OLED
-  // clear display
-  u8g2.clearDisplay();
-  // clear buffer
+    sched_post(EV_WIFI_STATE_CHK_REQ);
+  }
+
+  // check Wi-Fi Reconnection request (every INTERVAL_WIFI_RECONNECTION sec)
+  if( uptime_WiFiLost > INTERVAL_WIFI_RECONNECTION)
+  {
+    uptime_WiFiLost = 0;
+    sched_post(EV_WIFI_RECONNECT_REQ);
+  }
+
+  // check time re-synchronize period is elapsed (every dwTimeSyncInterval sec)
+  if( (dwNow - uptime_LastTimeSynced) > dwTimeSyncInterval)
+  {
+    uptime_LastTimeSynced = dwNow;
+
+    // set flag to do update (time sync state is cleared by task)
+    sched_post(EV_TIME_RESYNC_REQ);
+  }
+
+  // Temperature & Humidity Sensor Read : interval of each device is handled by sensor registry
+}
+
+
+
+/* provisioning portal page */
+static const char portal_page[] PROGMEM = R"HTML(<!DOCTYPE html>
+<html>
+<head>
+<meta charset="UTF-8">
+<meta name="viewport" content="width=device-width">
+<title>Wi-Fi Clock Setup</title>
+</head>
+<body>
+<h1>Wi-Fi Clock Setup</h1>
+<form method="POST" action="/save">
+SSID<br><input name="ssid" maxlength="32" required><br>
+Password<br><input name="pass" type="password" maxlength="64"><br>
+NTP server (optional)<br><input name="ntp" maxlength="63" placeholder="pool.ntp.org"><br>
+Time zone (hours from UTC)<br><input name="tz" value="9"><br><br>
+<input type="submit" value="Save &amp; Restart">
+</form>
+</body>
+</html>
+)HTML";
+
+
+
+/**
+  * @brief      check FLASH key is held to enter provisioning portal
+  * @param      none
+  * @return     1 : held for PORTAL_KEY_HOLD_MS / 0 : not pressed (returns at once)
+  * @note       setup() only (timer ISR is not running yet).
+  *             key must be pressed after power-on : GPIO0 low at reset enters flash mode.
+  */
+uint8_t portal_is_requested(void)
+{
+  uint32_t dwStart = millis();
+
+  while(LOW == digitalRead(ESP8266_FLASH_KEY))
+  {
+    if((millis() - dwStart) >= PORTAL_KEY_HOLD_MS)
+      return 1;
+    yield();
+  }
+
+  return 0;
+}
+
+
+
+/**
+  * @brief      provisioning portal : Soft-AP + setting form, store to flash and restart
+  * @param      none
+  * @return     never returns
+  * @note       http://192.168.4.1/ on AP PORTAL_AP_SSID_PREFIX + last 3 bytes of MAC.
+  *             cached connection is dropped, next boot connects with new settings.
+  */
+void portal_run(void)
+{
+  ESP8266WebServer  portal(PORTAL_PORT);
+  char              szApSsid[32];
+  uint8_t           bMac[6];
+  uint8_t           bSaved = 0;
+
+  WiFi.macAddress(bMac);
+  snprintf(szApSsid, sizeof(szApSsid), PORTAL_AP_SSID_PREFIX "%02X%02X%02X", bMac[3], bMac[4], bMac[5]);
+
+  WiFi.persistent(false);
+  WiFi.disconnect();
+  WiFi.mode(WIFI_AP);
+  WiFi.softAP(szApSsid, (strlen(softap_password) >= 8) ? softap_password : NULL);
+
+  Serial.printf(">> Provisioning portal : AP '%s', http://%s/\r\n", szApSsid, WiFi.softAPIP().toString().c_str());
+
+  // display
+  u8g2.begin();
   u8g2.clearBuffer();
-  // icon (line1 & line2)
   g_lcd_yPos = LCD_Y_POS_INIT;
   u8g2.setFont(u8g2_font_siji_t_6x10);
   u8g2.drawGlyph(2, (g_lcd_yPos+2), ICO_INFO);
-  // text
   u8g2.setFont(u8g2_font_tiny5_tr);
-  // line1
-  u8g2.drawStr(16, g_lcd_yPos, my_board_name);
-  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line2
-  u8g2.drawStr(16, g_lcd_yPos, "STARTING...");
-  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line3
-  u8g2.drawStr(5,g_lcd_yPos, "FW Ver : ");
-  itoa(FW_VER, currFwVer, 10);                // FW V02 : Fix radix to decimal
-  u8g2.drawStr(35,g_lcd_yPos, currFwVer);
-  u8g2.drawStr(48,g_lcd_yPos, __DATE__);
-  u8g2.drawStr(92,g_lcd_yPos, __TIME__);
+  u8g2.drawStr(16, g_lcd_yPos, "SETUP MODE");
   g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line4
   g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line5
-  u8g2.drawStr(0,g_lcd_yPos, "  made by Terra Incognita");
+  u8g2.drawStr(2, g_lcd_yPos, "Connect to Wi-Fi :");
   g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line6
-  u8g2.drawStr(0,g_lcd_yPos, "  https://blog.naver.com/bieemiho92");
+  u8g2.drawStr(10, g_lcd_yPos, szApSsid);
   g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-  //line7
+  u8g2.drawStr(2, g_lcd_yPos, "and open :");
   g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line8
-  u8g2.drawStr(0,g_lcd_yPos, "  Device MAC Address : ");
-  g_lcd_yPos += 10;
-  // line9 - display own MAC address
-  u8g2.setFont(u8g2_font_NokiaSmallBold_tr);
-  u8g2.drawStr(10, g_lcd_yPos, WiFi.macAddress().c_str());
-
-  // display!
+  u8g2.drawStr(10, g_lcd_yPos, WiFi.softAPIP().toString().c_str());
   u8g2.sendBuffer();
 
-  // 1st splash - serial teminal
-  Serial.printf("\r\n\r\n\r\n");
-  Serial.println("*******************************************************************************");
-  Serial.printf("\t%s", my_board_name);
-  Serial.println();
-  Serial.printf("\tFW VER x%02X\t(Build @  %s %s)\r\n", FW_VER, __DATE__, __TIME__);
-  Serial.printf("\tMAC Addr :\t");
-  Serial.println(WiFi.macAddress());
-  Serial.println();
-  Serial.println("*******************************************************************************");
+  portal.on("/", HTTP_GET, [&portal]() {
+    portal.send_P(200, "text/html", portal_page);
+  });
 
-  delay(1000);
+  portal.on("/save", HTTP_POST, [&portal, &bSaved]() {
+    net_config_t  config;
+    String        tz    = portal.arg("tz");
+    char          *pEnd = NULL;
+    float         fTz;
 
-  /**
-   *    Initialize hardware & libraries (2)
-   */
+    // toFloat() makes 0 (UTC) of empty / mistyped field : parse strictly
+    tz.trim();
+    fTz = strtof(tz.c_str(), &pEnd);
 
-  // I2C Character LCD --- check whether LCD is present
-  Wire.begin();
-  delay(100);
-  if( (Wire.requestFrom(CLCD_I2C_ADDR, 1)))
+    memset(&config, 0, sizeof(net_config_t));
+    strncpy(config.szSSID, portal.arg("ssid").c_str(), sizeof(config.szSSID)-1);
+    strncpy(config.szPass, portal.arg("pass").c_str(), sizeof(config.szPass)-1);
+    strncpy(config.szNtp,  portal.arg("ntp").c_str(),  sizeof(config.szNtp)-1);
+    config.lTzOffsetSec = (int32_t)(fTz * 3600);
+
+    if( (0 == config.szSSID[0]) || (0 == tz.length()) || (0 != *pEnd) || (fTz < -12) || (fTz > 14) )
+    {
+      portal.send(400, "text/plain", "invalid SSID or time zone");
+      return;
+    }
+
+    rtc_store_save_config(&config);
+    rtc_store_invalidate_wlan();      // cached AP is of old settings
+    portal.send(200, "text/plain", "saved. restarting...");
+    bSaved = 1;
+  });
+
+  portal.onNotFound([&portal]() {
+    portal.sendHeader("Location", "/");
+    portal.send(302);
+  });
+
+  portal.begin();
+
+  while(!bSaved)
   {
-    Serial.println(">> CLCD is present.");
-    isCLCDPresent = 1;
+    portal.handleClient();
+    yield();
   }
-  else
+
+  delay(500);                         // let response go out
+  ESP.restart();
+  while(1)
+    yield();
+}
+
+
+
+/**
+  * @brief      advance boot stages running in parallel (Wi-Fi, NTP, 1st sensor readout)
+  * @param      none
+  * @return     1 : 1st NTP reply is applied (clock mode can start) / 0 : not yet
+  * @note       never blocks. called between init steps of setup() and in its wait loop.
+  *             Wi-Fi / NTP failure is retried after BOOT_RETRY_MS.
+  */
+uint8_t boot_poll(void)
+{
+  static uint32_t dwWaitStart = 0;
+  static uint8_t  bWait       = 0;
+
+  // 1st sensor readout (devices are attached in the middle of setup())
+  if(isSensorPresent && (SENSOR_DONE == sensor_process()))
+    update_sensor_strings();
+
+  // retry back-off
+  if(bWait)
   {
-    Serial.println(">> CLCD is NOT present.");
-    isCLCDPresent = 0;
+    if((millis() - dwWaitStart) < BOOT_RETRY_MS)
+      return 0;
+    bWait = 0;
   }
-  // Wire.end();         // disable I2C --- esp8266 doesn't support this.
 
-  if(isCLCDPresent)
+  // Wi-Fi
+  if(WLAN_IS_BUSY())
   {
-    lcd.init();         // calls Wire.begin() internally.
-    lcd.backlight();
-    lcd.setCursor(0,0);
-    lcd.printstr(my_board_name2);
-    lcd.setCursor(1,1);
-    lcd.print(WiFi.macAddress().c_str());
+    WLAN_Connect_Process();
+    return 0;
+  }
+
+  if(WLAN_STATE_CONNECTED != g_wlan.bState)
+  {
+    if(WLAN_STATE_FAILED == g_wlan.bState)
+    {
+      G_STATE_CLR_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
+      g_wlan.bState = WLAN_STATE_IDLE;
+      bWait         = 1;
+      dwWaitStart   = millis();
+    }
+    else
+    {
+      WLAN_Connect_Start(0, 0);
+    }
+    return 0;
+  }
+
+#ifdef TIME_MESH_EN
+  // LAN leader first. NTP only when nobody leads after hold-off.
+  switch(time_mesh_process())
+  {
+    case TIME_MESH_DONE:
+      sys_clock_discipline(time_mesh_get_result()->qOffsetMs);  // 1st sync : step
+      G_STATE_SET_BIT(G_STATE_BIT_POS_TIME_SYNC_STATE);
+      history_restore((uint32_t)(sys_clock_now_ms() / 1000));
+      return 1;
+
+    default:
+      break;
+  }
+
+  if(time_mesh_has_leader())
+  {
+    if(!time_mesh_is_busy())
+      time_mesh_request();
+    return 0;
+  }
+
+  if( (!time_mesh_ntp_allowed()) && (!ntp_async_is_busy()) )
+    return 0;
+#endif
+
+  // NTP : 1st request as soon as associated
+  if(!ntp_async_is_busy())
+  {
+    if(!ntp_async_request())
+    {
+      bWait       = 1;
+      dwWaitStart = millis();
+    }
+    return 0;
+  }
+
+  switch(ntp_async_process())
+  {
+    case NTP_ASYNC_BUSY:
+      return 0;
+
+    case NTP_ASYNC_DONE:
+      sys_clock_discipline(ntp_async_get_result()->qOffsetMs);   // 1st sync : step
+      G_STATE_SET_BIT(G_STATE_BIT_POS_TIME_SYNC_STATE);         // update state
+#ifdef TIME_MESH_EN
+      time_mesh_ntp_done();                                     // may lead now
+#endif
+      history_restore((uint32_t)(sys_clock_now_ms() / 1000));   // HISTORY_USE_LITTLEFS only
+      return 1;
+
+    default:
+      bWait       = 1;
+      dwWaitStart = millis();
+      return 0;
+  }
+}
+
+
+
+/**
+  * @brief      arduino setup()
+  * @param      none
+  * @return     none
+  * @note       put your setup code here, to run once
+  */
+void setup()
+{
+  /**
+   *    Initialize hardware & libraries (1)
+   */
+  // Built-in LED : ON while booting
+  pinMode(ESP8266_LED_PIN, OUTPUT);
+  digitalWrite(ESP8266_LED_PIN, ESP8266_LED_ON);
+
+  // FLASH key
+  pinMode(ESP8266_FLASH_KEY, INPUT_PULLUP);
+
+  // fast reconnect cache (RTC memory & flash)
+  rtc_store_init();
+
+  // network settings (provisioning portal)
+  bNetConfigValid = rtc_store_load_config(&g_net_config);
+  if(bNetConfigValid)
+  {
+    dwLocalTimeZoneOffset = g_net_config.lTzOffsetSec;
+    if(g_net_config.szNtp[0])
+      strTimeSvrList[0] = g_net_config.szNtp;   // provisioned server first, built-in ones as fallback
+  }
+
+  // local time base (time zone offset) & clock discipline
+  sys_clock_init(dwLocalTimeZoneOffset);
+  sys_clock_set_sync_limits(INTERVAL_GET_TIME_FROM_NET, INTERVAL_GET_TIME_FROM_NET_MAX);
+
+  // resume last known time after crash / reset. NTP confirms it in background.
+  bClockResumed = rtc_store_load_clock(&qwResumeUtcMs, &lResumeDriftPpb);
+  if(RTC_STORE_CLOCK_NONE != bClockResumed)
+  {
+    sys_clock_set_ms(qwResumeUtcMs);
+    sys_clock_set_drift_ppb(lResumeDriftPpb);
+  }
+
+  // sensor history (24 h ring buffer)
+  history_init();
+
+  // Serial Monitor
+  Serial.begin(115200);
+
+  // not provisioned yet : nothing to connect to
+  if(!bNetConfigValid)
+    portal_run();
+
+  /**
+   *    Wi-Fi first : association runs in background while the rest is initialized.
+   *    each step below is followed by boot_poll() to advance Wi-Fi / NTP.
+   */
+  WiFi.persistent(false);             // connection is cached by rtc_store. no SDK flash write on every begin()
+  WiFi.mode(WIFI_STA);                // no Soft-AP : no beacons, STA is free to follow AP channel
+#ifdef LOW_POWER_MODE_EN
+  WiFi.setSleepMode(WIFI_MODEM_SLEEP);  // radio sleeps between DTIM beacons
+#endif
+  WiFi.disconnect();                  // drop connection of SDK auto-connect (if any)
+  ntp_async_init(&ntpUDP, strTimeSvrList, NTP_SERVER_NUM);
+#ifdef TIME_MESH_EN
+  time_mesh_init(&meshUDP, ESP.getChipId());        // listens for a leader from now on
+#endif
+  WLAN_Connect_Start(0, 0);
+
+  // LCD Graphic Library
+#ifdef OLED_USE_HW_I2C
+  u8g2.setBusClock(OLED_I2C_BUS_CLOCK);
+#endif
+  u8g2.begin();
+#ifdef LOW_POWER_MODE_EN
+  u8g2.setContrast(LOW_POWER_OLED_CONTRAST);
+#endif
+  disp_tile_init(&u8g2);
+#ifdef OLED_USE_HW_I2C
+  disp_tile_set_bus(I2C_BUS_DEV_OLED);  // OLED shares Wire with CLCD & sensors
+#endif
+  glyph_cache_init(&u8g2);            // clock / sensor digits (uses framebuffer, before splash)
+
+  // 1st splash - OLED (stays until clock mode)
+  // clear display
+  u8g2.clearDisplay();
+  // clear buffer
+  u8g2.clearBuffer();
+  // icon (line1 & line2)
+  g_lcd_yPos = LCD_Y_POS_INIT;
+  u8g2.setFont(u8g2_font_siji_t_6x10);
+  u8g2.drawGlyph(2, (g_lcd_yPos+2), ICO_INFO);
+  // text
+  u8g2.setFont(u8g2_font_tiny5_tr);
+  // line1
+  u8g2.drawStr(16, g_lcd_yPos, my_board_name);
+  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
+  // line2
+  u8g2.drawStr(16, g_lcd_yPos, "STARTING...");
+  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
+  // line3
+  u8g2.drawStr(5,g_lcd_yPos, "FW Ver : ");
+  itoa(FW_VER, currFwVer, 10);                // FW V02 : Fix radix to decimal
+  u8g2.drawStr(35,g_lcd_yPos, currFwVer);
+  u8g2.drawStr(48,g_lcd_yPos, __DATE__);
+  u8g2.drawStr(92,g_lcd_yPos, __TIME__);
+  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+  // line4
+  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+  // line5
+  u8g2.drawStr(0,g_lcd_yPos, "  made by Terra Incognita");
+  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+  // line6
+  u8g2.drawStr(0,g_lcd_yPos, "  https://blog.naver.com/bieemiho92");
+  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+  //line7
+  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+  // line8
+  u8g2.drawStr(0,g_lcd_yPos, "  Device MAC Address : ");
+  g_lcd_yPos += 10;
+  // line9 - display own MAC address
+  u8g2.setFont(u8g2_font_NokiaSmallBold_tr);
+  u8g2.drawStr(10, g_lcd_yPos, WiFi.macAddress().c_str());
+
+  // display!
+  u8g2.sendBuffer();
+
+  // 1st splash - serial teminal
+  Serial.printf("\r\n\r\n\r\n");
+  Serial.println("*******************************************************************************");
+  Serial.printf("\t%s", my_board_name);
+  Serial.println();
+  Serial.printf("\tFW VER x%02X\t(Build @  %s %s)\r\n", FW_VER, __DATE__, __TIME__);
+  Serial.printf("\tMAC Addr :\t");
+  Serial.println(WiFi.macAddress());
+  Serial.println();
+  Serial.println("*******************************************************************************");
+
+  boot_poll();
+
+  /**
+   *    Initialize hardware & libraries (2)
+   */
+
+  // I2C bus for CLCD & sensors (& OLED when OLED_USE_HW_I2C)
+  i2c_bus_init(I2C_BUS_SDA_PIN, I2C_BUS_SCL_PIN);
+#ifdef OLED_USE_HW_I2C
+  i2c_bus_set_clock(I2C_BUS_DEV_OLED, OLED_I2C_BUS_CLOCK);
+#endif
+
+  // I2C Character LCD --- check whether LCD is present
+  if( (Wire.requestFrom(CLCD_I2C_ADDR, 1)))
+  {
+    Serial.println(">> CLCD is present.");
+    isCLCDPresent = 1;
+  }
+  else
+  {
+    Serial.println(">> CLCD is NOT present.");
+    isCLCDPresent = 0;
+  }
+  // Wire.end();         // disable I2C --- esp8266 doesn't support this.
+
+  if(isCLCDPresent)
+  {
+    lcd.init();         // calls Wire.begin() internally. (keeps pins of i2c_bus_init())
+#ifdef LOW_POWER_MODE_EN
+    lcd.noBacklight();
+#else
+    lcd.backlight();
+#endif
+    lcd.setCursor(0,0);
+    lcd.printstr(my_board_name2);
+    lcd.setCursor(1,1);
+    lcd.print(WiFi.macAddress().c_str());
   }
 
+  boot_poll();
+
   // AM2302 : Start
   if(am2302.begin())
   {
@@ -1133,11 +1645,12 @@ void setup()
     isAM2302Present = 0;
   }
 
+  boot_poll();
+
   // AHTx0
   if(ahtx0.begin())
   {
     Serial.println(">> AHTx0 Sensor is present.");
-    ahtx0.getEvent(&aht_humid, &aht_temp);  // read 1st
     isAHTx0Present = 1;
   }
   else
@@ -1146,6 +1659,8 @@ void setup()
     isAHTx0Present = 0;
   }
 
+  boot_poll();
+
   // BMP280
   if(bmp280.begin())
   {
@@ -1163,39 +1678,94 @@ void setup()
     isBMP280Present = 0;
   }
 
+  /** attach every detected sensor to registry & start 1st readout (collected by boot_poll()) */
+  if(isAHTx0Present)
+    sensor_attach_aht20(&Wire, SENSOR_AHT20_I2C_ADDR, (INTERVAL_READ_SENSOR * 1000UL));
+  if(isAM2302Present)
+    sensor_attach_am2302(&am2302, (INTERVAL_READ_SENSOR * 1000UL));
+  if(isBMP280Present)
+    sensor_attach_bmp280(&bmp280, (INTERVAL_READ_SENSOR * 1000UL));
+
   /** set flag to indicate sensor is present */
   if(isAM2302Present || isAHTx0Present || isBMP280Present)
     isSensorPresent = 1;
 
-  // Wi-Fi : station(client) mode, disconnect previous connection
-  Serial.print(">> Init Wi-Fi...");
-  WiFi.mode(WIFI_AP_STA);             // WiFi.mode(WIFI_STA)
-  WiFi.disconnect();  delay(1000);
-  Serial.println("Done!");
-
-  Serial.println(">> Connect to Wi-Fi...");
+  if(isSensorPresent)
+    sensor_request_all();
 
   if(isCLCDPresent)
   {
     (CLCD_ROW_NUM > 2) ? (lcd.setCursor(0,2)) : (lcd.setCursor(0,0));
-    lcd.print("Connect Network.. ");
+    lcd.print("Connect & Sync..  ");
   }
 
-  while( !(WLAN_Connect(0, 1)) )   // return 1 when establish connect.
+  /**
+   *    wait for 1st NTP reply. (Wi-Fi & sensor readout keep going in boot_poll())
+   *    when time is resumed, don't wait. task_wlan / task_ntp take over.
+   */
+  if(RTC_STORE_CLOCK_NONE != bClockResumed)
   {
-    delay(1000);                // retry every 1 sec.
+    Serial.printf(">> Time resumed (%s), boot %lu ms\r\n",
+                  (RTC_STORE_CLOCK_MEASURED == bClockResumed) ? "measured" : "estimated", (unsigned long)millis());
+    history_restore((uint32_t)(sys_clock_now_ms() / 1000));   // HISTORY_USE_LITTLEFS only
+
+    if(portal_is_requested())
+      portal_run();                   // never returns (restart)
   }
+  else
+  {
+    Serial.printf(">> Connect Wi-Fi & update Time from %s (+%d) ... \r\n", strTimeSvrList[0], (NTP_SERVER_NUM-1));
 
-  /**
-   *    Refresh Display because connected Wi-Fi.
-   */
-  Serial.printf(">> Connected to %s\r\n", foundmyAPssid);
+    while( !boot_poll() )
+    {
+      if(portal_is_requested())
+        portal_run();                 // never returns (restart)
+      yield();                        // feed WDT, let Wi-Fi stack run
+    }
+
+    Serial.printf(">> Connected to %s, Time updated (boot %lu ms)\r\n", foundmyAPssid, (unsigned long)millis());
+  }
+
+  // Display Own IP Address to console
+  Serial.printf(">> Own IP : ");
+  Serial.println(WiFi.localIP());
 
   if(isCLCDPresent)
   {
-    lcd.print("OK");
+    lcd.clear();
   }
 
+
+  /**
+   *    Soft AP is started only by provisioning portal (portal_run())
+   */
+
+  /**
+   *    Initialize Web Server
+   */
+  myServer.on("/", myServer_Root);
+  myServer.on("/api/now", myServer_ApiNow);
+  myServer.on("/api/sensors", myServer_ApiSensors);
+  myServer.on("/api/events", myServer_ApiEvents);
+  myServer.on("/api/stats", myServer_ApiStats);
+  myServer.on("/api/history", myServer_ApiHistory);
+#ifdef OTA_EN
+  ota_init(&myServer, OTA_PASSWORD, ota_on_state);  // + ArduinoOTA listener & mDNS
+  Serial.printf(">> OTA : %s.local\r\n", ota_get_hostname());
+#endif
+  myServer.collectHeaders(web_collect_headers, sizeof(web_collect_headers) / sizeof(web_collect_headers[0]));
+  myServer.begin();
+
+
+  /**
+   *    before entering loop(),
+   *    redraw all screen & set uptime
+   */
+
+  // set uptime
+  uptime_WiFiconnection = GetUptimeSec();
+  uptime_LastTimeSynced = uptime_WiFiconnection;
+
   // clear display
   u8g2.clearDisplay();
   // clear buffer
@@ -1210,154 +1780,694 @@ void setup()
   u8g2.drawStr(16, g_lcd_yPos, my_board_name);
   g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
   // line2
-  u8g2.drawStr(16, g_lcd_yPos, foundmyAPssid.c_str());
+  u8g2.drawStr(16, g_lcd_yPos, foundmyAPssid);
   g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-  // display!
-  u8g2.sendBuffer();
-
-  /**
-   *    Starting NTPClient...
-   */
-  timeClient.begin();
-  Serial.printf(">> Update Time from %s ... ", strTimeSvrURL);
-
-  if(isCLCDPresent)
-  {
-    (CLCD_ROW_NUM > 2) ? (lcd.setCursor(0,3)) : (lcd.setCursor(0,1));
-    lcd.print("Update Time..     ");
-  }
-
   // line3
-  u8g2.drawStr(2,g_lcd_yPos, "Update Time from : ");
-  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
   // line4
-  u8g2.drawStr(10,g_lcd_yPos, strTimeSvrURL);
-  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
   // line5
-  u8g2.drawStr(2,g_lcd_yPos, "Please wait a few seconds...");
-  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-  u8g2.sendBuffer();
+  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
+  // display! (whole screen, partial refresh starts from here)
+  disp_tile_send_all();
 
-  while(1)
-  {
-    if(true == timeClient.update())                     // check connection
-    {
-      G_STATE_SET_BIT(G_STATE_BIT_POS_TIME_SYNC_STATE); // update state
-      break;
-    }
-    delay(1000);
-  }
+  // for clock font
+  u8g2.setFont(u8g2_font_12x6LED_mn); // perfect monospace font
 
   if(isCLCDPresent)
   {
-    lcd.print("OK");
+    // from here, CLCD is written through shadow buffer only
+    clcd_buf_init(&lcd, CLCD_COL_NUM, CLCD_ROW_NUM);
+    clcd_buf_print(0, 0, my_board_name2);
+    clcd_buf_flush();
   }
 
-  Serial.println("Done!");
+  // register tasks (order : tie-break of same priority)
+  sched_init();
+  g_bTaskDisp   = sched_add("disp",   task_disp,   TASK_DISP_PRIO,   (EV_CLOCK_DISP_REDRAW_REQ | EV_CLOCK_DISP_FORCE_REQ), 0, 0, TASK_DISP_BUDGET_US);
+  sched_add("key",    task_key,    TASK_KEY_PRIO,    (EV_KEYPRESS_SHORT_REQ | EV_KEYPRESS_LONG_REQ), 0, 0, TASK_KEY_BUDGET_US);
+  sched_add("timer",  task_timer,  TASK_TIMER_PRIO,  EV_TIMER_TICK, 0, 0, TASK_TIMER_BUDGET_US);
+  sched_add("sys",    task_sys,    TASK_SYS_PRIO,    0, TASK_SYS_PERIOD_MS, 0, 0);
+  sched_add("wlan",   task_wlan,   TASK_WLAN_PRIO,   (EV_WIFI_STATE_CHK_REQ | EV_WIFI_RECONNECT_REQ), TASK_WLAN_PERIOD_MS, TASK_WLAN_DEADLINE_MS, TASK_WLAN_BUDGET_US);
+  sched_add("ntp",    task_ntp,    TASK_NTP_PRIO,    EV_TIME_RESYNC_REQ, TASK_NTP_PERIOD_MS, TASK_NTP_DEADLINE_MS, TASK_NTP_BUDGET_US);
+  g_bTaskSensor = sched_add("sensor", task_sensor, TASK_SENSOR_PRIO, 0, TASK_SENSOR_PERIOD_MS, TASK_SENSOR_DEADLINE_MS, TASK_SENSOR_BUDGET_US);
+  sched_add("http",   task_http,   TASK_HTTP_PRIO,   0, TASK_HTTP_PERIOD_MS, TASK_HTTP_DEADLINE_MS, TASK_HTTP_BUDGET_US);
+  g_bTaskSse    = sched_add("sse",    task_sse,    TASK_SSE_PRIO,    0, TASK_SSE_PERIOD_MS, 0, TASK_SSE_BUDGET_US);
+#ifdef LOW_POWER_MODE_EN
+  g_bTaskPower  = sched_add("power",  task_power,  TASK_POWER_PRIO,  0, TASK_POWER_PERIOD_MS, 0, 0);
+#endif
+#ifdef TIME_MESH_EN
+  sched_add("mesh",   task_mesh,   TASK_MESH_PRIO,   0, TASK_MESH_PERIOD_MS, 0, TASK_MESH_BUDGET_US);
+#endif
 
-  // Display Own IP Address to console
-  Serial.printf(">> Own IP : ");
-  Serial.println(WiFi.localIP());
+  // refused task would never run : make it loud
+  if(sched_get_rejected())
+    Serial.printf(">> [%s] %d task(s) NOT registered, raise SCHED_TASK_MAX (%d)\r\n", __FUNCTION__, sched_get_rejected(), SCHED_TASK_MAX);
 
-  // line6
-  u8g2.drawStr(2,g_lcd_yPos, "Done!");
-  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-  u8g2.drawStr(2,g_lcd_yPos, String(WiFi.localIP().toString()).c_str());
-  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-  u8g2.drawStr(2,g_lcd_yPos, "Change to Clock Mode...");
-  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line7
-  if(isSensorPresent)
-  {
-    u8g2.drawStr(2,g_lcd_yPos, "Sensor is ON-LINE");
-  }
-  else
-  {
-    u8g2.drawStr(2,g_lcd_yPos, "Sensor is OFFLINE");
-  }
-  g_lcd_yPos += LCD_Y_INC_u8g2_font_tiny5_tr;
+  // resumed time is not confirmed yet (request is sent when net is up)
+  if(RTC_STORE_CLOCK_NONE != bClockResumed)
+    sched_post(EV_TIME_RESYNC_REQ);
 
-  /**
-   *    I2C Character LCD
-   */
-  if(isCLCDPresent)
-  {
-    u8g2.drawStr(2,g_lcd_yPos, "I2C CLCD is attached");
-    lcd.clear();
-  }
-  u8g2.sendBuffer();
+  // start timer
+  prof_init(ESP8266_TIMER1_PERIOD_US);
+  timer1_attachInterrupt(onTimerISR);
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+  timer1_write(ESP8266_TIMER1_CNT_VAL);
 
+  // boot is done
+  digitalWrite(ESP8266_LED_PIN, ESP8266_LED_OFF);
+
+}   /*** void setup() ***/
+
+
+
+/**
+  * @brief      task - clock display
+  * @param      dwEvents    EV_CLOCK_DISP_REDRAW_REQ / EV_CLOCK_DISP_FORCE_REQ
+  * @return     none
+  * @note       slow path : timer tick, skipped when displayed second is not changed
+  *             fast path : forced redraw (key feedback etc.)
+  */
+void task_disp(uint32_t dwEvents)
+{
+  uint32_t dwProf;
+
+  if(dwEvents & EV_CLOCK_DISP_REDRAW_REQ)
+    prof_redraw_tick(g_dwTimerTick);
+
+  if( is_disp_clock_changed() || (dwEvents & EV_CLOCK_DISP_FORCE_REQ) )
+  {
+    update_disp_clock(0);
+
+    dwProf = prof_start();
+    update_disp_clock_CLCD(0);
+    prof_stop(PROF_ID_CLCD, dwProf);
+  }
+}
+
+
+
+/**
+  * @brief      task - key press handler
+  * @param      dwEvents    EV_KEYPRESS_SHORT_REQ / EV_KEYPRESS_LONG_REQ
+  * @return     none
+  */
+void task_key(uint32_t dwEvents)
+{
+  // short keypress check
+  if(dwEvents & EV_KEYPRESS_SHORT_REQ)
+  {
+#ifdef DBG_LOG_EN_LOOP
+    Serial.println(">>> key_s");
+#endif
+    // add short key press handler
+
+    // toggle bar display
+    (bProgressBarStatus) ? (bProgressBarStatus = 0) : (bProgressBarStatus = 1);
+
+    // key feedback should not wait for next second
+    sched_post(EV_CLOCK_DISP_FORCE_REQ);
+  }
+
+  // long  keypress check
+  if(dwEvents & EV_KEYPRESS_LONG_REQ)
+  {
+#ifdef DBG_LOG_EN_LOOP
+    Serial.println(">>> key_l");
+#endif
+    // add long  key press handler (force clock sync)
+
+    // force Sync Time / Wi-Fi Connection
+    if( G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE) )
+    {
+      // network is up. just do sync time from server.
+      sched_post(EV_TIME_RESYNC_REQ);
+    }
+    else
+    {
+      // network is down. re-scan and connect new Wi-Fi.
+      sched_post(EV_WIFI_RECONNECT_REQ);
+    }
+  }
+}
+
+
+
+/**
+  * @brief      task - system housekeeping (periodic)
+  * @param      dwEvents    (not used)
+  * @return     none
+  */
+void task_sys(uint32_t dwEvents)
+{
+  // keep time base valid over millis() wrap-around
+  sys_clock_update();
+
+  // last known time for resume after reset (RTC memory only)
+  if(sys_clock_is_set())
+    rtc_store_save_clock(sys_clock_now_ms(), sys_clock_get_drift_ppb());
+
+  // heap watermarks
+  prof_heap_sample();
+
+#ifdef DBG_LOG_EN_PROF
+  if(0 == (GetUptimeSec() % PROF_DUMP_PERIOD_SEC))
+    prof_dump(Serial);
+#endif
+}
+
+
+
+/**
+  * @brief      task - Wi-Fi connection check / re-connection
+  * @param      dwEvents    EV_WIFI_STATE_CHK_REQ / EV_WIFI_RECONNECT_REQ, 0 : periodic
+  * @return     none
+  * @note       scan & connect state machine is stepped on every run, never blocks
+  */
+void task_wlan(uint32_t dwEvents)
+{
+  // check Wi-Fi connection
+  if(dwEvents & EV_WIFI_STATE_CHK_REQ)
+  {
+    uint8_t bTmpWiFiStatus = WiFi.status();
+
+#ifdef DBG_LOG_EN_LOOP
+    Serial.print(">>> net is ");
+#endif
+
+    if(WL_CONNECTED != bTmpWiFiStatus)
+    {
+#ifdef DBG_LOG_EN_LOOP
+        Serial.printf("down (%d)\r\n", bTmpWiFiStatus);
+#endif
+        G_STATE_CLR_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
+    }
+    else
+    {
+        // when AP is OFF -> ON, ESP8266 has reconnect automatically.
+#ifdef DBG_LOG_EN_LOOP
+        Serial.printf("up (%d)\r\n", bTmpWiFiStatus);
+#endif
+        G_STATE_SET_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
+    }
+
+    // scan & connect is ongoing. it updates display by itself.
+    if(!WLAN_IS_BUSY())
+      disp_ssid( G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE) );
+
+  }
+
+  // re-scan and connect new Wi-Fi
+  if(dwEvents & EV_WIFI_RECONNECT_REQ)
+  {
+#ifdef DBG_LOG_EN_LOOP
+    Serial.println(">>> scanning Wi-Fi...");
+#endif
+    if(!bRadioOn)
+    {
+      // low-power : radio is off (e.g. long key press). wake-up starts connection.
+      disp_ssid(3);
+      power_radio_on();
+    }
+    else if( !(G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE)) && !WLAN_IS_BUSY() )
+    {
+      disp_ssid(3);
+      WLAN_Connect_Start(0,0);
+    }
+  }
+
+  // Wi-Fi scan & connect in progress : one step per run
+  if( WLAN_IS_BUSY() )
+  {
+    uint32_t  dwProf = prof_start();
+    uint8_t   bWlanState = WLAN_Connect_Process();
+
+    prof_stop(PROF_ID_SCAN, dwProf);
+
+    switch(bWlanState)
+    {
+      case WLAN_STATE_CONNECTED:
+        disp_ssid(1);
+        g_wlan.bState = WLAN_STATE_IDLE;
+
+        // time is resumed (or sync failed while net was down) : confirm now
+        if(!G_STATE_IS_SET(G_STATE_BIT_POS_TIME_SYNC_STATE))
+          sched_post(EV_TIME_RESYNC_REQ);
+        break;
+
+      case WLAN_STATE_FAILED:
+        G_STATE_CLR_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
+        disp_ssid(0);
+        g_wlan.bState = WLAN_STATE_IDLE;
+        break;
+
+      default:
+        break;
+    }
+  }
+}
+
+
+
+/**
+  * @brief      task - time synchronization
+  * @param      dwEvents    EV_TIME_RESYNC_REQ, 0 : periodic (reply polling)
+  * @return     none
+  */
+void task_ntp(uint32_t dwEvents)
+{
+  uint32_t  dwProf = prof_start();
+  uint8_t   bNtpState;
+
+  // do sync time
+  if(dwEvents & EV_TIME_RESYNC_REQ)
+  {
+#ifdef DBG_LOG_EN_LOOP
+    Serial.print(">>> sync time...");
+#endif
+
+    // clear time sync state
+    G_STATE_CLR_BIT(G_STATE_BIT_POS_TIME_SYNC_STATE);
+
+    if( G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE) )
+    {
+#ifdef TIME_MESH_EN
+      // follower : ask leader over LAN (task_mesh). no leader yet : wait for hold-off.
+      if(time_mesh_has_leader())
+        time_mesh_request();
+      else if( time_mesh_ntp_allowed() && !ntp_async_is_busy() )
+        ntp_async_request();
+#else
+      // send request only. reply is handled below on later run.
+      if( !ntp_async_is_busy() )
+        ntp_async_request();
+#endif
+#ifdef DBG_LOG_EN_LOOP
+      Serial.println("requested");
+#endif
+    }
+    else
+    {
+#ifdef DBG_LOG_EN_LOOP
+      Serial.println("net is down");
+#endif
+    }
+  }
+
+  // NTP reply
+  bNtpState = ntp_async_process();
+  prof_stop(PROF_ID_NTP, dwProf);
+
+  switch(bNtpState)
+  {
+    case NTP_ASYNC_DONE:
+      time_sync_apply(ntp_async_get_result()->qOffsetMs);
+#ifdef TIME_MESH_EN
+      time_mesh_ntp_done();
+#endif
+#ifdef DBG_LOG_EN_LOOP
+      Serial.printf(">>> sync time done! %s offset %d ms, delay %d ms (%d replies)\r\n", ntp_async_get_server_name(ntp_async_get_result()->bServer),
+                    (int32_t)ntp_async_get_result()->qOffsetMs, ntp_async_get_result()->dwDelayMs, ntp_async_get_result()->bReplies);
+      Serial.printf(">>> drift %d ppb, next sync %d sec\r\n", sys_clock_get_drift_ppb(), dwTimeSyncInterval);
+#endif
+      break;
+
+    case NTP_ASYNC_TIMEOUT:
+    case NTP_ASYNC_ERROR:
+      // retry soon (task_timer counts from request), not after a grown interval
+      dwTimeSyncInterval = sys_clock_sync_failed();
+#ifdef DBG_LOG_EN_LOOP
+      Serial.printf(">>> sync time failed! retry in %d sec\r\n", dwTimeSyncInterval);
+#endif
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+/**
+  * @brief      apply a time sync result (NTP or LAN leader)
+  * @param      qOffsetMs   reference time - local time
+  * @return     none
+  */
+void time_sync_apply(int64_t qOffsetMs)
+{
+  // slew (or step if too far), update drift & next sync interval
+  sys_clock_discipline(qOffsetMs);
+  dwTimeSyncInterval    = sys_clock_get_sync_interval();
+  uptime_LastTimeSynced = GetUptimeSec();
+  G_STATE_SET_BIT(G_STATE_BIT_POS_TIME_SYNC_STATE);
+
+  disp_ssid(2);
+}
+
+
+
+#ifdef TIME_MESH_EN
+/**
+  * @brief      task - LAN time mesh (beacon, leader election, exchange with leader)
+  * @param      dwEvents    0 : periodic
+  * @return     none
+  */
+void task_mesh(uint32_t dwEvents)
+{
+  (void)dwEvents;
+
+  if( !G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE) )
+    return;
+
+  switch(time_mesh_process())
+  {
+    case TIME_MESH_DONE:
+      time_sync_apply(time_mesh_get_result()->qOffsetMs);
+#ifdef DBG_LOG_EN_LOOP
+      Serial.printf(">>> mesh sync done! leader %08X offset %d ms, delay %d ms\r\n", time_mesh_get_result()->dwLeaderId,
+                    (int32_t)time_mesh_get_result()->qOffsetMs, time_mesh_get_result()->dwDelayMs);
+#endif
+      break;
+
+    case TIME_MESH_SYNC_REQ:
+      // leader found / lost, or hold-off is over : resync by task_ntp
+      sched_post(EV_TIME_RESYNC_REQ);
+      break;
+
+    case TIME_MESH_TIMEOUT:
+#ifdef DBG_LOG_EN_LOOP
+      Serial.println(">>> mesh sync failed!");
+#endif
+      break;
+
+    default:
+      break;
+  }
+}
+#endif
+
+
+
+
+/**
+  * @brief      format shared sensor reading for display (OLED / CLCD / web)
+  * @param      none
+  * @return     none
+  */
+void update_sensor_strings(void)
+{
+  const sensor_reading_t *pReading = sensor_get_reading();
+
+  if(!pReading->bValid)
+    return;
+
+  fmt_set_temp(pReading->lTemp);
+  fmt_set_humid(pReading->lHumid);        // no humidity sensor : "--.-"
+
+  // trend data (UTC, implicit timestamp)
+  dwSensorSampleUtc = sys_clock_is_set() ? (uint32_t)(sys_clock_now_ms() / 1000) : 0;
+  if(dwSensorSampleUtc)
+    history_add(dwSensorSampleUtc, pReading->lTemp, pReading->lHumid, pReading->lPressure);
+
+  bSensorReadSeq++;   // new value to display
+}
+
+
+
+/**
+  * @brief      task - sensor acquisition (periodic)
+  * @param      dwEvents    (not used)
+  * @return     none
+  * @note       every attached device is read on its own interval (sensor.cpp).
+  *             conversion is not waited, result is collected on later run.
+  */
+void task_sensor(uint32_t dwEvents)
+{
+  uint32_t  dwProf = prof_start();
+  uint8_t   bSensorState = sensor_process();
+
+  prof_stop(PROF_ID_SENSOR, dwProf);
+
+  switch(bSensorState)
+  {
+    case SENSOR_DONE:
+      update_sensor_strings();
+      break;
+
+    case SENSOR_ERROR:
+#ifdef DBG_LOG_EN_LOOP
+      Serial.println(">>> sensor read failed");
+#endif
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+
+/**
+  * @brief      task - web server
+  * @param      dwEvents    (not used)
+  * @return     none
+  */
+void task_http(uint32_t dwEvents)
+{
+  uint32_t dwProf = prof_start();
+
+  // Handling Web Server (OTA_EN : HTTP upload blocks here for whole transfer)
+  myServer.handleClient();
+
+  prof_stop(PROF_ID_HTTP, dwProf);
+
+#ifdef OTA_EN
+  // ArduinoOTA : blocks here for whole transfer, too (not counted in http probe)
+  ota_process();
+#endif
+}
+
+
+
+#ifdef OTA_EN
+/**
+  * @brief      OTA state callback (ota.cpp)
+  * @param      bState      OTA_STATE_xxx
+  * @param      dwDone      bytes written
+  * @param      dwTotal     image size, 0 : unknown
+  * @return     none
+  * @note       flash is erased & written between callbacks. timer1 ISR and
+  *             display / sensor / SSE tasks are paused, only progress is drawn.
+  *             on error, normal operation is resumed (uptime is behind by
+  *             transfer time, as timer1 was stopped).
+  */
+void ota_on_state(uint8_t bState, uint32_t dwDone, uint32_t dwTotal)
+{
+  switch(bState)
+  {
+    case OTA_STATE_START:
+#ifdef DBG_LOG_EN_LOOP
+      Serial.println(">>> OTA start");
+#endif
+      timer1_disable();
+      sched_suspend(g_bTaskDisp, 1);
+      sched_suspend(g_bTaskSensor, 1);
+      sched_suspend(g_bTaskSse, 1);
+      sched_suspend(g_bTaskPower, 1);       // radio must stay on
+      disp_ota(bState, dwDone, dwTotal);
+      break;
+
+    case OTA_STATE_PROGRESS:
+      disp_ota(bState, dwDone, dwTotal);
+      break;
+
+    case OTA_STATE_END:
+#ifdef DBG_LOG_EN_LOOP
+      Serial.println(">>> OTA done, restart");
+#endif
+      disp_ota(bState, dwDone, dwTotal);
+      break;
+
+    case OTA_STATE_ERROR:
+#ifdef DBG_LOG_EN_LOOP
+      Serial.println(">>> OTA failed!");
+#endif
+      disp_ota(bState, dwDone, dwTotal);
+
+      // resume : timer, tasks, whole screen
+      prof_isr_rearm();                     // no jitter sample over pause, /api/stats kept
+      timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+      timer1_write(ESP8266_TIMER1_CNT_VAL);
+      sched_suspend(g_bTaskDisp, 0);
+      sched_suspend(g_bTaskSensor, 0);
+      sched_suspend(g_bTaskSse, 0);
+      sched_suspend(g_bTaskPower, 0);
+
+      disp_clear_area(0, 0, LCD_WIDTH, LCD_HEIGHT);
+      disp_ssid(G_STATE_IS_SET(G_STATE_BIT_POS_TIME_SYNC_STATE) ? 2 : 1);
+      disp_clock_invalidate();
+      sched_post(EV_CLOCK_DISP_FORCE_REQ);
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+
+/**
+  * @brief      OTA progress screen
+  * @param      bState      OTA_STATE_xxx
+  * @param      dwDone      bytes written
+  * @param      dwTotal     image size, 0 : unknown
+  * @return     none
+  * @note       top area : state & percent, time display zone : progress bar
+  */
+void disp_ota(uint8_t bState, uint32_t dwDone, uint32_t dwTotal)
+{
+  char szLine[32];
+
+  if(OTA_STATE_START == bState)
+    disp_clear_area(0, 0, LCD_WIDTH, LCD_HEIGHT);
+  else
+    disp_clear_area(0, 0, LCD_WIDTH, LCD_Y_OFFSET_STARTBLUE);
+
+  // icon (line1 & line2)
+  u8g2.setFont(u8g2_font_siji_t_6x10);
+  u8g2.drawGlyph(2, (LCD_Y_POS_INIT+2), ICO_INFO);
+
+  // line1
+  u8g2.setFont(u8g2_font_tiny5_tr);
+  u8g2.drawStr(16, LCD_Y_POS_INIT, my_board_name);
+
+  // line2
+  if(OTA_STATE_END == bState)
+    snprintf(szLine, sizeof(szLine), "FW UPDATE DONE, RESTART");
+  else if(OTA_STATE_ERROR == bState)
+    snprintf(szLine, sizeof(szLine), "FW UPDATE FAILED");
+  else if(dwTotal)
+    snprintf(szLine, sizeof(szLine), "FW UPDATE %u%%", (unsigned)(((uint64_t)dwDone * 100) / dwTotal));
+  else
+    snprintf(szLine, sizeof(szLine), "FW UPDATE %uK", (unsigned)(dwDone / 1024));
+  u8g2.drawStr(16, (LCD_Y_POS_INIT + LCD_Y_INC_u8g2_font_tiny5_tr), szLine);
+
+  // bar (time display zone)
+  disp_clear_area(4, (LCD_Y_OFFSET_STARTBLUE + 4), (LCD_WIDTH - 8), 9);
+  misc_draw_bar(u8g2.getU8g2(), 4, (LCD_Y_OFFSET_STARTBLUE + 4), (LCD_WIDTH - 8), 9,
+                ((OTA_STATE_END == bState) ? 1 : dwDone), ((OTA_STATE_END == bState) ? 1 : dwTotal), 0);
+
+  // display! (touched tiles only)
+  disp_tile_flush();
+}
+#endif
+
+
+
+/**
+  * @brief      task - push events to SSE subscribers
+  * @param      dwEvents    (not used)
+  * @return     none
+  * @note       "now" once a second, "sensors" on every new readout.
+  *             payload is same as /api/now, /api/sensors.
+  */
+void task_sse(uint32_t dwEvents)
+{
+  static uint32_t dwLastUtc = 0;
+  static uint8_t  bLastSeq  = 0;
+  char            szBuf[160];
+  uint32_t        dwUtc;
+
+  if(0 == sse_get_client_num())
+    return;
+
+  dwUtc = (uint32_t)(sys_clock_now_ms() / 1000);
+  if(dwUtc != dwLastUtc)
+  {
+    dwLastUtc = dwUtc;
+    web_json_now(szBuf, sizeof(szBuf), dwUtc);
+    sse_broadcast("now", szBuf);
+  }
+
+  if(bSensorReadSeq != bLastSeq)
+  {
+    bLastSeq = bSensorReadSeq;
+    web_json_sensors(szBuf, sizeof(szBuf));
+    sse_broadcast("sensors", szBuf);
+  }
+}
+
+
+
+/**
+  * @brief      wake radio up and reconnect
+  * @param      none
+  * @return     none
+  * @note       connection uses rtc_store cache (fast reconnect), so a window
+  *             costs only a few seconds of full radio current.
+  */
+void power_radio_on(void)
+{
+  if(bRadioOn)
+    return;
 
-  /**
-   *    Long delay for display own IP address
-   */
-  delay(3000);
+  WiFi.forceSleepWake();
+  bRadioOn            = 1;
+  uptime_RadioChanged = GetUptimeSec();
 
+  WLAN_Connect_Start(0, 0);
+}
 
-  /**
-   *    !! disable !! Initialize Soft AP
-   */
-  // WiFi.softAP(my_board_name, softap_password);
 
-  /**
-   *    Initialize Web Server
-   */
-  myServer.on("/", myServer_Root);
-  myServer.begin();
 
+/**
+  * @brief      switch radio off (force modem sleep)
+  * @param      none
+  * @return     none
+  */
+void power_radio_off(void)
+{
+  if(!bRadioOn)
+    return;
 
-  /**
-   *    before entering loop(),
-   *    redraw all screen & set uptime
-   */
+  WiFi.disconnect();
+  WiFi.forceSleepBegin();
+  G_STATE_CLR_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
+  g_wlan.bState       = WLAN_STATE_IDLE;
+  bRadioOn            = 0;
+  uptime_RadioChanged = GetUptimeSec();
+}
 
-  // set uptime
-  uptime_WiFiconnection = timeClient.getEpochTime();
-  uptime_LastTimeSynced = uptime_WiFiconnection;
 
-  // clear display
-  u8g2.clearDisplay();
-  // clear buffer
-  u8g2.clearBuffer();
-  // icon (line1 & line2)
-  g_lcd_yPos = LCD_Y_POS_INIT;
-  u8g2.setFont(u8g2_font_siji_t_6x10);
-  u8g2.drawGlyph(2, (g_lcd_yPos+2), ICO_WIFI_FULL);
-  // text
-  u8g2.setFont(u8g2_font_tiny5_tr);
-  // line1
-  u8g2.drawStr(16, g_lcd_yPos, my_board_name);
-  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line2
-  u8g2.drawStr(16, g_lcd_yPos, foundmyAPssid.c_str());
-  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line3
-  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line4
-  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-  // line5
-  g_lcd_yPos = g_lcd_yPos + LCD_Y_INC_u8g2_font_tiny5_tr;
-  // display!
-  u8g2.sendBuffer();
 
-  // for clock font
-  u8g2.setFont(u8g2_font_12x6LED_mn); // perfect monospace font
+/**
+  * @brief      task - radio wake-up windows (LOW_POWER_MODE_EN)
+  * @param      dwEvents    (not used)
+  * @return     none
+  * @note       radio on  : every LOW_POWER_WEB_PERIOD_SEC, or after LOW_POWER_RETRY_SEC
+  *                         while time sync is pending (TIME_SYNC_STATE cleared by task_ntp).
+  *                         time sync request is posted on connection (task_wlan).
+  *             radio off : LOW_POWER_WEB_WINDOW_SEC elapsed and nothing in progress
+  *                         (scan / connect, NTP, SSE subscriber).
+  */
+void task_power(uint32_t dwEvents)
+{
+  uint32_t dwSpan = GetUptimeSec() - uptime_RadioChanged;
 
-  if(isCLCDPresent)
+  if(!bRadioOn)
   {
-    lcd.setCursor(0,0);
-    lcd.printstr(my_board_name2);
+    if( (dwSpan >= LOW_POWER_WEB_PERIOD_SEC) ||
+        (!G_STATE_IS_SET(G_STATE_BIT_POS_TIME_SYNC_STATE) && (dwSpan >= LOW_POWER_RETRY_SEC)) )
+    {
+      power_radio_on();
+    }
+    return;
   }
 
-  // start timer
-  timer1_attachInterrupt(onTimerISR);
-  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
-  timer1_write(ESP8266_TIMER1_CNT_VAL);
-
-  // refresh time from NTP server before entering loop()
-  timeClient.update();
+  if( (dwSpan < LOW_POWER_WEB_WINDOW_SEC) || WLAN_IS_BUSY() || ntp_async_is_busy() || sse_get_client_num() )
+    return;
 
-}   /*** void setup() ***/
+  power_radio_off();
+}
 
 
 
@@ -1366,232 +2476,399 @@ void setup()
   * @param      none
   * @return     none
   * @note       put your main code here, to run repeatedly:
+  *             runs one ready task (highest priority first) and returns,
+  *             so Wi-Fi stack is served between tasks.
   */
 void loop()
 {
-  // short keypress check
-  if( G_STATE_IS_SET(G_STATE_BIT_POS_KEYPRESS_SHORT_REQ) )
+  if( !sched_run() )
   {
-#ifdef DBG_LOG_EN_LOOP
-    Serial.println(">>> key_s");
+#ifdef LOW_POWER_MODE_EN
+    delay(LOW_POWER_IDLE_MS);         // nothing is ready : SDK may enter modem-sleep
 #endif
-    // add short key press handler
+  }
 
-    // toggle bar display
-    (bProgressBarStatus) ? (bProgressBarStatus = 0) : (bProgressBarStatus = 1);
+}   /*** void loop() ***/
 
-    G_STATE_CLR_BIT(G_STATE_BIT_POS_KEYPRESS_SHORT_REQ);
 
-  }
 
-  // long  keypress check
-  if( G_STATE_IS_SET(G_STATE_BIT_POS_KEYPRESS_LONG_REQ) )
-  {
-#ifdef DBG_LOG_EN_LOOP
-    Serial.println(">>> key_l");
-#endif
-    // add long  key press handler (force clock sync)
+/* static root page : cached by browser, values are polled from /api/xxx */
+static const char web_root_page[] PROGMEM = R"HTML(<!DOCTYPE html>
+<html>
+<head>
+<meta charset="UTF-8">
+<title>Wi-Fi Clock</title>
+</head>
+<body>
+<h1 id="now">--</h1>
+<p>
+Temp  (&#8451;)    <span id="temp">--.-</span><br>
+Humid (%)    <span id="humid">--.-</span><br>
+Press (hPa)   <span id="press">--.-</span>
+</p>
+<p>*** values are pushed by device (or refreshed about every 5 seconds) ***</p>
+<script>
+function $(i){return document.getElementById(i);}
+function v(x){return (x===null)?'--.-':x.toFixed(2);}
+function now(d){document.title=d.name;$('now').textContent=d.date+'  '+d.time+'  ('+d.wday+')';}
+function sens(d){$('temp').textContent=v(d.temp);$('humid').textContent=v(d.humid);$('press').textContent=v(d.press);}
+function get(u,f){fetch(u).then(function(r){return r.json();}).then(f).catch(function(){});}
+function poll(){get('/api/now',now);get('/api/sensors',sens);}
+var t=null;
+function fallback(){if(!t){poll();t=setInterval(poll,5000);}}
+poll();
+if(window.EventSource){
+var es=new EventSource('/api/events');
+es.addEventListener('now',function(e){now(JSON.parse(e.data));});
+es.addEventListener('sensors',function(e){sens(JSON.parse(e.data));});
+es.onopen=function(){if(t){clearInterval(t);t=null;}};
+es.onerror=fallback;
+}else{fallback();}
+</script>
+</body>
+</html>
+)HTML";
 
-    // force Sync Time / Wi-Fi Connection
-    if( G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE) )
-    {
-      // network is up. just do sync time from server.
-      G_STATE_SET_BIT(G_STATE_BIT_POS_TIME_RESYNC_REQ);
-    }
-    else
-    {
-      // network is down. re-scan and connect new Wi-Fi.
-      G_STATE_SET_BIT(G_STATE_BIT_POS_WIFI_RECONNECT_REQ);
-    }
 
-    G_STATE_CLR_BIT(G_STATE_BIT_POS_KEYPRESS_LONG_REQ);
+/**
+ * @brief   root page of web server
+ * @param   none
+ * @return  none
+ * @note    page is static, so browser keeps it. values come from /api/events
+ *          (push) or polling /api/now, /api/sensors when push is not available
+ */
+void myServer_Root(void)
+{
+  myServer.sendHeader("Cache-Control", "max-age=86400");
+  myServer.send_P(200, "text/html", web_root_page);
+  return;
+}
 
-  }
 
-  // update clock display
-  if( G_STATE_IS_SET(G_STATE_BIT_POS_CLOCK_DISP_REDRAW_REQ) )
-  {
-    update_disp_clock(0);
-    update_disp_clock_CLCD(0);
 
-    G_STATE_CLR_BIT(G_STATE_BIT_POS_CLOCK_DISP_REDRAW_REQ);
+/**
+ * @brief   set ETag of response and check conditional request
+ * @param   szETag    entity tag (incl. double quotes)
+ * @return  1 : matched, 304 is sent already  / 0 : send body
+ * @note    "no-cache" makes browser revalidate with If-None-Match every time
+ */
+static uint8_t myServer_NotModified(const char *szETag)
+{
+  myServer.sendHeader("ETag", szETag);
+  myServer.sendHeader("Cache-Control", "no-cache");
 
+  if( myServer.hasHeader("If-None-Match") &&
+      (0 == strcmp(myServer.header("If-None-Match").c_str(), szETag)) )
+  {
+    myServer.send(304);
+    return 1;
   }
+  return 0;
+}
 
-  // check Wi-Fi connection
-  if( G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_STATE_CHK_REQ) )
-  {
-    uint8_t bTmpWiFiStatus = WiFi.status();
 
-#ifdef DBG_LOG_EN_LOOP
-    Serial.print(">>> net is ");
-#endif
 
-    G_STATE_CLR_BIT(G_STATE_BIT_POS_WIFI_STATE_CHK_REQ);
+/**
+ * @brief   format fixed-point value as JSON number
+ * @param   pBuf      destination, at least FMT_VALUE_STR_LEN bytes
+ * @param   lCenti    value x 100, SENSOR_VALUE_INVALID : null
+ * @return  pBuf
+ */
+static const char *myServer_JsonCenti(char *pBuf, int32_t lCenti)
+{
+  if(SENSOR_VALUE_INVALID == lCenti)
+    strcpy(pBuf, "null");
+  else
+    fmt_centi(lCenti, pBuf);
+  return pBuf;
+}
 
-    if(WL_CONNECTED != bTmpWiFiStatus)
-    {
-#ifdef DBG_LOG_EN_LOOP
-        Serial.printf("down (%d)\r\n", bTmpWiFiStatus);
-#endif
-        G_STATE_CLR_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
-    }
-    else
-    {
-        // when AP is OFF -> ON, ESP8266 has reconnect automatically.
-#ifdef DBG_LOG_EN_LOOP
-        Serial.printf("up (%d)\r\n", bTmpWiFiStatus);
-#endif
-        G_STATE_SET_BIT(G_STATE_BIT_POS_WIFI_CONN_STATE);
-    }
 
-    disp_ssid( G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE) );
 
-  }
+/**
+ * @brief   format current date & time as JSON
+ * @param   pBuf      destination
+ * @param   nSize     size of pBuf (160 bytes is enough)
+ * @param   dwUtc     UTC epoch (sec)
+ * @return  none
+ */
+static void web_json_now(char *pBuf, size_t nSize, uint32_t dwUtc)
+{
+  snprintf(pBuf, nSize,
+           "{\"name\":\"%s\",\"date\":\"%s\",\"time\":\"%s\",\"wday\":\"%s\",\"utc\":%lu,\"set\":%u}",
+           my_board_name,
+           calendar_get_date_str(),
+           fmt_get_time(sys_clock_get_epoch()),
+           daysOfTheWeek[sys_clock_get_day()],
+           (unsigned long)dwUtc,
+           (unsigned)sys_clock_is_set());
+}
 
-  // re-scan and connect new Wi-Fi
-  if( G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_RECONNECT_REQ) )
-  {
-#ifdef DBG_LOG_EN_LOOP
-    Serial.println(">>> scanning Wi-Fi...");
-#endif
-    disp_ssid(3);
 
-    if(!(G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE)))
-    {
-      WLAN_Connect(0,0);
-    }
 
-    G_STATE_CLR_BIT(G_STATE_BIT_POS_WIFI_RECONNECT_REQ);
+/**
+ * @brief   format latest fused sensor reading as JSON
+ * @param   pBuf      destination
+ * @param   nSize     size of pBuf (128 bytes is enough)
+ * @return  none
+ */
+static void web_json_sensors(char *pBuf, size_t nSize)
+{
+  const sensor_reading_t *pReading = sensor_get_reading();
+  char      szTemp[FMT_VALUE_STR_LEN], szHumid[FMT_VALUE_STR_LEN], szPress[FMT_VALUE_STR_LEN];
+  uint8_t   bValid = pReading->bValid;
+
+  snprintf(pBuf, nSize,
+           "{\"seq\":%u,\"utc\":%lu,\"src\":%u,\"temp\":%s,\"humid\":%s,\"press\":%s}",
+           (unsigned)bSensorReadSeq,
+           (unsigned long)dwSensorSampleUtc,
+           (unsigned)(bValid ? pReading->bSources : 0),
+           myServer_JsonCenti(szTemp,  bValid ? pReading->lTemp     : SENSOR_VALUE_INVALID),
+           myServer_JsonCenti(szHumid, bValid ? pReading->lHumid    : SENSOR_VALUE_INVALID),
+           myServer_JsonCenti(szPress, bValid ? pReading->lPressure : SENSOR_VALUE_INVALID));
+}
 
-  }
 
-  // do sync time
-  if( G_STATE_IS_SET(G_STATE_BIT_POS_TIME_RESYNC_REQ) )
-  {
-#ifdef DBG_LOG_EN_LOOP
-    Serial.print(">>> sync time...");
-#endif
 
-    if( G_STATE_IS_SET(G_STATE_BIT_POS_WIFI_CONN_STATE) )
-    {
+/**
+ * @brief   /api/now : current date & time
+ * @param   none
+ * @return  none
+ * @note    ETag is UTC epoch, body changes once a second
+ */
+void myServer_ApiNow(void)
+{
+  char      szETag[16];
+  char      szBuf[160];
+  uint32_t  dwUtc = (uint32_t)(sys_clock_now_ms() / 1000);
 
-      if(true == timeClient.update() )  // done / fail
-      {
-        uptime_LastTimeSynced = timeClient.getEpochTime();
-        G_STATE_SET_BIT(G_STATE_BIT_POS_TIME_SYNC_STATE);
-#ifdef DBG_LOG_EN_LOOP
-        Serial.println("done!");
-#endif
-        disp_ssid(2);
-      }
-      else
-      {
-#ifdef DBG_LOG_EN_LOOP
-        Serial.println("failed!");
-        // decrease INTERVAL_GET_TIME_FROM_NET?
-#endif
-      }
-    }
-    else
-    {
-#ifdef DBG_LOG_EN_LOOP
-      Serial.println("net is down");
-#endif
-    }
+  snprintf(szETag, sizeof(szETag), "\"t%lu\"", (unsigned long)dwUtc);
+  if(myServer_NotModified(szETag))
+    return;
 
-    G_STATE_CLR_BIT(G_STATE_BIT_POS_TIME_RESYNC_REQ);
+  web_json_now(szBuf, sizeof(szBuf), dwUtc);
+  myServer.send(200, "application/json", szBuf);
+  return;
+}
 
-  }
 
-  if( G_STATE_IS_SET(G_STATE_BIT_POS_SENSOR_READ_REQ) )
-  {
-    // readout from one of attached sensor
-    if(isAHTx0Present)             // 1st
-    {
-      ahtx0.getEvent(&aht_humid, &aht_temp);
-      // Serial.print(">> AHT20 Humidity(% rH) : ");
-      // Serial.println(aht_humid.relative_humidity);
-      // Serial.print(">> AHT20 Temp('C') : ");
-      // Serial.println(aht_temp.temperature);
-      // Serial.println("Read AHTx0");
-    }
-    else if(isAM2302Present)       // 2nd
-    {
-      am2302.read();
-      // am2302.get_Temperature();
-      // am2302.get_Humidity();
-      // Serial.println("Read AM2302");
-    }
-    else if(isBMP280Present)       // 3rd
-    {
-      // BMP280 doesn't support humidity
-      //  bmp280.readTemperature();
-      //  bmp280.readPressure();      // units : Pa
-      // Serial.println("Read BMP280");
-    }
-    else
-    {
-      // no sensor - do nothing
-    }
 
-    G_STATE_CLR_BIT(G_STATE_BIT_POS_SENSOR_READ_REQ);
+/**
+ * @brief   /api/sensors : latest fused sensor reading
+ * @param   none
+ * @return  none
+ * @note    ETag is sample epoch + sequence, so 304 until next readout
+ */
+void myServer_ApiSensors(void)
+{
+  char      szETag[24];
+  char      szBuf[128];
+
+  snprintf(szETag, sizeof(szETag), "\"s%lu-%u\"", (unsigned long)dwSensorSampleUtc, (unsigned)bSensorReadSeq);
+  if(myServer_NotModified(szETag))
+    return;
+
+  web_json_sensors(szBuf, sizeof(szBuf));
+  myServer.send(200, "application/json", szBuf);
+  return;
+}
+
+
+
+/**
+ * @brief   /api/events : Server-Sent Events stream ("now", "sensors")
+ * @param   none
+ * @return  none
+ * @note    connection is kept by sse.cpp, events are sent by task_sse().
+ *          503 when all SSE_CLIENT_MAX slots are in use (browser polls).
+ */
+void myServer_ApiEvents(void)
+{
+  WiFiClient client = myServer.client();
+
+  if(!sse_subscribe(client))
+    myServer.send(503, "text/plain", "too many subscribers");
+  return;
+}
+
+
+
+/**
+ * @brief   /api/stats : scheduler, profiling probes & heap statistics
+ * @param   none
+ * @return  none
+ * @note    chunked, one task / probe per chunk (no large buffer).
+ *          "?reset=1" clears probes & watermarks after response.
+ *          histogram buckets : see prof.h
+ */
+void myServer_ApiStats(void)
+{
+  const prof_sys_t  *pSys = prof_get_sys();
+  char              szBuf[384];       // probe incl. 16 histogram counts
+  int               nLen;
+
+  prof_heap_sample();
+
+  myServer.sendHeader("Cache-Control", "no-store");
+  myServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  myServer.send(200, "application/json", "");
+
+  snprintf(szBuf, sizeof(szBuf),
+           "{\"uptime\":%lu,\"heap\":{\"free\":%lu,\"free_min\":%lu,\"block_min\":%lu,\"frag_max\":%u},"
+           "\"redraw_missed\":%lu,\"sse_clients\":%u,\"tasks\":[",
+           (unsigned long)GetUptimeSec(),
+           (unsigned long)pSys->dwHeapFree,
+           (unsigned long)pSys->dwHeapFreeMin,
+           (unsigned long)pSys->dwHeapBlockMin,
+           (unsigned)pSys->bHeapFragMax,
+           (unsigned long)pSys->dwRedrawMissed,
+           (unsigned)sse_get_client_num());
+  myServer.sendContent(szBuf);
+
+  for(uint8_t i = 0; i < sched_get_task_num(); i++)
+  {
+    const sched_task_t *pTask = sched_get_task(i);
+
+    snprintf(szBuf, sizeof(szBuf),
+             "%s{\"name\":\"%s\",\"runs\":%lu,\"max_us\":%lu,\"overruns\":%lu,\"missed\":%lu}",
+             (i ? "," : ""),
+             pTask->szName,
+             (unsigned long)pTask->dwRuns,
+             (unsigned long)pTask->dwMaxUs,
+             (unsigned long)pTask->dwOverruns,
+             (unsigned long)pTask->dwMissed);
+    myServer.sendContent(szBuf);
   }
+  myServer.sendContent("],\"probes\":[");
 
-  // Handling Web Server
-  myServer.handleClient();
+  for(uint8_t i = 0; i < PROF_ID_NUM; i++)
+  {
+    const prof_probe_t *pProbe = prof_get_probe(i);
+
+    nLen = snprintf(szBuf, sizeof(szBuf),
+                    "%s{\"name\":\"%s\",\"n\":%lu,\"avg_us\":%lu,\"p99_us\":%lu,\"max_us\":%lu,\"hist\":[",
+                    (i ? "," : ""),
+                    prof_get_name(i),
+                    (unsigned long)pProbe->dwCount,
+                    (unsigned long)(pProbe->dwCount ? (pProbe->qwSumUs / pProbe->dwCount) : 0),
+                    (unsigned long)prof_get_p99_us(i),
+                    (unsigned long)pProbe->dwMaxUs);
+    for(uint8_t k = 0; (k < PROF_HIST_BUCKET_NUM) && (nLen < (int)sizeof(szBuf)); k++)
+      nLen += snprintf(&szBuf[nLen], sizeof(szBuf) - nLen, "%s%lu", (k ? "," : ""), (unsigned long)pProbe->dwHist[k]);
+    myServer.sendContent(szBuf);
+    myServer.sendContent("]}");
+  }
+  myServer.sendContent("]}");
+  myServer.sendContent("");
 
-}   /*** void loop() ***/
+  if(myServer.hasArg("reset"))
+    prof_reset();
+  return;
+}
 
 
 
 /**
- * @brief   root page of web server
+ * @brief   /api/history : sensor history summary & downsampled samples
  * @param   none
  * @return  none
- * @note    can be access when Soft-AP is not running
+ * @note    "?span=<min>" window (default & max. 24 h), "?step=<min>" per point (default 10).
+ *          summary : min / max / avg over window. samples : oldest first,
+ *          [utc, temp, humid, press], average of step, null : no value.
+ *          units are same as /api/sensors. chunked, points are batched.
+ *          ETag is newest sample + query, so 304 until next minute.
  */
-void myServer_Root(void)
+void myServer_ApiHistory(void)
 {
-  String message;
-  String reserve(5000);
-
-  message  = F("<!DOCTYPE html>\n"
-              "<html>\n"
-              "<head>\n"
-              "<meta charset=\"UTF-8\">\n"
-              "<meta http-equiv=\"Refresh\" content=\"5\">\n"
-              "<title>"
-              );
-  message += (my_board_name);
-  message += F("</title>\n");
-  message += F("</head>\n");
-  message += F("<body>\n");
-  message += F("<h1> ");
-  message += (strCurrDate.c_str());
-  message += F("  ");
-  message += (timeClient.getFormattedTime().c_str());
-  message += F("  (");
-  message += (daysOfTheWeek[timeClient.getDay()]);
-  message += F(")\n");
-  message += F("</h1>\n");
-  message += F("<p> ");
-  message += F("Temp  (℃)    ");
-  message += (StrTemp.c_str());
-  message += F("<br>");
-  message += F("Humid (%)    ");
-  message += (StrHumid.c_str());
-  message += F("</p> ");
-  message += F("<p> ");
-  message += F("*** this page is refresh automatically abut every 5 seconds ***");
-  message += F("</p> ");
-  message += F("</body>\n");
-  message += F("</html>\n");
-
-  // Serial.println("WebServer");
-  // myServer.send(200, "text/plane", "Hello world!");
-  // myServer.send(200, "text/plane", timeClient.getFormattedTime().c_str());
-
-  myServer.send(200, "text/html", message);
+  history_summary_t summary;
+  const history_stat_t *pStat[3] = { &summary.temp, &summary.humid, &summary.pressure };
+  const char        *szKey[3]    = { "temp", "humid", "press" };
+  char              szETag[40];
+  char              szBuf[512];
+  char              szVal[3][3][FMT_VALUE_STR_LEN];
+  uint32_t          dwSpan = HISTORY_SAMPLE_NUM;
+  uint32_t          dwStep = 10;
+  uint16_t          wCount;
+  int               nLen;
+
+  if(myServer.hasArg("span"))
+    dwSpan = (uint32_t)myServer.arg("span").toInt() * 60 / HISTORY_INTERVAL_SEC;
+  if(myServer.hasArg("step"))
+    dwStep = (uint32_t)myServer.arg("step").toInt() * 60 / HISTORY_INTERVAL_SEC;
+  dwSpan = constrain(dwSpan, 1UL, (uint32_t)HISTORY_SAMPLE_NUM);
+  dwStep = constrain(dwStep, 1UL, dwSpan);
+
+  snprintf(szETag, sizeof(szETag), "\"h%lu-%u-%lu-%lu\"", (unsigned long)history_get_newest_time(),
+           (unsigned)history_get_count(), (unsigned long)dwSpan, (unsigned long)dwStep);
+  if(myServer_NotModified(szETag))
+    return;
+
+  history_get_summary((uint16_t)dwSpan, &summary);
+  wCount = (history_get_count() < dwSpan) ? history_get_count() : (uint16_t)dwSpan;
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    myServer_JsonCenti(szVal[i][0], pStat[i]->lMin);
+    myServer_JsonCenti(szVal[i][1], pStat[i]->lMax);
+    myServer_JsonCenti(szVal[i][2], pStat[i]->lAvg);
+  }
+
+  myServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  myServer.send(200, "application/json", "");
+
+  nLen = snprintf(szBuf, sizeof(szBuf), "{\"interval\":%u,\"step\":%lu,\"from\":%lu,\"to\":%lu,\"summary\":{",
+                  (unsigned)HISTORY_INTERVAL_SEC, (unsigned long)(dwStep * HISTORY_INTERVAL_SEC),
+                  (unsigned long)summary.dwFrom, (unsigned long)summary.dwTo);
+  for(uint8_t i = 0; i < 3; i++)
+    nLen += snprintf(&szBuf[nLen], sizeof(szBuf) - nLen, "%s\"%s\":{\"min\":%s,\"max\":%s,\"avg\":%s,\"n\":%u}",
+                     (i ? "," : ""), szKey[i], szVal[i][0], szVal[i][1], szVal[i][2], (unsigned)pStat[i]->wCount);
+  myServer.sendContent(szBuf);
+  myServer.sendContent("},\"samples\":[");
+
+  // oldest point first. 1st point may be shorter (window is not multiple of step).
+  nLen = 0;
+  for(int32_t lAgo = (int32_t)wCount - 1; lAgo >= 0; )
+  {
+    int32_t   lSum[3]   = { 0, 0, 0 };
+    uint16_t  wNum[3]   = { 0, 0, 0 };
+    uint32_t  dwPtUtc   = 0;
+    uint32_t  dwLen     = ((uint32_t)(lAgo + 1) % dwStep) ? ((uint32_t)(lAgo + 1) % dwStep) : dwStep;
+
+    for(uint32_t k = 0; k < dwLen; k++, lAgo--)
+    {
+      uint32_t  dwUtc;
+      int32_t   lValue[3];
+
+      if(!history_get_sample((uint16_t)lAgo, &dwUtc, &lValue[0], &lValue[1], &lValue[2]))
+        continue;
+      if(0 == k)
+        dwPtUtc = dwUtc;
+
+      for(uint8_t i = 0; i < 3; i++)
+      {
+        if(HISTORY_VALUE_INVALID == lValue[i])
+          continue;
+        lSum[i] += lValue[i];
+        wNum[i]++;
+      }
+    }
+
+    for(uint8_t i = 0; i < 3; i++)
+      myServer_JsonCenti(szVal[0][i], (wNum[i]) ? (lSum[i] / (int32_t)wNum[i]) : HISTORY_VALUE_INVALID);
+
+    if(nLen > (int)(sizeof(szBuf) - 64))
+    {
+      myServer.sendContent(szBuf);
+      nLen = 0;
+    }
+    nLen += snprintf(&szBuf[nLen], sizeof(szBuf) - nLen, "%s[%lu,%s,%s,%s]",
+                     ((lAgo + 1 + (int32_t)dwLen) < (int32_t)wCount) ? "," : "",
+                     (unsigned long)dwPtUtc, szVal[0][0], szVal[0][1], szVal[0][2]);
+  }
+  if(nLen)
+    myServer.sendContent(szBuf);
+
+  myServer.sendContent("]}");
+  myServer.sendContent("");
   return;
 }
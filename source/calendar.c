@@ -0,0 +1,140 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : calendar.c
+  * @brief          : constant-time epoch -> date conversion with day cache
+  ******************************************************************************
+  * @attention
+  *
+  *   replaces year-by-year / month-by-month loop of utc_timestamp_to_date().
+  *   nothing is allocated, no global table is modified.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "calendar.h"
+
+/* Defines -------------------------------------------------------------------*/
+#define CALENDAR_WEEKDAY_OFFSET       4       // 1970-01-01 is THU
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+static uint32_t     dwCachedDay                       = 0xFFFFFFFF;   // days since 1970-01-01
+static timestamp_t  cachedMidnight                    = 0;
+static datetime_t   cachedDate                        = {0};
+static char         szCachedDate[CALENDAR_DATE_STR_LEN] = "0000-00-00";
+
+/* Function prototypes -------------------------------------------------------*/
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      days since 1970-01-01 -> civil date
+  * @param      dwDays        days since 1970-01-01
+  * @param      pYear, pMonth, pDay   (out) date, month 1~12, day 1~31
+  * @param      pDayOfYear    (out) 0 : Jan 1st, may be NULL
+  * @note       constant time. era = 400 years (146097 days), year starts at March
+  *             so that leap day is the last day of the year.
+  */
+void calendar_civil_from_days(uint32_t dwDays, uint16_t *pYear, uint8_t *pMonth, uint8_t *pDay, uint16_t *pDayOfYear)
+{
+  uint32_t z    = dwDays + 719468;                                    // shift epoch to 0000-03-01
+  uint32_t era  = z / 146097;
+  uint32_t doe  = z - era * 146097;                                   // [0, 146096]
+  uint32_t yoe  = (doe - doe/1460 + doe/36524 - doe/146096) / 365;    // [0, 399]
+  uint32_t doy  = doe - (365*yoe + yoe/4 - yoe/100);                  // [0, 365], from March 1st
+  uint32_t mp   = (5*doy + 2) / 153;                                  // [0, 11], March = 0
+  uint32_t y    = yoe + era * 400;
+  uint32_t m    = (mp < 10) ? (mp + 3) : (mp - 9);
+  uint8_t  leap;
+
+  if(m <= 2)
+    y++;
+
+  *pYear  = (uint16_t)y;
+  *pMonth = (uint8_t)m;
+  *pDay   = (uint8_t)(doy - (153*mp + 2)/5 + 1);
+
+  if(pDayOfYear)
+  {
+    leap = ((y % 4 == 0) && ((y % 100) != 0)) || ((y % 400) == 0);
+    *pDayOfYear = (uint16_t)( (mp >= 10) ? (doy - 306) : (doy + 59 + leap) );
+  }
+}
+
+
+/**
+  * @brief      epoch -> date & time, date part cached per day
+  * @param      timestamp   seconds (local time)
+  * @param      pDateTime   (out)
+  * @return     0 : same day as previous call / 1 : date is changed (string is rebuilt)
+  */
+uint8_t calendar_update(timestamp_t timestamp, datetime_t *pDateTime)
+{
+  uint32_t dwDay        = timestamp / CALENDAR_ONE_DAY;
+  uint32_t dwSecOfDay;
+  uint16_t wDayOfYear;
+  uint8_t  bChanged     = 0;
+
+  if(dwDay != dwCachedDay)
+  {
+    calendar_civil_from_days(dwDay, &cachedDate.year, &cachedDate.month, &cachedDate.day, &wDayOfYear);
+
+    // 1 : MON ~ 7 : SUN (same as timestamp_to_weekday())
+    cachedDate.weekday  = (uint8_t)((dwDay + CALENDAR_WEEKDAY_OFFSET) % 7);
+    if(0 == cachedDate.weekday)
+      cachedDate.weekday = 7;
+    cachedDate.week     = (uint8_t)((wDayOfYear + 11 - cachedDate.weekday) / 7);
+
+    cachedMidnight      = dwDay * CALENDAR_ONE_DAY;
+
+    // "YYYY-MM-DD"
+    szCachedDate[0]  = '0' + (cachedDate.year / 1000) % 10;
+    szCachedDate[1]  = '0' + (cachedDate.year / 100) % 10;
+    szCachedDate[2]  = '0' + (cachedDate.year / 10) % 10;
+    szCachedDate[3]  = '0' + (cachedDate.year % 10);
+    szCachedDate[4]  = '-';
+    szCachedDate[5]  = '0' + (cachedDate.month / 10);
+    szCachedDate[6]  = '0' + (cachedDate.month % 10);
+    szCachedDate[7]  = '-';
+    szCachedDate[8]  = '0' + (cachedDate.day / 10);
+    szCachedDate[9]  = '0' + (cachedDate.day % 10);
+    szCachedDate[10] = '\0';
+
+    dwCachedDay = dwDay;
+    bChanged    = 1;
+  }
+
+  // time of day
+  dwSecOfDay = timestamp - cachedMidnight;
+
+  *pDateTime          = cachedDate;
+  pDateTime->hour     = (uint8_t)(dwSecOfDay / 3600);
+  pDateTime->minute   = (uint8_t)((dwSecOfDay / 60) % 60);
+  pDateTime->second   = (uint8_t)(dwSecOfDay % 60);
+
+  return bChanged;
+}
+
+
+/**
+  * @brief      timestamp of 0:00:00 of the day of last calendar_update()
+  */
+timestamp_t calendar_get_midnight(void)
+{
+  return cachedMidnight;
+}
+
+
+/**
+  * @brief      "YYYY-MM-DD" of the day of last calendar_update()
+  */
+const char *calendar_get_date_str(void)
+{
+  return szCachedDate;
+}
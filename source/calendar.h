@@ -0,0 +1,66 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : calendar.h
+  * @brief          : Header for calendar.c file.
+  *                   constant-time epoch -> date conversion with day cache
+  ******************************************************************************
+  * @attention
+  *
+  *   date part is computed only when the day changes (civil_from_days,
+  *   http://howardhinnant.github.io/date_algorithms.html).
+  *   time of day is derived from cached midnight by simple arithmetic.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CALENDAR_H__
+#define __CALENDAR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define CALENDAR_ONE_DAY              86400UL
+#define CALENDAR_DATE_STR_LEN         11      // "YYYY-MM-DD" + NUL
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/**
+  * @brief      convert unix-time to human-readable time
+  * @note       reference : https://blog.naver.com/chandong83/222273392541
+  */
+typedef uint32_t timestamp_t; //seconds
+
+typedef struct {
+	uint16_t    year;
+	uint8_t     month;
+	uint8_t     day;
+	uint8_t     hour;
+	uint8_t     minute;
+	uint8_t     second;
+	uint8_t     week;
+	uint8_t     weekday;
+} datetime_t;
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void        calendar_civil_from_days(uint32_t dwDays, uint16_t *pYear, uint8_t *pMonth, uint8_t *pDay, uint16_t *pDayOfYear);
+uint8_t     calendar_update(timestamp_t timestamp, datetime_t *pDateTime);
+timestamp_t calendar_get_midnight(void);
+const char  *calendar_get_date_str(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CALENDAR_H__ */
@@ -0,0 +1,158 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : clcd_buf.cpp
+  * @brief          : shadow buffer for I2C character LCD
+  ******************************************************************************
+  * @attention
+  *
+  *   HD44780 increments address after each write within a row, so a run of
+  *   changed characters needs only one setCursor().
+  *   glass content is unknown after init / invalidate, next flush sends all.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "clcd_buf.h"
+#include "i2c_bus.h"
+
+/* Defines -------------------------------------------------------------------*/
+#define CLCD_BUF_UNKNOWN              0       // never written as character
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+static LiquidCrystal_I2C  *g_pLcd   = NULL;
+static uint8_t            g_bCols   = 0;
+static uint8_t            g_bRows   = 0;
+static char               g_szShadow[CLCD_BUF_ROW_MAX][CLCD_BUF_COL_MAX];   // wanted
+static char               g_szGlass[CLCD_BUF_ROW_MAX][CLCD_BUF_COL_MAX];    // on the glass
+
+/* Function prototypes -------------------------------------------------------*/
+static uint8_t  clcd_buf_is_changed(void);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      initialize shadow buffer
+  * @param      pLcd      CLCD instance
+  * @param      bCols     number of columns (max. CLCD_BUF_COL_MAX)
+  * @param      bRows     number of rows (max. CLCD_BUF_ROW_MAX)
+  * @return     none
+  * @note       shadow is cleared (spaces) and glass is marked unknown.
+  */
+void clcd_buf_init(LiquidCrystal_I2C *pLcd, uint8_t bCols, uint8_t bRows)
+{
+  g_pLcd  = pLcd;
+  g_bCols = (bCols > CLCD_BUF_COL_MAX) ? CLCD_BUF_COL_MAX : bCols;
+  g_bRows = (bRows > CLCD_BUF_ROW_MAX) ? CLCD_BUF_ROW_MAX : bRows;
+
+  clcd_buf_clear();
+  clcd_buf_invalidate();
+}
+
+
+/**
+  * @brief      fill shadow buffer with spaces (glass is not touched)
+  */
+void clcd_buf_clear(void)
+{
+  memset(g_szShadow, ' ', sizeof(g_szShadow));
+}
+
+
+/**
+  * @brief      write text into shadow buffer
+  * @param      bCol, bRow  start position
+  * @param      szText      text, clipped at the end of row (no wrap)
+  * @return     none
+  */
+void clcd_buf_print(uint8_t bCol, uint8_t bRow, const char *szText)
+{
+  if((bRow >= g_bRows) || (NULL == szText))
+    return;
+
+  while((*szText) && (bCol < g_bCols))
+  {
+    g_szShadow[bRow][bCol++] = *szText++;
+  }
+}
+
+
+/**
+  * @brief      forget glass content
+  * @note       call after the CLCD is written directly (lcd.clear() etc.)
+  */
+void clcd_buf_invalidate(void)
+{
+  memset(g_szGlass, CLCD_BUF_UNKNOWN, sizeof(g_szGlass));
+}
+
+
+/**
+  * @brief      send changed characters to CLCD
+  * @param      none
+  * @return     number of characters sent (0 : nothing changed or bus busy)
+  */
+uint8_t clcd_buf_flush(void)
+{
+  uint8_t bRow;
+  uint8_t bCol;
+  uint8_t bCursorRow  = 0xFF;     // unknown
+  uint8_t bCursorCol  = 0xFF;
+  uint8_t bSent       = 0;
+
+  if(NULL == g_pLcd)
+    return 0;
+
+  if(!clcd_buf_is_changed())
+    return 0;
+
+  if(!i2c_bus_acquire(I2C_BUS_DEV_CLCD))
+    return 0;
+
+  for(bRow=0; bRow<g_bRows; bRow++)
+  {
+    for(bCol=0; bCol<g_bCols; bCol++)
+    {
+      if(g_szShadow[bRow][bCol] == g_szGlass[bRow][bCol])
+        continue;
+
+      if((bRow != bCursorRow) || (bCol != bCursorCol))
+      {
+        g_pLcd->setCursor(bCol, bRow);
+        bCursorRow = bRow;
+        bCursorCol = bCol;
+      }
+
+      g_pLcd->write((uint8_t)g_szShadow[bRow][bCol]);
+      g_szGlass[bRow][bCol] = g_szShadow[bRow][bCol];
+      bCursorCol++;
+      bSent++;
+    }
+  }
+
+  i2c_bus_release(I2C_BUS_DEV_CLCD);
+
+  return bSent;
+}
+
+
+/**
+  * @brief      compare shadow & glass (active g_bRows x g_bCols area only)
+  * @return     0 : same / 1 : character(s) to send
+  */
+static uint8_t clcd_buf_is_changed(void)
+{
+  for(uint8_t bRow=0; bRow<g_bRows; bRow++)
+  {
+    if(0 != memcmp(g_szShadow[bRow], g_szGlass[bRow], g_bCols))
+      return 1;
+  }
+
+  return 0;
+}
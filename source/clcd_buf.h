@@ -0,0 +1,44 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : clcd_buf.h
+  * @brief          : Header for clcd_buf.cpp file.
+  *                   shadow buffer for I2C character LCD
+  ******************************************************************************
+  * @attention
+  *
+  *   text is written into a RAM buffer. clcd_buf_flush() compares it with
+  *   what is on the glass and sends only changed characters, with a cursor
+  *   move only when the next changed cell is not the current cursor position.
+  *   (PCF8574 backpack : 4-bit mode, several I2C transactions per character)
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CLCD_BUF_H__
+#define __CLCD_BUF_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <LiquidCrystal_I2C.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define CLCD_BUF_COL_MAX              20
+#define CLCD_BUF_ROW_MAX              4
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      clcd_buf_init(LiquidCrystal_I2C *pLcd, uint8_t bCols, uint8_t bRows);
+void      clcd_buf_clear(void);
+void      clcd_buf_print(uint8_t bCol, uint8_t bRow, const char *szText);
+void      clcd_buf_invalidate(void);
+uint8_t   clcd_buf_flush(void);
+
+#endif /* __CLCD_BUF_H__ */
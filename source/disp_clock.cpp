@@ -0,0 +1,82 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : disp_clock.cpp
+  * @brief          : one frame of OLED clock screen, free of sketch globals
+  ******************************************************************************
+  * @attention
+  *
+  *   widgets & positions : disp_layout_xxx_t (disp_layout.h).
+  *   layout is picked from a table, no geometry is computed here.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "disp_clock.h"
+#include "disp_layout.h"
+
+/* Defines -------------------------------------------------------------------*/
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+static const disp_layout_fn_t pfnLayoutClear[DISP_LAYOUT_NUM]  = { disp_layout_clock_t::clear,  disp_layout_bars_t::clear,  disp_layout_sensors_t::clear,  disp_layout_sensor_bars_t::clear  };
+static const disp_layout_fn_t pfnLayoutRender[DISP_LAYOUT_NUM] = { disp_layout_clock_t::render, disp_layout_bars_t::render, disp_layout_sensors_t::render, disp_layout_sensor_bars_t::render };
+static uint8_t                bPrevLayout                      = 0xFF;    // 0xFF : nothing drawn yet
+
+/* Function prototypes -------------------------------------------------------*/
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      draw clock screen into framebuffer
+  * @param      pDisp       display
+  * @param      dwEpoch     local epoch (sec)
+  * @param      bLayout     DISP_LAYOUT_xxx
+  * @param      szWday      name of weekday
+  * @param      pDateTime   (out) date & time of dwEpoch, may be NULL
+  * @return     none
+  * @note       touched tiles are marked, caller sends them (disp_tile_flush()).
+  */
+void disp_clock_render(U8G2 *pDisp, uint32_t dwEpoch, uint8_t bLayout, const char *szWday, datetime_t *pDateTime)
+{
+  disp_layout_ctx_t ctx;
+  datetime_t        datetime;
+
+  if(bLayout >= DISP_LAYOUT_NUM)
+    bLayout = DISP_LAYOUT_CLOCK;
+
+  // updates cached date string as well
+  calendar_update(dwEpoch, &datetime);
+  if(pDateTime)
+    *pDateTime = datetime;
+
+  ctx.pDisp     = pDisp;
+  ctx.dwEpoch   = dwEpoch;
+  ctx.dwDaySec  = dwEpoch - calendar_get_midnight();
+  ctx.szWday    = szWday;
+
+  // widgets move when layout is changed. clear whole time display zone once.
+  if(bLayout != bPrevLayout)
+  {
+    pfnLayoutClear[bLayout](&ctx);
+    bPrevLayout = bLayout;
+  }
+
+  // all coordinates are constant (disp_layout.h)
+  pfnLayoutRender[bLayout](&ctx);
+}
+
+
+/**
+  * @brief      forget last frame, next disp_clock_render() clears & draws whole zone
+  * @note       call when framebuffer was used by other screen (e.g. OTA progress)
+  */
+void disp_clock_invalidate(void)
+{
+  bPrevLayout = 0xFF;
+}
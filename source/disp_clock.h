@@ -0,0 +1,44 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : disp_clock.h
+  * @brief          : Header for disp_clock.cpp file.
+  *                   one frame of OLED clock screen, free of sketch globals
+  ******************************************************************************
+  * @attention
+  *
+  *   inputs are passed in, so the frame logic builds on host as well
+  *   (extras/host_bench) :
+  *     display sink  : U8G2 instance. target : SSD1306 over I2C,
+  *                     host : u8x8 byte callback counting bytes.
+  *     clock source  : local epoch argument (sys_clock_get_epoch() on target)
+  *     sensor source : fmt_set_temp() / fmt_set_humid() (sensor.cpp on target)
+  *
+  *   transfer (disp_tile_flush()) is done by caller.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DISP_CLOCK_H__
+#define __DISP_CLOCK_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include "calendar.h"
+
+/* Defines -------------------------------------------------------------------*/
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      disp_clock_render(U8G2 *pDisp, uint32_t dwEpoch, uint8_t bLayout, const char *szWday, datetime_t *pDateTime);
+void      disp_clock_invalidate(void);
+
+#endif /* __DISP_CLOCK_H__ */
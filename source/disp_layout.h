@@ -0,0 +1,301 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : disp_layout.h
+  * @brief          : compile-time screen layouts of clock display (OLED / CLCD)
+  ******************************************************************************
+  * @attention
+  *
+  *   a widget is a type whose position is template parameters, a layout is
+  *   a list of widgets. render() expands to straight-line draw calls with
+  *   constant coordinates (C++17 fold expression) : no per-frame branch on
+  *   screen size / mode, no coordinate arithmetic at run time.
+  *
+  *   baseline y is used for text (same as u8g2 drawStr()).
+  *   clear box of a widget is derived from max. char height of its font :
+  *     u8g2_font_tiny5_tr      ascent 5, line pitch 6
+  *     u8g2_font_12x6LED_mn    max. height 14
+  *     u8g2_font_spleen5x8_me  ascent 6
+  *     u8g2_font_9x6LED_mn     ascent 9
+  *
+  *   time & sensor value digits are drawn from glyph_cache (opaque cells
+  *   diffed against framebuffer), u8g2 drawStr() is the fallback.
+  *
+  *   new display size : add a layout set below, select it by define.
+  *   DISP_LAYOUT_OLED_128X32 : 128x32 SSD1306 module (also selects constructor
+  *                             in sketch).
+  *
+  *   header only (templates).
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DISP_LAYOUT_H__
+#define __DISP_LAYOUT_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include <type_traits>
+#include "disp_tile.h"
+#include "glyph_cache.h"
+#include "clcd_buf.h"
+#include "misc.h"
+#include "fmt.h"
+#include "calendar.h"
+
+/* Defines -------------------------------------------------------------------*/
+// #define DISP_LAYOUT_OLED_128X32    1
+
+#define DISP_LAYOUT_CLOCK             0       // clock only
+#define DISP_LAYOUT_BARS              1       // clock + progress bars
+#define DISP_LAYOUT_SENSORS           2       // clock + sensor values
+#define DISP_LAYOUT_SENSOR_BARS       3       // clock + progress bars, sensor board
+#define DISP_LAYOUT_NUM               4
+
+/*** progress bar source ***/
+#define DISP_BAR_DAY                  0       // from local midnight
+#define DISP_BAR_HOUR                 1       // minute of hour
+#define DISP_BAR_MIN                  2       // second of minute
+
+/*** sensor value source ***/
+#define DISP_VALUE_TEMP               0
+#define DISP_VALUE_HUMID              1
+
+#define DISP_BAR_STEPS                0       // see misc_draw_bar()
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/**
+  * @brief      values of one frame, computed once before widgets are drawn
+  */
+typedef struct {
+	U8G2        *pDisp;
+	uint32_t    dwEpoch;            // local epoch (sec)
+	uint32_t    dwDaySec;           // seconds since local midnight
+	const char  *szWday;
+} disp_layout_ctx_t;
+
+typedef void (*disp_layout_fn_t)(const disp_layout_ctx_t *pCtx);
+
+
+/*** OLED widgets ***/
+
+/**
+  * @brief      date "YYYY-MM-DD" with weekday on next line (u8g2_font_tiny5_tr)
+  */
+template<int16_t X, int16_t Y, int16_t W>
+struct disp_w_date {
+  static void draw(const disp_layout_ctx_t *pCtx)
+  {
+    disp_tile_clear_area(X, (Y - 6), W, 13);
+    pCtx->pDisp->setFont(u8g2_font_tiny5_tr);
+    pCtx->pDisp->drawStr(X, Y, calendar_get_date_str());
+    pCtx->pDisp->drawStr(X, (Y + 6), pCtx->szWday);
+  }
+};
+
+/**
+  * @brief      time "hh:mm:ss" (u8g2_font_12x6LED_mn)
+  */
+template<int16_t X, int16_t Y, int16_t W>
+struct disp_w_time {
+  static void draw(const disp_layout_ctx_t *pCtx)
+  {
+    if(glyph_cache_is_ready(GLYPH_CACHE_FONT_CLOCK))
+    {
+      glyph_cache_draw_str(GLYPH_CACHE_FONT_CLOCK, X, Y, W, fmt_get_time(pCtx->dwEpoch));
+      return;
+    }
+
+    disp_tile_clear_area(X, (Y - 14), W, 15);
+    pCtx->pDisp->setFont(u8g2_font_12x6LED_mn);
+    pCtx->pDisp->drawStr(X, Y, fmt_get_time(pCtx->dwEpoch));
+  }
+};
+
+/**
+  * @brief      progress bar, (X, Y) is top-left
+  */
+template<int16_t X, int16_t Y, int16_t W, int16_t H, uint8_t SRC>
+struct disp_w_bar {
+  static void draw(const disp_layout_ctx_t *pCtx)
+  {
+    static_assert(SRC <= DISP_BAR_MIN, "unknown bar source");
+
+    disp_tile_clear_area(X, Y, W, H);
+    if constexpr (DISP_BAR_DAY == SRC)
+      misc_draw_bar(pCtx->pDisp->getU8g2(), X, Y, W, H, pCtx->dwDaySec, 86400, DISP_BAR_STEPS);
+    else if constexpr (DISP_BAR_HOUR == SRC)
+      misc_draw_bar(pCtx->pDisp->getU8g2(), X, Y, W, H, (pCtx->dwEpoch % 3600), 3600, DISP_BAR_STEPS);
+    else
+      misc_draw_bar(pCtx->pDisp->getU8g2(), X, Y, W, H, (pCtx->dwEpoch % 60), 60, DISP_BAR_STEPS);
+  }
+};
+
+/**
+  * @brief      sensor value with label, value at X + 55 (spleen5x8 label / 9x6LED value)
+  */
+template<int16_t X, int16_t Y, int16_t W, uint8_t SRC>
+struct disp_w_sensor {
+  static void draw(const disp_layout_ctx_t *pCtx)
+  {
+    static_assert(SRC <= DISP_VALUE_HUMID, "unknown value source");
+
+    const char *szValue = (DISP_VALUE_TEMP == SRC) ? fmt_get_temp() : fmt_get_humid();
+
+    if(glyph_cache_is_ready(GLYPH_CACHE_FONT_VALUE))
+    {
+      disp_tile_clear_area(X, (Y - 9), 55, 10);
+      pCtx->pDisp->setFont(u8g2_font_spleen5x8_me);
+      pCtx->pDisp->drawStr(X, (Y - 3), (DISP_VALUE_TEMP == SRC) ? "Temp('C) " : "Humid(%) ");
+      glyph_cache_draw_str(GLYPH_CACHE_FONT_VALUE, (X + 55), Y, (W - 55), szValue);
+      return;
+    }
+
+    disp_tile_clear_area(X, (Y - 9), W, 10);
+    pCtx->pDisp->setFont(u8g2_font_spleen5x8_me);
+    pCtx->pDisp->drawStr(X, (Y - 3), (DISP_VALUE_TEMP == SRC) ? "Temp('C) " : "Humid(%) ");
+    pCtx->pDisp->setFont(u8g2_font_9x6LED_mn);
+    pCtx->pDisp->drawStr((X + 55), Y, szValue);
+  }
+};
+
+/**
+  * @brief      compact sensor value "T 23.45" (u8g2_font_tiny5_tr), for low screens
+  */
+template<int16_t X, int16_t Y, int16_t W, uint8_t SRC>
+struct disp_w_sensor_small {
+  static void draw(const disp_layout_ctx_t *pCtx)
+  {
+    static_assert(SRC <= DISP_VALUE_HUMID, "unknown value source");
+
+    disp_tile_clear_area(X, (Y - 6), W, 7);
+    pCtx->pDisp->setFont(u8g2_font_tiny5_tr);
+    pCtx->pDisp->drawStr(X, Y, (DISP_VALUE_TEMP == SRC) ? "T" : "H");
+    pCtx->pDisp->drawStr((X + 8), Y, (DISP_VALUE_TEMP == SRC) ? fmt_get_temp() : fmt_get_humid());
+  }
+};
+
+/**
+  * @brief      OLED layout : zone (cleared once when layout is selected) + widgets
+  */
+template<int16_t ZX, int16_t ZY, int16_t ZW, int16_t ZH, typename... WIDGETS>
+struct disp_layout {
+  static void clear(const disp_layout_ctx_t *pCtx)
+  {
+    (void)pCtx;
+    disp_tile_clear_area(ZX, ZY, ZW, ZH);
+  }
+
+  static void render(const disp_layout_ctx_t *pCtx)
+  {
+    (WIDGETS::draw(pCtx), ...);
+  }
+};
+
+
+/*** CLCD widgets (column, row) ***/
+
+template<uint8_t C, uint8_t R>
+struct clcd_w_time {
+  static void draw(const disp_layout_ctx_t *pCtx)  { clcd_buf_print(C, R, fmt_get_time(pCtx->dwEpoch)); }
+};
+
+template<uint8_t C, uint8_t R>
+struct clcd_w_date {
+  static void draw(const disp_layout_ctx_t *pCtx)  { (void)pCtx; clcd_buf_print(C, R, calendar_get_date_str()); }
+};
+
+template<uint8_t C, uint8_t R>
+struct clcd_w_wday {
+  static void draw(const disp_layout_ctx_t *pCtx)  { clcd_buf_print(C, R, pCtx->szWday); }
+};
+
+/**
+  * @brief      CLCD layout : widgets into shadow buffer, then send changed characters
+  */
+template<uint8_t COLS, uint8_t ROWS, typename... WIDGETS>
+struct clcd_layout {
+  static const uint8_t bCols = COLS;
+  static const uint8_t bRows = ROWS;
+
+  static void render(const disp_layout_ctx_t *pCtx)
+  {
+    (WIDGETS::draw(pCtx), ...);
+    clcd_buf_flush();
+  }
+};
+
+
+/*** layout sets ***/
+
+#if defined(DISP_LAYOUT_OLED_128X32)
+/**
+  *   128 x 32 : status line (y 0~15), clock zone (y 16~31)
+  *   bars / sensors replace date on the right side
+  */
+typedef disp_layout<0, 16, 128, 16,
+          disp_w_date<82, 23, 46>,
+          disp_w_time<14, 30, 68>>                          disp_layout_clock_t;
+typedef disp_layout<0, 16, 128, 16,
+          disp_w_time<14, 30, 68>,
+          disp_w_bar<84, 17, 44, 4, DISP_BAR_DAY>,
+          disp_w_bar<84, 22, 44, 4, DISP_BAR_HOUR>,
+          disp_w_bar<84, 27, 44, 4, DISP_BAR_MIN>>          disp_layout_bars_t;
+typedef disp_layout<0, 16, 128, 16,
+          disp_w_time<14, 30, 68>,
+          disp_w_sensor_small<84, 23, 44, DISP_VALUE_TEMP>,
+          disp_w_sensor_small<84, 30, 44, DISP_VALUE_HUMID>> disp_layout_sensors_t;
+typedef disp_layout_bars_t                                  disp_layout_sensor_bars_t;
+#else
+/**
+  *   128 x 64 : status line (yellow, y 0~15), clock zone (blue, y 16~63)
+  */
+typedef disp_layout<0, 16, 128, 48,
+          disp_w_date<82, 38, 46>,
+          disp_w_time<14, 44, 68>>                          disp_layout_clock_t;
+typedef disp_layout<0, 16, 128, 48,
+          disp_w_date<82, 30, 46>,
+          disp_w_time<14, 36, 68>,
+          disp_w_bar<0, 47, 128, 5, DISP_BAR_DAY>,
+          disp_w_bar<0, 53, 128, 5, DISP_BAR_HOUR>,
+          disp_w_bar<0, 59, 128, 5, DISP_BAR_MIN>>          disp_layout_bars_t;
+typedef disp_layout<0, 16, 128, 48,
+          disp_w_date<82, 28, 46>,
+          disp_w_time<14, 34, 68>,
+          disp_w_sensor<14, 52, 114, DISP_VALUE_TEMP>,
+          disp_w_sensor<14, 62, 114, DISP_VALUE_HUMID>>     disp_layout_sensors_t;
+typedef disp_layout<0, 16, 128, 48,
+          disp_w_date<82, 28, 46>,
+          disp_w_time<14, 34, 68>,
+          disp_w_bar<0, 47, 128, 5, DISP_BAR_DAY>,
+          disp_w_bar<0, 53, 128, 5, DISP_BAR_HOUR>,
+          disp_w_bar<0, 59, 128, 5, DISP_BAR_MIN>>          disp_layout_sensor_bars_t;
+#endif
+
+/**
+  *   20x4                        16x2
+  *   "::: Wi-Fi  Clock :::"      "    hh:mm:ss    "
+  *   "                    "      " YYYY-MM-DD MMM "
+  *   "      hh:mm:ss      "
+  *   "   YYYY-MM-DD MMM   "
+  */
+typedef clcd_layout<20, 4,
+          clcd_w_time<6, 2>,
+          clcd_w_date<3, 3>,
+          clcd_w_wday<14, 3>>                               clcd_layout_20x4_t;
+typedef clcd_layout<16, 2,
+          clcd_w_time<5, 0>,
+          clcd_w_date<1, 1>,
+          clcd_w_wday<13, 1>>                               clcd_layout_16x2_t;
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+
+#endif /* __DISP_LAYOUT_H__ */
@@ -0,0 +1,234 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : disp_tile.cpp
+  * @brief          : dirty-tile tracker for partial OLED refresh
+  ******************************************************************************
+  * @attention
+  *
+  *   one bit per tile, one uint16_t per tile row.
+  *   consecutive dirty tiles in a row are sent with a single
+  *   updateDisplayArea() call to keep the command overhead low.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "disp_tile.h"
+#include "i2c_bus.h"
+
+/* Defines -------------------------------------------------------------------*/
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+static U8G2     *pTileDisp                        = NULL;
+static uint8_t  bTileCols                         = DISP_TILE_COL_MAX;
+static uint8_t  bTileRows                         = DISP_TILE_ROW_MAX;
+static uint16_t wTileDirty[DISP_TILE_ROW_MAX]     = {0};
+static uint8_t  bTileBusDev                       = I2C_BUS_DEV_NONE;   // NONE : own bus (SW_I2C / SPI)
+
+/* Function prototypes -------------------------------------------------------*/
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      bind tracker to the display & read buffer geometry
+  * @param      pDisp   u8g2 instance (full buffer mode, "_F_" constructor)
+  * @return     none
+  * @note       call after u8g2.begin()
+  */
+void disp_tile_init(U8G2 *pDisp)
+{
+  pTileDisp = pDisp;
+
+  bTileCols = pDisp->getBufferTileWidth();
+  bTileRows = pDisp->getBufferTileHeight();
+
+  if(bTileCols > DISP_TILE_COL_MAX)  bTileCols = DISP_TILE_COL_MAX;
+  if(bTileRows > DISP_TILE_ROW_MAX)  bTileRows = DISP_TILE_ROW_MAX;
+
+  disp_tile_clear();
+}
+
+
+/**
+  * @brief      shared bus device of the display
+  * @param      bDev    I2C_BUS_DEV_OLED : HW_I2C on Wire, acquired for every transfer
+  *                     I2C_BUS_DEV_NONE : display has its own pins, no arbitration
+  * @return     none
+  */
+void disp_tile_set_bus(uint8_t bDev)
+{
+  bTileBusDev = bDev;
+}
+
+
+/**
+  * @brief      mark pixel area as modified
+  * @param      x, y    top-left pixel (may be negative, clipped)
+  * @param      w, h    size in pixels
+  * @return     none
+  */
+void disp_tile_mark_area(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  int16_t  tx0, ty0, tx1, ty1;
+  uint16_t wMask;
+
+  if((w <= 0) || (h <= 0))
+    return;
+
+  // clip to screen
+  if(x < 0) { w += x; x = 0; }
+  if(y < 0) { h += y; y = 0; }
+  if((w <= 0) || (h <= 0))
+    return;
+
+  tx0 = x >> 3;
+  ty0 = y >> 3;
+  tx1 = (x + w - 1) >> 3;
+  ty1 = (y + h - 1) >> 3;
+
+  if((tx0 >= bTileCols) || (ty0 >= bTileRows))
+    return;
+  if(tx1 >= bTileCols)  tx1 = bTileCols - 1;
+  if(ty1 >= bTileRows)  ty1 = bTileRows - 1;
+
+  // bits tx0..tx1
+  wMask = (uint16_t)( ((0xFFFFUL << tx0) & (0xFFFFUL >> (15 - tx1))) );
+
+  for(int16_t ty = ty0; ty <= ty1; ty++)
+    wTileDirty[ty] |= wMask;
+}
+
+
+/**
+  * @brief      clear pixel area in buffer & mark it as modified
+  * @param      x, y    top-left pixel
+  * @param      w, h    size in pixels
+  * @return     none
+  */
+void disp_tile_clear_area(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  if(NULL == pTileDisp)
+    return;
+
+  pTileDisp->setDrawColor(0);
+  pTileDisp->drawBox(x, y, w, h);
+  pTileDisp->setDrawColor(1);
+
+  disp_tile_mark_area(x, y, w, h);
+}
+
+
+/**
+  * @brief      mark whole screen as modified
+  */
+void disp_tile_mark_all(void)
+{
+  disp_tile_mark_area(0, 0, bTileCols * 8, bTileRows * 8);
+}
+
+
+/**
+  * @brief      forget all pending tiles (e.g. after full sendBuffer())
+  */
+void disp_tile_clear(void)
+{
+  for(uint8_t ty = 0; ty < DISP_TILE_ROW_MAX; ty++)
+    wTileDirty[ty] = 0;
+}
+
+
+/**
+  * @brief      check whether any tile is pending
+  * @return     0 : nothing to send / 1 : flush required
+  */
+uint8_t disp_tile_is_dirty(void)
+{
+  for(uint8_t ty = 0; ty < bTileRows; ty++)
+  {
+    if(wTileDirty[ty])
+      return 1;
+  }
+  return 0;
+}
+
+
+/**
+  * @brief      push pending tiles to the display
+  * @return     number of tiles sent
+  * @note       each run of adjacent dirty tiles is a single bus transfer.
+  */
+uint16_t disp_tile_flush(void)
+{
+  uint16_t wSent = 0;
+
+  if(NULL == pTileDisp)
+    return 0;
+
+  // shared bus is busy. keep tiles pending for next pass.
+  if( (I2C_BUS_DEV_NONE != bTileBusDev) && (!i2c_bus_acquire(bTileBusDev)) )
+    return 0;
+
+  for(uint8_t ty = 0; ty < bTileRows; ty++)
+  {
+    uint16_t wRow = wTileDirty[ty];
+    uint8_t  tx   = 0;
+
+    while(wRow && (tx < bTileCols))
+    {
+      // skip clean tiles
+      if(0 == (wRow & (1U << tx)))
+      {
+        tx++;
+        continue;
+      }
+
+      // collect run of dirty tiles
+      uint8_t tw = 0;
+      while(((tx + tw) < bTileCols) && (wRow & (1U << (tx + tw))))
+      {
+        wRow &= ~(1U << (tx + tw));
+        tw++;
+      }
+
+      pTileDisp->updateDisplayArea(tx, ty, tw, 1);
+      wSent += tw;
+      tx    += tw;
+    }
+
+    wTileDirty[ty] = 0;
+  }
+
+  if(I2C_BUS_DEV_NONE != bTileBusDev)
+    i2c_bus_release(bTileBusDev);
+
+  return wSent;
+}
+
+
+/**
+  * @brief      full buffer transfer, keeps tracker consistent
+  * @note       use for splash / full screen changes instead of sendBuffer()
+  */
+void disp_tile_send_all(void)
+{
+  if(NULL == pTileDisp)
+    return;
+
+  if( (I2C_BUS_DEV_NONE != bTileBusDev) && (!i2c_bus_acquire(bTileBusDev)) )
+  {
+    disp_tile_mark_all();   // send on next flush
+    return;
+  }
+
+  pTileDisp->sendBuffer();
+  disp_tile_clear();
+
+  if(I2C_BUS_DEV_NONE != bTileBusDev)
+    i2c_bus_release(bTileBusDev);
+}
@@ -0,0 +1,49 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : disp_tile.h
+  * @brief          : Header for disp_tile.cpp file.
+  *                   dirty-tile tracker for partial OLED refresh
+  ******************************************************************************
+  * @attention
+  *
+  *   SSD1306 framebuffer is organized as 8x8 pixel tiles (16 x 8 on 128x64).
+  *   widgets mark the area they touched, and disp_tile_flush() pushes
+  *   only those tiles instead of the whole 1 KB buffer.
+  *   transfers take the shared Wire bus (i2c_bus) only when the display is
+  *   on it, see disp_tile_set_bus().
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DISP_TILE_H__
+#define __DISP_TILE_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define DISP_TILE_COL_MAX             16      // 128 px / 8
+#define DISP_TILE_ROW_MAX             8       //  64 px / 8
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      disp_tile_init(U8G2 *pDisp);
+void      disp_tile_set_bus(uint8_t bDev);
+void      disp_tile_mark_area(int16_t x, int16_t y, int16_t w, int16_t h);
+void      disp_tile_mark_all(void);
+void      disp_tile_clear_area(int16_t x, int16_t y, int16_t w, int16_t h);
+void      disp_tile_clear(void);
+uint8_t   disp_tile_is_dirty(void);
+uint16_t  disp_tile_flush(void);
+void      disp_tile_send_all(void);
+
+#endif /* __DISP_TILE_H__ */
@@ -0,0 +1,209 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : fmt.c
+  * @brief          : zero-allocation formatting of time / sensor strings
+  ******************************************************************************
+  * @attention
+  *
+  *   sensor values are kept as fixed-point (1/100 unit, "centi") integer.
+  *   output is same as String(float) : 2 decimal places.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fmt.h"
+
+/* Defines -------------------------------------------------------------------*/
+#define FMT_ONE_DAY                   86400UL
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+typedef struct {
+  uint32_t  dwTimeEpoch;
+  int32_t   lTemp;
+  int32_t   lHumid;
+  uint8_t   bTimeValid;
+  char      szTime[FMT_TIME_STR_LEN];
+  char      szTemp[FMT_VALUE_STR_LEN];
+  char      szHumid[FMT_VALUE_STR_LEN];
+} fmt_cache_t;
+
+/* Variables -----------------------------------------------------------------*/
+static fmt_cache_t  g_fmt =
+{
+  0, FMT_VALUE_INVALID, FMT_VALUE_INVALID, 0,
+  "00:00:00", FMT_VALUE_INVALID_STR, FMT_VALUE_INVALID_STR
+};
+
+/* Function prototypes -------------------------------------------------------*/
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      write unsigned decimal number
+  * @param      pBuf        destination (NUL is NOT written)
+  * @param      dwValue     value
+  * @param      bMinDigits  zero-padded to this width (0 : no padding)
+  * @return     pointer next to last written character
+  */
+char *fmt_uint(char *pBuf, uint32_t dwValue, uint8_t bMinDigits)
+{
+  char    szTmp[10];
+  uint8_t bLen = 0;
+
+  do
+  {
+    szTmp[bLen++] = (char)('0' + (dwValue % 10));
+    dwValue /= 10;
+  } while(dwValue && (bLen < sizeof(szTmp)));
+
+  while(bLen < bMinDigits)
+  {
+    *pBuf++ = '0';
+    bMinDigits--;
+  }
+  while(bLen)
+    *pBuf++ = szTmp[--bLen];
+
+  return pBuf;
+}
+
+
+/**
+  * @brief      format time of day
+  * @param      dwEpoch   local epoch time
+  * @param      pBuf      destination, at least FMT_TIME_STR_LEN bytes
+  * @note       "hh:mm:ss" (same as NTPClient::getFormattedTime())
+  */
+void fmt_time(uint32_t dwEpoch, char *pBuf)
+{
+  uint32_t dwSecOfDay = dwEpoch % FMT_ONE_DAY;
+
+  pBuf    = fmt_uint(pBuf, dwSecOfDay / 3600, 2);
+  *pBuf++ = ':';
+  pBuf    = fmt_uint(pBuf, (dwSecOfDay / 60) % 60, 2);
+  *pBuf++ = ':';
+  pBuf    = fmt_uint(pBuf, dwSecOfDay % 60, 2);
+  *pBuf   = '\0';
+}
+
+
+/**
+  * @brief      format fixed-point value
+  * @param      lCenti    value x 100, FMT_VALUE_INVALID prints "--.-"
+  * @param      pBuf      destination, at least FMT_VALUE_STR_LEN bytes
+  * @note       -2345 -> "-23.45", range is -99999.99 ~ 99999.99 (clipped)
+  */
+void fmt_centi(int32_t lCenti, char *pBuf)
+{
+  const char *pSrc = FMT_VALUE_INVALID_STR;
+  uint32_t    dwAbs;
+
+  if(FMT_VALUE_INVALID == lCenti)
+  {
+    while(*pSrc)
+      *pBuf++ = *pSrc++;
+    *pBuf = '\0';
+    return;
+  }
+
+  if(lCenti < 0)
+  {
+    *pBuf++ = '-';
+    dwAbs   = (uint32_t)(-lCenti);
+  }
+  else
+  {
+    dwAbs   = (uint32_t)lCenti;
+  }
+  if(dwAbs > 9999999)
+    dwAbs = 9999999;
+
+  pBuf    = fmt_uint(pBuf, dwAbs / 100, 1);
+  *pBuf++ = '.';
+  pBuf    = fmt_uint(pBuf, dwAbs % 100, 2);
+  *pBuf   = '\0';
+}
+
+
+/**
+  * @brief      float -> fixed-point (x 100), rounded to nearest
+  * @note       NaN (sensor error) returns FMT_VALUE_INVALID
+  */
+int32_t fmt_float_to_centi(float fValue)
+{
+  if(fValue != fValue)                    // NaN
+    return FMT_VALUE_INVALID;
+  if(fValue > 20000000.0f)
+    fValue = 20000000.0f;
+  else if(fValue < -20000000.0f)
+    fValue = -20000000.0f;
+
+  return (fValue >= 0.0f) ? (int32_t)(fValue * 100.0f + 0.5f) : (int32_t)(fValue * 100.0f - 0.5f);
+}
+
+
+/**
+  * @brief      shared "hh:mm:ss" string of given epoch
+  * @param      dwEpoch   local epoch time
+  * @return     static buffer, re-formatted only when epoch is changed
+  */
+const char *fmt_get_time(uint32_t dwEpoch)
+{
+  if( (!g_fmt.bTimeValid) || (g_fmt.dwTimeEpoch != dwEpoch) )
+  {
+    fmt_time(dwEpoch, g_fmt.szTime);
+    g_fmt.dwTimeEpoch = dwEpoch;
+    g_fmt.bTimeValid  = 1;
+  }
+
+  return g_fmt.szTime;
+}
+
+
+/**
+  * @brief      update temperature (x 100 'C), string is re-formatted on change only
+  */
+void fmt_set_temp(int32_t lCenti)
+{
+  if(lCenti != g_fmt.lTemp)
+  {
+    g_fmt.lTemp = lCenti;
+    fmt_centi(lCenti, g_fmt.szTemp);
+  }
+}
+
+
+/**
+  * @brief      update humidity (x 100 %), string is re-formatted on change only
+  */
+void fmt_set_humid(int32_t lCenti)
+{
+  if(lCenti != g_fmt.lHumid)
+  {
+    g_fmt.lHumid = lCenti;
+    fmt_centi(lCenti, g_fmt.szHumid);
+  }
+}
+
+
+/**
+  * @brief      shared temperature string ("--.-" until first readout)
+  */
+const char *fmt_get_temp(void)
+{
+  return g_fmt.szTemp;
+}
+
+
+/**
+  * @brief      shared humidity string ("--.-" until first readout / not supported)
+  */
+const char *fmt_get_humid(void)
+{
+  return g_fmt.szHumid;
+}
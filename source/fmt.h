@@ -0,0 +1,56 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : fmt.h
+  * @brief          : Header for fmt.c file.
+  *                   zero-allocation formatting of time / sensor strings
+  ******************************************************************************
+  * @attention
+  *
+  *   no heap (String) is used. values are formatted once per change into
+  *   static buffers which are shared by OLED, CLCD and web page.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __FMT_H__
+#define __FMT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define FMT_TIME_STR_LEN              9       // "hh:mm:ss" + NUL
+#define FMT_VALUE_STR_LEN             10      // "-99999.99" + NUL
+#define FMT_VALUE_INVALID             INT32_MIN
+#define FMT_VALUE_INVALID_STR         "--.-"
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+char        *fmt_uint(char *pBuf, uint32_t dwValue, uint8_t bMinDigits);
+void        fmt_time(uint32_t dwEpoch, char *pBuf);
+void        fmt_centi(int32_t lCenti, char *pBuf);
+int32_t     fmt_float_to_centi(float fValue);
+
+const char  *fmt_get_time(uint32_t dwEpoch);
+void        fmt_set_temp(int32_t lCenti);
+void        fmt_set_humid(int32_t lCenti);
+const char  *fmt_get_temp(void);
+const char  *fmt_get_humid(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FMT_H__ */
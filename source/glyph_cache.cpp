@@ -0,0 +1,292 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : glyph_cache.cpp
+  * @brief          : pre-rendered digit glyphs for clock / sensor value
+  ******************************************************************************
+  * @attention
+  *
+  *   glyphs are captured by drawing them once with u8g2 (baseline 16, tile
+  *   rows 0~1) and reading the columns back from the framebuffer.
+  *   one column of a cell is a uint16_t (bit 0 = top row of cell), the cell
+  *   ends at baseline - 1 (cached characters have no descent).
+  *
+  *   RAM : 2 fonts x 13 chars x 8 columns x 2 bytes = 416 bytes
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "glyph_cache.h"
+#include "disp_tile.h"
+#include <string.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define GLYPH_CACHE_CELL_PAGE_MAX     3       // 16 rows + 7 bit shift
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+typedef struct {
+  const uint8_t *pFont;
+  uint8_t       bReady;
+  uint8_t       bAdvance;                     // cell width (px)
+  uint8_t       bHeight;                      // cell height (px)
+  uint16_t      wCol[GLYPH_CACHE_CHAR_NUM][GLYPH_CACHE_COL_MAX];
+} glyph_cache_font_t;
+
+/* Variables -----------------------------------------------------------------*/
+static U8G2               *pGlyphDisp                         = NULL;
+static glyph_cache_font_t g_glyph_font[GLYPH_CACHE_FONT_NUM]  = {
+  { u8g2_font_12x6LED_mn, 0, 0, 0, {{0}} },   // GLYPH_CACHE_FONT_CLOCK
+  { u8g2_font_9x6LED_mn,  0, 0, 0, {{0}} },   // GLYPH_CACHE_FONT_VALUE
+};
+
+/* Function prototypes -------------------------------------------------------*/
+static void     glyph_cache_capture(glyph_cache_font_t *pFont);
+static int8_t   glyph_cache_index(char ch);
+static void     glyph_cache_put_cell(const glyph_cache_font_t *pFont, const uint16_t *pCol, int16_t x, int16_t yTop, uint8_t bCols);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      decode glyphs of all cached fonts into RAM
+  * @param      pDisp   u8g2 instance (full buffer mode, "_F_" constructor)
+  * @return     none
+  * @note       call after u8g2.begin(), before splash is drawn.
+  *             framebuffer is used as scratch area & cleared on exit.
+  */
+void glyph_cache_init(U8G2 *pDisp)
+{
+  pGlyphDisp = pDisp;
+
+  for(uint8_t i = 0; i < GLYPH_CACHE_FONT_NUM; i++)
+  {
+    g_glyph_font[i].bReady = 0;
+
+    // capture area : 2 tile rows
+    if(pDisp->getBufferTileHeight() >= 2)
+      glyph_cache_capture(&g_glyph_font[i]);
+  }
+
+  pDisp->clearBuffer();
+}
+
+
+/**
+  * @brief      check whether font is cached
+  * @param      bFont   GLYPH_CACHE_FONT_xxx
+  * @return     0 : not cached (use u8g2 drawStr()) / 1 : cached
+  */
+uint8_t glyph_cache_is_ready(uint8_t bFont)
+{
+  if(bFont >= GLYPH_CACHE_FONT_NUM)
+    return 0;
+
+  return g_glyph_font[bFont].bReady;
+}
+
+
+/**
+  * @brief      draw string with cached glyphs (opaque cells)
+  * @param      bFont   GLYPH_CACHE_FONT_xxx
+  * @param      x, y    left / baseline (same as u8g2 drawStr())
+  * @param      w       field width (px), rest of field after string is blanked. 0 : none
+  * @param      szStr   string
+  * @return     width of string (px)
+  * @note       changed bytes only are written & marked dirty.
+  *             ' ' is a blank cell, other non-cached characters fall back to u8g2.
+  */
+int16_t glyph_cache_draw_str(uint8_t bFont, int16_t x, int16_t y, int16_t w, const char *szStr)
+{
+  const glyph_cache_font_t  *pFont;
+  int16_t                   xStart = x;
+  int16_t                   yTop;
+  int16_t                   wStrW;
+  int8_t                    bIdx;
+
+  if((NULL == pGlyphDisp) || (!glyph_cache_is_ready(bFont)))
+    return 0;
+
+  pFont = &g_glyph_font[bFont];
+  yTop  = y - pFont->bHeight;
+
+  for(; *szStr; szStr++, x += pFont->bAdvance)
+  {
+    bIdx = glyph_cache_index(*szStr);
+
+    if(bIdx >= 0)
+    {
+      glyph_cache_put_cell(pFont, pFont->wCol[bIdx], x, yTop, pFont->bAdvance);
+    }
+    else if(' ' == *szStr)
+    {
+      glyph_cache_put_cell(pFont, NULL, x, yTop, pFont->bAdvance);
+    }
+    else
+    {
+      disp_tile_clear_area(x, yTop, pFont->bAdvance, pFont->bHeight);
+      pGlyphDisp->setFont(pFont->pFont);
+      pGlyphDisp->setFontMode(1);
+      pGlyphDisp->drawGlyph(x, y, (uint8_t)*szStr);
+      pGlyphDisp->setFontMode(0);
+    }
+  }
+
+  wStrW = x - xStart;
+
+  // blank rest of field
+  while(x < (xStart + w))
+  {
+    int16_t wCols = (xStart + w) - x;
+
+    if(wCols > pFont->bAdvance)
+      wCols = pFont->bAdvance;
+
+    glyph_cache_put_cell(pFont, NULL, x, yTop, (uint8_t)wCols);
+    x += wCols;
+  }
+
+  return wStrW;
+}
+
+
+/**
+  * @brief      decode one font
+  * @note       monospaced fonts only (one cell width for all characters)
+  */
+static void glyph_cache_capture(glyph_cache_font_t *pFont)
+{
+  uint8_t     *pBuf   = pGlyphDisp->getBufferPtr();
+  uint16_t    wStride = pGlyphDisp->getBufferTileWidth() * 8;
+  uint8_t     bTop    = GLYPH_CACHE_ROW_MAX;
+  const char  *pCh    = GLYPH_CACHE_CHARS;
+
+  pGlyphDisp->setFont(pFont->pFont);
+  pGlyphDisp->setFontMode(0);
+
+  for(uint8_t i = 0; i < GLYPH_CACHE_CHAR_NUM; i++)
+  {
+    uint16_t wAdv;
+
+    pGlyphDisp->clearBuffer();
+    wAdv = pGlyphDisp->drawGlyph(0, GLYPH_CACHE_ROW_MAX, (uint8_t)pCh[i]);
+
+    if((0 == wAdv) || (wAdv > GLYPH_CACHE_COL_MAX))
+      return;
+    if((0 != i) && (wAdv != pFont->bAdvance))
+      return;
+    pFont->bAdvance = (uint8_t)wAdv;
+
+    for(uint8_t c = 0; c < GLYPH_CACHE_COL_MAX; c++)
+    {
+      uint16_t wBits = 0;
+
+      if(c < wAdv)
+        wBits = (uint16_t)pBuf[c] | ((uint16_t)pBuf[wStride + c] << 8);
+
+      pFont->wCol[i][c] = wBits;
+
+      // top-most row in use
+      for(uint8_t r = 0; r < bTop; r++)
+      {
+        if(wBits & (1U << r))
+        {
+          bTop = r;
+          break;
+        }
+      }
+    }
+  }
+
+  // nothing drawn
+  if(bTop >= GLYPH_CACHE_ROW_MAX)
+    return;
+
+  // align cell to top-most row
+  for(uint8_t i = 0; i < GLYPH_CACHE_CHAR_NUM; i++)
+  {
+    for(uint8_t c = 0; c < GLYPH_CACHE_COL_MAX; c++)
+      pFont->wCol[i][c] >>= bTop;
+  }
+
+  pFont->bHeight  = GLYPH_CACHE_ROW_MAX - bTop;
+  pFont->bReady   = 1;
+}
+
+
+/**
+  * @brief      character -> index of cache table
+  * @return     -1 : not cached
+  */
+static int8_t glyph_cache_index(char ch)
+{
+  const char *pPos;
+
+  if('\0' == ch)
+    return -1;
+
+  pPos = strchr(GLYPH_CACHE_CHARS, ch);
+  if(NULL == pPos)
+    return -1;
+
+  return (int8_t)(pPos - GLYPH_CACHE_CHARS);
+}
+
+
+/**
+  * @brief      write one cell into framebuffer, mark changed tiles
+  * @param      pCol    column bitmaps, NULL : blank cell
+  * @param      x, yTop top-left pixel of cell
+  * @param      bCols   columns to write (<= cell width)
+  */
+static void glyph_cache_put_cell(const glyph_cache_font_t *pFont, const uint16_t *pCol, int16_t x, int16_t yTop, uint8_t bCols)
+{
+  uint8_t   *pBuf     = pGlyphDisp->getBufferPtr();
+  int16_t   wStride   = pGlyphDisp->getBufferTileWidth() * 8;
+  int16_t   wPages    = pGlyphDisp->getBufferTileHeight();
+  uint8_t   bShift    = (uint8_t)(yTop & 7);
+  int16_t   wPage0    = (yTop - bShift) / 8;
+  uint32_t  dwMask    = ((1UL << pFont->bHeight) - 1) << bShift;
+  int16_t   xDirty0   = x + bCols;
+  int16_t   xDirty1   = x - 1;
+  uint8_t   bPageDirty= 0;
+
+  for(uint8_t c = 0; c < bCols; c++)
+  {
+    int16_t   xc      = x + c;
+    uint32_t  dwBits  = (NULL == pCol) ? 0 : ((uint32_t)pCol[c] << bShift);
+
+    if((xc < 0) || (xc >= wStride))
+      continue;
+
+    for(uint8_t k = 0; k < GLYPH_CACHE_CELL_PAGE_MAX; k++)
+    {
+      int16_t p       = wPage0 + k;
+      uint8_t bM      = (uint8_t)(dwMask >> (k * 8));
+      uint8_t *pByte;
+      uint8_t bNew;
+
+      if((0 == bM) || (p < 0) || (p >= wPages))
+        continue;
+
+      pByte = &pBuf[(p * wStride) + xc];
+      bNew  = (uint8_t)((*pByte & ~bM) | ((uint8_t)(dwBits >> (k * 8)) & bM));
+
+      if(bNew != *pByte)
+      {
+        *pByte      = bNew;
+        bPageDirty |= (uint8_t)(1U << k);
+        if(xc < xDirty0)  xDirty0 = xc;
+        if(xc > xDirty1)  xDirty1 = xc;
+      }
+    }
+  }
+
+  for(uint8_t k = 0; k < GLYPH_CACHE_CELL_PAGE_MAX; k++)
+  {
+    if(bPageDirty & (1U << k))
+      disp_tile_mark_area(xDirty0, (wPage0 + k) * 8, (xDirty1 - xDirty0 + 1), 8);
+  }
+}
@@ -0,0 +1,52 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : glyph_cache.h
+  * @brief          : Header for glyph_cache.cpp file.
+  *                   pre-rendered digit glyphs for clock / sensor value
+  ******************************************************************************
+  * @attention
+  *
+  *   glyphs of "0123456789:.-" are decoded once from the (compressed) u8g2
+  *   font into a RAM table, then written straight into the framebuffer.
+  *   each character is drawn as an opaque cell (background included), and
+  *   only bytes that really changed mark their tile dirty : "12:34:56" ->
+  *   "12:34:57" sends a single tile.
+  *
+  *   framebuffer layout of "_F_" SSD1306 constructors (vertical byte,
+  *   LSB = top) with U8G2_R0 is assumed.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __GLYPH_CACHE_H__
+#define __GLYPH_CACHE_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define GLYPH_CACHE_FONT_CLOCK        0       // u8g2_font_12x6LED_mn
+#define GLYPH_CACHE_FONT_VALUE        1       // u8g2_font_9x6LED_mn
+#define GLYPH_CACHE_FONT_NUM          2
+
+#define GLYPH_CACHE_CHARS             "0123456789:.-"
+#define GLYPH_CACHE_CHAR_NUM          13
+#define GLYPH_CACHE_COL_MAX           8       // max. advance of cached fonts
+#define GLYPH_CACHE_ROW_MAX           16      // one uint16_t per column
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      glyph_cache_init(U8G2 *pDisp);
+uint8_t   glyph_cache_is_ready(uint8_t bFont);
+int16_t   glyph_cache_draw_str(uint8_t bFont, int16_t x, int16_t y, int16_t w, const char *szStr);
+
+#endif /* __GLYPH_CACHE_H__ */
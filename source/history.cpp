@@ -0,0 +1,531 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : history.cpp
+  * @brief          : ring buffer of sensor history (fixed-point, implicit timestamp)
+  ******************************************************************************
+  * @attention
+  *
+  *   slot number n = UTC / HISTORY_INTERVAL_SEC (absolute).
+  *   sample of slot n is at g_hist_sample[n % HISTORY_SAMPLE_NUM],
+  *   aggregate of block b = n / HISTORY_BLOCK_LEN is at g_hist_block[b % HISTORY_BLOCK_NUM].
+  *   block id is kept with aggregate, to detect overwritten (stale) block.
+  *
+  *   file record (append-only) : magic, block id, HISTORY_BLOCK_LEN samples.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "history.h"
+#ifdef HISTORY_USE_LITTLEFS
+#include <LittleFS.h>
+#endif
+
+/* Defines -------------------------------------------------------------------*/
+#define HISTORY_FILE_MAGIC            0x31545348UL    // "HST1"
+
+#if (HISTORY_SAMPLE_NUM % HISTORY_BLOCK_LEN)
+#error "HISTORY_SAMPLE_NUM must be multiple of HISTORY_BLOCK_LEN"
+#endif
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+typedef struct {
+  uint32_t      dwId;             // absolute block number, 0xFFFFFFFF : empty
+  history_agg_t temp;
+  history_agg_t humid;
+  history_agg_t pressure;
+} history_block_t;
+
+typedef struct {
+  uint32_t      dwNewest;         // absolute slot number of newest committed sample
+  uint16_t      wCount;           // number of slots held (valid or gap)
+  uint32_t      dwOpen;           // slot collecting values now
+  int32_t       lSumTemp;
+  int32_t       lSumHumid;
+  int32_t       lSumPressure;
+  uint8_t       bNumTemp;
+  uint8_t       bNumHumid;
+  uint8_t       bNumPressure;
+  uint8_t       bOpenValid;
+  uint8_t       bRestoreDone;     // history_restore() is run or history_add() is called
+} history_ctx_t;
+
+typedef struct {
+  uint32_t          dwMagic;
+  uint32_t          dwBlockId;
+  history_sample_t  sample[HISTORY_BLOCK_LEN];
+} history_file_rec_t;
+
+/* Variables -----------------------------------------------------------------*/
+static history_sample_t g_hist_sample[HISTORY_SAMPLE_NUM];
+static history_block_t  g_hist_block[HISTORY_BLOCK_NUM];
+static history_ctx_t    g_hist;
+static const history_sample_t g_hist_gap = { HISTORY_INVALID_I16, HISTORY_INVALID_I16, HISTORY_INVALID_U16 };
+
+/* Function prototypes -------------------------------------------------------*/
+static void     history_agg_reset(history_agg_t *pAgg);
+static void     history_agg_add(history_agg_t *pAgg, int16_t iValue);
+static void     history_stat_merge(history_stat_t *pStat, const history_agg_t *pAgg);
+static void     history_stat_finish(history_stat_t *pStat, int32_t lSum, int32_t lOffset);
+static history_block_t *history_block_touch(uint32_t dwSlot);
+static void     history_commit(uint32_t dwSlot, const history_sample_t *pSample);
+static void     history_persist_block(uint32_t dwBlockId);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      clear history
+  * @note       every slot is invalid (not 0) : slot never written by restore
+  *             or commit is skipped by summary.
+  */
+void history_init(void)
+{
+  uint16_t i;
+
+  for(i=0; i<HISTORY_SAMPLE_NUM; i++)
+    g_hist_sample[i] = g_hist_gap;
+
+  for(i=0; i<HISTORY_BLOCK_NUM; i++)
+    g_hist_block[i].dwId = 0xFFFFFFFF;
+
+  memset(&g_hist, 0, sizeof(g_hist));
+
+#ifdef HISTORY_USE_LITTLEFS
+  LittleFS.begin();
+#endif
+}
+
+
+/**
+  * @brief      report sensor values
+  * @param      dwUtc       UTC seconds (time must be set)
+  * @param      lTemp       'C x 100, HISTORY_VALUE_INVALID : not available
+  * @param      lHumid      % x 100, HISTORY_VALUE_INVALID : not available
+  * @param      lPressure   Pa, HISTORY_VALUE_INVALID : not available
+  * @return     none
+  * @note       averaged within one interval. previous interval is committed
+  *             when a value of next interval is reported.
+  */
+void history_add(uint32_t dwUtc, int32_t lTemp, int32_t lHumid, int32_t lPressure)
+{
+  uint32_t          dwSlot = dwUtc / HISTORY_INTERVAL_SEC;
+  history_sample_t  sample;
+
+  g_hist.bRestoreDone = 1;      // too late to restore
+
+  if( (g_hist.bOpenValid) && (dwSlot != g_hist.dwOpen) )
+  {
+    sample.iTemp      = (g_hist.bNumTemp)     ? (int16_t)(g_hist.lSumTemp  / g_hist.bNumTemp)  : HISTORY_INVALID_I16;
+    sample.iHumid     = (g_hist.bNumHumid)    ? (int16_t)(g_hist.lSumHumid / g_hist.bNumHumid) : HISTORY_INVALID_I16;
+    sample.wPressure  = (g_hist.bNumPressure) ? (uint16_t)(g_hist.lSumPressure / g_hist.bNumPressure) : HISTORY_INVALID_U16;
+    history_commit(g_hist.dwOpen, &sample);
+    g_hist.bOpenValid = 0;
+  }
+
+  if(!g_hist.bOpenValid)
+  {
+    g_hist.dwOpen       = dwSlot;
+    g_hist.lSumTemp     = 0;
+    g_hist.lSumHumid    = 0;
+    g_hist.lSumPressure = 0;
+    g_hist.bNumTemp     = 0;
+    g_hist.bNumHumid    = 0;
+    g_hist.bNumPressure = 0;
+    g_hist.bOpenValid   = 1;
+  }
+
+  // clip into storage range, average of (at most 255) values
+  if( (HISTORY_VALUE_INVALID != lTemp) && (g_hist.bNumTemp < 0xFF) )
+  {
+    g_hist.lSumTemp += constrain(lTemp, (INT16_MIN + 1), INT16_MAX);
+    g_hist.bNumTemp++;
+  }
+  if( (HISTORY_VALUE_INVALID != lHumid) && (g_hist.bNumHumid < 0xFF) )
+  {
+    g_hist.lSumHumid += constrain(lHumid, (INT16_MIN + 1), INT16_MAX);
+    g_hist.bNumHumid++;
+  }
+  if( (HISTORY_VALUE_INVALID != lPressure) && (g_hist.bNumPressure < 0xFF) )
+  {
+    g_hist.lSumPressure += constrain((lPressure - HISTORY_PRESSURE_BASE), 1L, (int32_t)(HISTORY_INVALID_U16 - 1));     // 0 : int16 bias collides with HISTORY_INVALID_I16
+    g_hist.bNumPressure++;
+  }
+}
+
+
+/**
+  * @brief      number of samples held (including gaps without value)
+  */
+uint16_t history_get_count(void)
+{
+  return g_hist.wCount;
+}
+
+
+/**
+  * @brief      UTC of newest committed sample, 0 : empty
+  */
+uint32_t history_get_newest_time(void)
+{
+  return (g_hist.wCount) ? (g_hist.dwNewest * HISTORY_INTERVAL_SEC) : 0;
+}
+
+
+/**
+  * @brief      read one sample
+  * @param      wAgo        0 : newest, 1 : one interval before ...
+  * @param      pUtc        (out) UTC of sample (start of interval)
+  * @param      pTemp, pHumid, pPressure  (out) HISTORY_VALUE_INVALID : no value
+  * @return     1 : ok / 0 : out of range
+  */
+uint8_t history_get_sample(uint16_t wAgo, uint32_t *pUtc, int32_t *pTemp, int32_t *pHumid, int32_t *pPressure)
+{
+  uint32_t                dwSlot;
+  const history_sample_t  *pSample;
+
+  if(wAgo >= g_hist.wCount)
+    return 0;
+
+  dwSlot  = g_hist.dwNewest - wAgo;
+  pSample = &g_hist_sample[dwSlot % HISTORY_SAMPLE_NUM];
+
+  *pUtc       = dwSlot * HISTORY_INTERVAL_SEC;
+  *pTemp      = (HISTORY_INVALID_I16 == pSample->iTemp)     ? HISTORY_VALUE_INVALID : pSample->iTemp;
+  *pHumid     = (HISTORY_INVALID_I16 == pSample->iHumid)    ? HISTORY_VALUE_INVALID : pSample->iHumid;
+  *pPressure  = (HISTORY_INVALID_U16 == pSample->wPressure) ? HISTORY_VALUE_INVALID : ((int32_t)pSample->wPressure + HISTORY_PRESSURE_BASE);
+
+  return 1;
+}
+
+
+/**
+  * @brief      min / max / avg of recent samples
+  * @param      wSamples    window length (samples), clipped to held count
+  * @param      pSummary    (out)
+  * @return     none
+  * @note       whole blocks are taken from aggregates, only partial block
+  *             at the old end of window is scanned.
+  */
+void history_get_summary(uint16_t wSamples, history_summary_t *pSummary)
+{
+  uint32_t                dwSlot;
+  uint32_t                dwOldest;
+  uint32_t                dwBlockStart;
+  int32_t                 lSumTemp      = 0;
+  int32_t                 lSumHumid     = 0;
+  int32_t                 lSumPressure  = 0;
+  history_agg_t           one;
+  const history_block_t   *pBlock;
+  const history_sample_t  *pSample;
+
+  memset(pSummary, 0, sizeof(history_summary_t));
+
+  if(wSamples > g_hist.wCount)
+    wSamples = g_hist.wCount;
+  if(0 == wSamples)
+    return;
+
+  dwOldest          = g_hist.dwNewest - wSamples + 1;
+  pSummary->dwFrom  = dwOldest * HISTORY_INTERVAL_SEC;
+  pSummary->dwTo    = g_hist.dwNewest * HISTORY_INTERVAL_SEC;
+
+  dwSlot = g_hist.dwNewest;
+  while(1)
+  {
+    dwBlockStart  = dwSlot - (dwSlot % HISTORY_BLOCK_LEN);
+    pBlock        = &g_hist_block[(dwSlot / HISTORY_BLOCK_LEN) % HISTORY_BLOCK_NUM];
+
+    if( (dwBlockStart >= dwOldest) && (pBlock->dwId == (dwSlot / HISTORY_BLOCK_LEN)) )
+    {
+      // whole (committed part of) block is in window
+      history_stat_merge(&pSummary->temp,     &pBlock->temp);
+      history_stat_merge(&pSummary->humid,    &pBlock->humid);
+      history_stat_merge(&pSummary->pressure, &pBlock->pressure);
+      lSumTemp      += pBlock->temp.lSum;
+      lSumHumid     += pBlock->humid.lSum;
+      lSumPressure  += pBlock->pressure.lSum;
+      dwSlot         = dwBlockStart;
+    }
+    else
+    {
+      pSample = &g_hist_sample[dwSlot % HISTORY_SAMPLE_NUM];
+
+      history_agg_reset(&one);
+      history_agg_add(&one, pSample->iTemp);
+      history_stat_merge(&pSummary->temp, &one);
+      lSumTemp += one.lSum;
+
+      history_agg_reset(&one);
+      history_agg_add(&one, pSample->iHumid);
+      history_stat_merge(&pSummary->humid, &one);
+      lSumHumid += one.lSum;
+
+      history_agg_reset(&one);
+      if(HISTORY_INVALID_U16 != pSample->wPressure)
+      {
+        one.iMin    = one.iMax = (int16_t)(pSample->wPressure - 0x8000);    // aggregate of pressure is biased to int16
+        one.lSum    = one.iMin;
+        one.wCount  = 1;
+      }
+      history_stat_merge(&pSummary->pressure, &one);
+      lSumPressure += one.lSum;
+    }
+
+    if(dwSlot <= dwOldest)
+      break;
+    dwSlot--;
+  }
+
+  history_stat_finish(&pSummary->temp,     lSumTemp,     0);
+  history_stat_finish(&pSummary->humid,    lSumHumid,    0);
+  history_stat_finish(&pSummary->pressure, lSumPressure, (HISTORY_PRESSURE_BASE + 0x8000));
+}
+
+
+/**
+  * @brief      restore completed blocks from LittleFS
+  * @param      dwUtc   current UTC (time must be set)
+  * @return     number of restored blocks (0 : disabled / nothing / already done)
+  * @note       call after time is synchronized. runs once, and only before
+  *             1st history_add() : later calls return 0.
+  *             slots between restored blocks stay invalid (history_init()).
+  */
+uint8_t history_restore(uint32_t dwUtc)
+{
+  if(g_hist.bRestoreDone)
+    return 0;
+  g_hist.bRestoreDone = 1;
+
+#ifdef HISTORY_USE_LITTLEFS
+  static history_file_rec_t rec;          // 368 bytes, keep off the stack
+  const char      *szFile[2]  = { HISTORY_FILE_NAME_OLD, HISTORY_FILE_NAME };
+  uint32_t        dwNowBlock  = (dwUtc / HISTORY_INTERVAL_SEC) / HISTORY_BLOCK_LEN;
+  uint32_t        dwFirst     = 0xFFFFFFFF;
+  uint32_t        dwSlot;
+  uint8_t         bRestored   = 0;
+  uint8_t         f;
+  uint16_t        i;
+  history_block_t *pBlock;
+  File            file;
+
+  for(f=0; f<2; f++)
+  {
+    file = LittleFS.open(szFile[f], "r");
+    if(!file)
+      continue;
+
+    while(sizeof(rec) == file.read((uint8_t *)&rec, sizeof(rec)))
+    {
+      if(HISTORY_FILE_MAGIC != rec.dwMagic)
+        break;
+      // only completed blocks within ring window
+      if( (rec.dwBlockId >= dwNowBlock) || ((dwNowBlock - rec.dwBlockId) >= HISTORY_BLOCK_NUM) )
+        continue;
+
+      pBlock        = &g_hist_block[rec.dwBlockId % HISTORY_BLOCK_NUM];
+      pBlock->dwId  = rec.dwBlockId;
+      history_agg_reset(&pBlock->temp);
+      history_agg_reset(&pBlock->humid);
+      history_agg_reset(&pBlock->pressure);
+
+      for(i=0; i<HISTORY_BLOCK_LEN; i++)
+      {
+        dwSlot = rec.dwBlockId * HISTORY_BLOCK_LEN + i;
+        g_hist_sample[dwSlot % HISTORY_SAMPLE_NUM] = rec.sample[i];
+        history_agg_add(&pBlock->temp,  rec.sample[i].iTemp);
+        history_agg_add(&pBlock->humid, rec.sample[i].iHumid);
+        if(HISTORY_INVALID_U16 != rec.sample[i].wPressure)
+          history_agg_add(&pBlock->pressure, (int16_t)(rec.sample[i].wPressure - 0x8000));
+      }
+
+      if(rec.dwBlockId < dwFirst)
+        dwFirst = rec.dwBlockId;
+      if( (0 == g_hist.wCount) || (dwSlot > g_hist.dwNewest) )
+        g_hist.dwNewest = dwSlot;
+      g_hist.wCount = 1;        // non-zero while restoring
+      bRestored++;
+    }
+    file.close();
+  }
+
+  if(bRestored)
+  {
+    dwSlot        = g_hist.dwNewest - dwFirst * HISTORY_BLOCK_LEN + 1;
+    g_hist.wCount = (dwSlot > HISTORY_SAMPLE_NUM) ? HISTORY_SAMPLE_NUM : (uint16_t)dwSlot;
+  }
+
+  return bRestored;
+#else
+  return 0;
+#endif
+}
+
+
+/**
+  * @brief      aggregate helpers (int16 domain, HISTORY_INVALID_I16 is skipped)
+  * @note       pressure delta (uint16) is biased by -0x8000 to share int16 aggregate,
+  *             bias is removed by history_stat_finish() offset.
+  */
+static void history_agg_reset(history_agg_t *pAgg)
+{
+  pAgg->iMin    = INT16_MAX;
+  pAgg->iMax    = INT16_MIN;
+  pAgg->lSum    = 0;
+  pAgg->wCount  = 0;
+}
+
+static void history_agg_add(history_agg_t *pAgg, int16_t iValue)
+{
+  if(HISTORY_INVALID_I16 == iValue)
+    return;
+
+  if(iValue < pAgg->iMin)
+    pAgg->iMin = iValue;
+  if(iValue > pAgg->iMax)
+    pAgg->iMax = iValue;
+  pAgg->lSum += iValue;
+  pAgg->wCount++;
+}
+
+static void history_stat_merge(history_stat_t *pStat, const history_agg_t *pAgg)
+{
+  if(0 == pAgg->wCount)
+    return;
+
+  if( (0 == pStat->wCount) || (pAgg->iMin < pStat->lMin) )
+    pStat->lMin = pAgg->iMin;
+  if( (0 == pStat->wCount) || (pAgg->iMax > pStat->lMax) )
+    pStat->lMax = pAgg->iMax;
+  pStat->wCount += pAgg->wCount;
+}
+
+static void history_stat_finish(history_stat_t *pStat, int32_t lSum, int32_t lOffset)
+{
+  if(0 == pStat->wCount)
+  {
+    pStat->lMin = HISTORY_VALUE_INVALID;
+    pStat->lMax = HISTORY_VALUE_INVALID;
+    pStat->lAvg = HISTORY_VALUE_INVALID;
+    return;
+  }
+
+  pStat->lMin += lOffset;
+  pStat->lMax += lOffset;
+  pStat->lAvg  = lSum / (int32_t)pStat->wCount + lOffset;
+}
+
+
+/**
+  * @brief      aggregate block of slot, reset when it holds an older block
+  */
+static history_block_t *history_block_touch(uint32_t dwSlot)
+{
+  uint32_t        dwId    = dwSlot / HISTORY_BLOCK_LEN;
+  history_block_t *pBlock = &g_hist_block[dwId % HISTORY_BLOCK_NUM];
+
+  if(pBlock->dwId != dwId)
+  {
+    pBlock->dwId = dwId;
+    history_agg_reset(&pBlock->temp);
+    history_agg_reset(&pBlock->humid);
+    history_agg_reset(&pBlock->pressure);
+  }
+
+  return pBlock;
+}
+
+
+/**
+  * @brief      store one sample (gap is filled with invalid samples)
+  * @note       sample older than newest (time is stepped back) is dropped.
+  */
+static void history_commit(uint32_t dwSlot, const history_sample_t *pSample)
+{
+  history_block_t *pBlock;
+  uint32_t        dwSkip;
+  uint32_t        dwPrev  = g_hist.dwNewest;
+  uint32_t        n;
+
+  if(g_hist.wCount)
+  {
+    if(dwSlot <= g_hist.dwNewest)
+      return;
+
+    // gap : at most whole ring
+    dwSkip = dwSlot - g_hist.dwNewest - 1;
+    if(dwSkip > HISTORY_SAMPLE_NUM)
+      dwSkip = HISTORY_SAMPLE_NUM;
+    for(n = dwSlot - dwSkip; n < dwSlot; n++)
+    {
+      g_hist_sample[n % HISTORY_SAMPLE_NUM] = g_hist_gap;
+      history_block_touch(n);
+    }
+
+    n = g_hist.wCount + (dwSlot - g_hist.dwNewest);
+    g_hist.wCount = (n > HISTORY_SAMPLE_NUM) ? HISTORY_SAMPLE_NUM : (uint16_t)n;
+  }
+  else
+  {
+    g_hist.wCount = 1;
+  }
+
+  g_hist_sample[dwSlot % HISTORY_SAMPLE_NUM] = *pSample;
+  g_hist.dwNewest = dwSlot;
+
+  pBlock = history_block_touch(dwSlot);
+  history_agg_add(&pBlock->temp,  pSample->iTemp);
+  history_agg_add(&pBlock->humid, pSample->iHumid);
+  if(HISTORY_INVALID_U16 != pSample->wPressure)
+    history_agg_add(&pBlock->pressure, (int16_t)(pSample->wPressure - 0x8000));
+
+  // previous block is completed
+  if( (g_hist.wCount > 1) && ((dwPrev / HISTORY_BLOCK_LEN) != (dwSlot / HISTORY_BLOCK_LEN)) )
+    history_persist_block(dwPrev / HISTORY_BLOCK_LEN);
+}
+
+
+/**
+  * @brief      append completed block to LittleFS
+  * @note       file is rotated after HISTORY_FILE_BLOCK_MAX records
+  */
+static void history_persist_block(uint32_t dwBlockId)
+{
+#ifdef HISTORY_USE_LITTLEFS
+  static history_file_rec_t rec;
+  uint32_t  dwFirst = dwBlockId * HISTORY_BLOCK_LEN;
+  uint16_t  i;
+  File      file;
+
+  // block is overwritten already (gap longer than ring)
+  if((g_hist.dwNewest - dwFirst) >= HISTORY_SAMPLE_NUM)
+    return;
+
+  rec.dwMagic   = HISTORY_FILE_MAGIC;
+  rec.dwBlockId = dwBlockId;
+  for(i=0; i<HISTORY_BLOCK_LEN; i++)
+    rec.sample[i] = g_hist_sample[(dwFirst + i) % HISTORY_SAMPLE_NUM];
+
+  file = LittleFS.open(HISTORY_FILE_NAME, "a");
+  if(!file)
+    return;
+
+  if(file.size() >= (HISTORY_FILE_BLOCK_MAX * sizeof(rec)))
+  {
+    file.close();
+    LittleFS.remove(HISTORY_FILE_NAME_OLD);
+    LittleFS.rename(HISTORY_FILE_NAME, HISTORY_FILE_NAME_OLD);
+    file = LittleFS.open(HISTORY_FILE_NAME, "a");
+    if(!file)
+      return;
+  }
+
+  file.write((const uint8_t *)&rec, sizeof(rec));
+  file.close();
+#else
+  (void)dwBlockId;
+#endif
+}
@@ -0,0 +1,93 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : history.h
+  * @brief          : Header for history.cpp file.
+  *                   ring buffer of sensor history (fixed-point, implicit timestamp)
+  ******************************************************************************
+  * @attention
+  *
+  *   one sample per HISTORY_INTERVAL_SEC : int16 temperature ('C x 100),
+  *   int16 humidity (% x 100), uint16 pressure delta (Pa - HISTORY_PRESSURE_BASE).
+  *   6 bytes per sample, no timestamp is stored : slot of UTC time t is
+  *   (t / HISTORY_INTERVAL_SEC) % HISTORY_SAMPLE_NUM.
+  *   values reported within one interval are averaged into one sample.
+  *
+  *   aggregates : min / max / sum / count per block (HISTORY_BLOCK_LEN samples),
+  *   updated on every insert (O(1)). window summary combines blocks.
+  *
+  *   HISTORY_USE_LITTLEFS : completed blocks are appended to LittleFS
+  *   (append-only, 2 files rotated) and restored after reboot.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+
+/* Defines -------------------------------------------------------------------*/
+// #define HISTORY_USE_LITTLEFS                // persist completed blocks to flash
+
+#define HISTORY_INTERVAL_SEC          60      // 1 minute resolution
+#define HISTORY_SAMPLE_NUM            1440    // 24 hours (8640 bytes)
+#define HISTORY_BLOCK_LEN             60      // 1 hour per aggregate block
+#define HISTORY_BLOCK_NUM             (HISTORY_SAMPLE_NUM / HISTORY_BLOCK_LEN)
+
+#define HISTORY_PRESSURE_BASE         50000L  // Pa. uint16 delta covers 500 ~ 1155 hPa
+
+#define HISTORY_INVALID_I16           INT16_MIN
+#define HISTORY_INVALID_U16           0xFFFF
+#define HISTORY_VALUE_INVALID         INT32_MIN   // same as SENSOR_VALUE_INVALID
+
+#define HISTORY_FILE_NAME             "/history.bin"
+#define HISTORY_FILE_NAME_OLD         "/history.old"
+#define HISTORY_FILE_BLOCK_MAX        HISTORY_BLOCK_NUM   // rotate after 24 blocks (1 day)
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+typedef struct {
+	int16_t     iTemp;            // 'C x 100
+	int16_t     iHumid;           // % x 100
+	uint16_t    wPressure;        // Pa - HISTORY_PRESSURE_BASE
+} history_sample_t;
+
+typedef struct {
+	int16_t     iMin;
+	int16_t     iMax;
+	int32_t     lSum;
+	uint16_t    wCount;
+} history_agg_t;
+
+typedef struct {
+	int32_t     lMin;             // same unit as sensor_reading_t (x 100 / Pa)
+	int32_t     lMax;
+	int32_t     lAvg;
+	uint16_t    wCount;           // 0 : no valid sample (min/max/avg are invalid)
+} history_stat_t;
+
+typedef struct {
+	history_stat_t  temp;
+	history_stat_t  humid;
+	history_stat_t  pressure;
+	uint32_t        dwFrom;       // UTC of oldest sample in window
+	uint32_t        dwTo;         // UTC of newest sample
+} history_summary_t;
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      history_init(void);
+void      history_add(uint32_t dwUtc, int32_t lTemp, int32_t lHumid, int32_t lPressure);
+uint16_t  history_get_count(void);
+uint32_t  history_get_newest_time(void);
+uint8_t   history_get_sample(uint16_t wAgo, uint32_t *pUtc, int32_t *pTemp, int32_t *pHumid, int32_t *pPressure);
+void      history_get_summary(uint16_t wSamples, history_summary_t *pSummary);
+uint8_t   history_restore(uint32_t dwUtc);
+
+#endif /* __HISTORY_H__ */
@@ -0,0 +1,149 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : i2c_bus.cpp
+  * @brief          : arbitration of the shared hardware I2C (Wire) bus
+  ******************************************************************************
+  * @attention
+  *
+  *   everything runs from loop(), so arbitration is a simple owner lock.
+  *   a device that fails to acquire the bus keeps its request and retries
+  *   on the next pass instead of interleaving with the current owner.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include <Wire.h>
+#include "i2c_bus.h"
+
+/* Defines -------------------------------------------------------------------*/
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+static uint8_t  bBusOwner                         = I2C_BUS_DEV_NONE;
+static uint8_t  bBusLockDepth                     = 0;
+static uint32_t dwBusClockNow                     = 0;
+static uint32_t dwBusContention                   = 0;
+static uint32_t dwBusClock[I2C_BUS_DEV_NUM]       =
+{
+  I2C_BUS_CLOCK_STD,      // NONE
+  I2C_BUS_CLOCK_FAST,     // OLED
+  I2C_BUS_CLOCK_STD,      // CLCD
+  I2C_BUS_CLOCK_FAST,     // AHTx0
+  I2C_BUS_CLOCK_FAST,     // BMP280
+};
+
+/* Function prototypes -------------------------------------------------------*/
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      initialize shared bus
+  * @param      sda, scl    pin number
+  * @return     none
+  * @note       on ESP8266, Wire.begin(sda, scl) also replaces default pins.
+  *             so later Wire.begin() calls from libraries (e.g. lcd.init())
+  *             re-initialize the same pins instead of moving the bus.
+  */
+void i2c_bus_init(int sda, int scl)
+{
+  Wire.begin(sda, scl);
+  Wire.setClock(I2C_BUS_CLOCK_STD);
+
+  dwBusClockNow = I2C_BUS_CLOCK_STD;
+  bBusOwner     = I2C_BUS_DEV_NONE;
+  bBusLockDepth = 0;
+}
+
+
+/**
+  * @brief      change bus clock used while the device owns the bus
+  * @param      dev       I2C_BUS_DEV_*
+  * @param      dwClock   Hz
+  * @return     none
+  */
+void i2c_bus_set_clock(uint8_t dev, uint32_t dwClock)
+{
+  if(dev < I2C_BUS_DEV_NUM)
+    dwBusClock[dev] = dwClock;
+}
+
+
+/**
+  * @brief      take the bus before a transaction
+  * @param      dev       I2C_BUS_DEV_*
+  * @return     0 : bus is used by other device, try again later
+  *             1 : granted
+  * @note       nested acquire by same device is allowed.
+  */
+uint8_t i2c_bus_acquire(uint8_t dev)
+{
+  if((I2C_BUS_DEV_NONE == dev) || (dev >= I2C_BUS_DEV_NUM))
+    return 0;
+
+  if((I2C_BUS_DEV_NONE != bBusOwner) && (dev != bBusOwner))
+  {
+    dwBusContention++;
+    return 0;
+  }
+
+  bBusOwner = dev;
+  bBusLockDepth++;
+
+  // u8g2 HW_I2C sets its own clock on every transfer. others are restored here.
+  if(dwBusClockNow != dwBusClock[dev])
+  {
+    Wire.setClock(dwBusClock[dev]);
+    dwBusClockNow = dwBusClock[dev];
+  }
+
+  return 1;
+}
+
+
+/**
+  * @brief      give the bus back
+  * @param      dev       I2C_BUS_DEV_*
+  * @return     none
+  */
+void i2c_bus_release(uint8_t dev)
+{
+  if(dev != bBusOwner)
+    return;
+
+  if(bBusLockDepth)
+    bBusLockDepth--;
+
+  if(0 == bBusLockDepth)
+  {
+    bBusOwner = I2C_BUS_DEV_NONE;
+
+    // OLED transfer leaves Wire at OLED bus clock
+    if(I2C_BUS_DEV_OLED == dev)
+      dwBusClockNow = dwBusClock[I2C_BUS_DEV_OLED];
+  }
+}
+
+
+/**
+  * @brief      current owner of the bus
+  * @return     I2C_BUS_DEV_*
+  */
+uint8_t i2c_bus_owner(void)
+{
+  return bBusOwner;
+}
+
+
+/**
+  * @brief      number of rejected acquire requests (for diagnostics)
+  */
+uint32_t i2c_bus_get_contention(void)
+{
+  return dwBusContention;
+}
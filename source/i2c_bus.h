@@ -0,0 +1,51 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : i2c_bus.h
+  * @brief          : Header for i2c_bus.cpp file.
+  *                   arbitration of the shared hardware I2C (Wire) bus
+  ******************************************************************************
+  * @attention
+  *
+  *   OLED (HW_I2C backend), CLCD, AHTx0 and BMP280 can share one bus.
+  *   each device acquires the bus before a transaction, so that clock speed
+  *   and pending transfers of one device never disturb another.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __I2C_BUS_H__
+#define __I2C_BUS_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define I2C_BUS_CLOCK_STD             100000  // PCF8574 backpack supports standard mode only
+#define I2C_BUS_CLOCK_FAST            400000
+
+/*** bus users ***/
+#define I2C_BUS_DEV_NONE              0
+#define I2C_BUS_DEV_OLED              1
+#define I2C_BUS_DEV_CLCD              2
+#define I2C_BUS_DEV_AHTX0             3
+#define I2C_BUS_DEV_BMP280            4
+#define I2C_BUS_DEV_NUM               5
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      i2c_bus_init(int sda, int scl);
+void      i2c_bus_set_clock(uint8_t dev, uint32_t dwClock);
+uint8_t   i2c_bus_acquire(uint8_t dev);
+void      i2c_bus_release(uint8_t dev);
+uint8_t   i2c_bus_owner(void);
+uint32_t  i2c_bus_get_contention(void);
+
+#endif /* __I2C_BUS_H__ */
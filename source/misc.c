@@ -22,147 +22,38 @@
 
 /* Variables -----------------------------------------------------------------*/
 
+/* Function prototypes -------------------------------------------------------*/
+
+/* User code -----------------------------------------------------------------*/
+
 /**
-  * @brief      Progress Bar
+  * @brief      draw progress bar (frame + filled box)
+  * @param      pU8g2     u8g2 handle (U8G2::getU8g2())
+  * @param      x, y      top-left pixel
+  * @param      w, h      size of bar including frame (w >= 5, h >= 3)
+  * @param      dwValue   current value, clipped to dwMax
+  * @param      dwMax     full-scale value
+  * @param      bSteps    resolution. 0 : pixel-accurate (w - 4 steps), else quantized to bSteps
+  * @return     none
+  * @note       replaces glyph table "[|||   ]". area must be cleared by caller.
   */
-#if 1
-char dispBar[60][63] =
-{
-  "[|                                                           ]",     //  0
-  "[||                                                          ]",     //  1
-  "[|||                                                         ]",     //  2
-  "[||||                                                        ]",     //  3
-  "[|||||                                                       ]",     //  4
-  "[||||||                                                      ]",     //  5
-  "[|||||||                                                     ]",     //  6
-  "[||||||||                                                    ]",     //  7
-  "[|||||||||                                                   ]",     //  8
-  "[||||||||||                                                  ]",     //  9
-  "[|||||||||||                                                 ]",     //  10
-  "[||||||||||||                                                ]",     //  11
-  "[|||||||||||||                                               ]",     //  12
-  "[||||||||||||||                                              ]",     //  13
-  "[|||||||||||||||                                             ]",     //  14
-  "[||||||||||||||||                                            ]",     //  15
-  "[|||||||||||||||||                                           ]",     //  16
-  "[||||||||||||||||||                                          ]",     //  17
-  "[|||||||||||||||||||                                         ]",     //  18
-  "[||||||||||||||||||||                                        ]",     //  19
-  "[|||||||||||||||||||||                                       ]",     //  20
-  "[||||||||||||||||||||||                                      ]",     //  21
-  "[|||||||||||||||||||||||                                     ]",     //  22
-  "[||||||||||||||||||||||||                                    ]",     //  23
-  "[|||||||||||||||||||||||||                                   ]",     //  24
-  "[||||||||||||||||||||||||||                                  ]",     //  25
-  "[|||||||||||||||||||||||||||                                 ]",     //  26
-  "[||||||||||||||||||||||||||||                                ]",     //  27
-  "[|||||||||||||||||||||||||||||                               ]",     //  28
-  "[||||||||||||||||||||||||||||||                              ]",     //  29
-  "[|||||||||||||||||||||||||||||||                             ]",     //  30
-  "[||||||||||||||||||||||||||||||||                            ]",     //  31
-  "[|||||||||||||||||||||||||||||||||                           ]",     //  32
-  "[||||||||||||||||||||||||||||||||||                          ]",     //  33
-  "[|||||||||||||||||||||||||||||||||||                         ]",     //  34
-  "[||||||||||||||||||||||||||||||||||||                        ]",     //  35
-  "[|||||||||||||||||||||||||||||||||||||                       ]",     //  36
-  "[||||||||||||||||||||||||||||||||||||||                      ]",     //  37
-  "[|||||||||||||||||||||||||||||||||||||||                     ]",     //  38
-  "[||||||||||||||||||||||||||||||||||||||||                    ]",     //  39
-  "[|||||||||||||||||||||||||||||||||||||||||                   ]",     //  40
-  "[||||||||||||||||||||||||||||||||||||||||||                  ]",     //  41
-  "[|||||||||||||||||||||||||||||||||||||||||||                 ]",     //  42
-  "[||||||||||||||||||||||||||||||||||||||||||||                ]",     //  43
-  "[|||||||||||||||||||||||||||||||||||||||||||||               ]",     //  44
-  "[||||||||||||||||||||||||||||||||||||||||||||||              ]",     //  45
-  "[|||||||||||||||||||||||||||||||||||||||||||||||             ]",     //  46
-  "[||||||||||||||||||||||||||||||||||||||||||||||||            ]",     //  47
-  "[|||||||||||||||||||||||||||||||||||||||||||||||||           ]",     //  48
-  "[||||||||||||||||||||||||||||||||||||||||||||||||||          ]",     //  49
-  "[|||||||||||||||||||||||||||||||||||||||||||||||||||         ]",     //  50
-  "[||||||||||||||||||||||||||||||||||||||||||||||||||||        ]",     //  51
-  "[|||||||||||||||||||||||||||||||||||||||||||||||||||||       ]",     //  52
-  "[||||||||||||||||||||||||||||||||||||||||||||||||||||||      ]",     //  53
-  "[|||||||||||||||||||||||||||||||||||||||||||||||||||||||     ]",     //  54
-  "[||||||||||||||||||||||||||||||||||||||||||||||||||||||||    ]",     //  55
-  "[|||||||||||||||||||||||||||||||||||||||||||||||||||||||||   ]",     //  56
-  "[||||||||||||||||||||||||||||||||||||||||||||||||||||||||||  ]",     //  57
-  "[||||||||||||||||||||||||||||||||||||||||||||||||||||||||||| ]",     //  58
-  "[||||||||||||||||||||||||||||||||||||||||||||||||||||||||||||]"      //  59
-};
-#else
-char dispBar[60][63] =
+void misc_draw_bar(u8g2_t *pU8g2, uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint32_t dwValue, uint32_t dwMax, uint8_t bSteps)
 {
-  " .                                                            ",     //  0
-  " ..                                                           ",     //  1
-  " ...                                                          ",     //  2
-  " ....                                                         ",     //  3
-  " .....                                                        ",     //  4
-  " ......                                                       ",     //  5
-  " .......                                                      ",     //  6
-  " ........                                                     ",     //  7
-  " .........                                                    ",     //  8
-  " ..........                                                   ",     //  9
-  " ...........                                                  ",     //  10
-  " ............                                                 ",     //  11
-  " .............                                                ",     //  12
-  " ..............                                               ",     //  13
-  " ...............                                              ",     //  14
-  " ................                                             ",     //  15
-  " .................                                            ",     //  16
-  " ..................                                           ",     //  17
-  " ...................                                          ",     //  18
-  " ....................                                         ",     //  19
-  " .....................                                        ",     //  20
-  " ......................                                       ",     //  21
-  " .......................                                      ",     //  22
-  " ........................                                     ",     //  23
-  " .........................                                    ",     //  24
-  " ..........................                                   ",     //  25
-  " ...........................                                  ",     //  26
-  " ............................                                 ",     //  27
-  " .............................                                ",     //  28
-  " ..............................                               ",     //  29
-  " ...............................                              ",     //  30
-  " ................................                             ",     //  31
-  " .................................                            ",     //  32
-  " ..................................                           ",     //  33
-  " ...................................                          ",     //  34
-  " ....................................                         ",     //  35
-  " .....................................                        ",     //  36
-  " ......................................                       ",     //  37
-  " .......................................                      ",     //  38
-  " ........................................                     ",     //  39
-  " .........................................                    ",     //  40
-  " ..........................................                   ",     //  41
-  " ...........................................                  ",     //  42
-  " ............................................                 ",     //  43
-  " .............................................                ",     //  44
-  " ..............................................               ",     //  45
-  " ...............................................              ",     //  46
-  " ................................................             ",     //  47
-  " .................................................            ",     //  48
-  " ..................................................           ",     //  49
-  " ...................................................          ",     //  50
-  " ....................................................         ",     //  51
-  " .....................................................        ",     //  52
-  " ......................................................       ",     //  53
-  " .......................................................      ",     //  54
-  " ........................................................     ",     //  55
-  " .........................................................    ",     //  56
-  " ..........................................................   ",     //  57
-  " ...........................................................  ",     //  58
-  " ............................................................ "      //  59
-};
-#endif
+  uint32_t dwInner = (uint32_t)w - 4;     // frame (1px) + gap (1px) on each side
+  uint32_t dwFill;
 
+  if((w < 5) || (h < 3) || (0 == dwMax))
+    return;
 
-/* Function prototypes -------------------------------------------------------*/
+  if(dwValue > dwMax)
+    dwValue = dwMax;
 
-/* User code -----------------------------------------------------------------*/
+  if(bSteps)
+    dwFill = ((uint64_t)dwValue * bSteps / dwMax) * dwInner / bSteps;
+  else
+    dwFill = (uint64_t)dwValue * dwInner / dwMax;
 
-/**
-  * @brief      brief
-  * @param      param
-  * @return     return
-  * @note       note
-  */
+  u8g2_DrawFrame(pU8g2, x, y, w, h);
+  if(dwFill)
+    u8g2_DrawBox(pU8g2, x + 2, y + 1, (u8g2_uint_t)dwFill, h - 2);
+}
@@ -21,6 +21,8 @@ extern "C" {
 #endif
 
 /* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <clib/u8g2.h>        // U8g2 C API (library src/clib)
 
 /* Defines -------------------------------------------------------------------*/
 
@@ -29,9 +31,9 @@ extern "C" {
 /* Types ---------------------------------------------------------------------*/
 
 /* Variables -----------------------------------------------------------------*/
-extern char dispBar[60][63];
 
 /* Functions prototypes ------------------------------------------------------*/
+void misc_draw_bar(u8g2_t *pU8g2, uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint32_t dwValue, uint32_t dwMax, uint8_t bSteps);
 
 #ifdef __cplusplus
 }
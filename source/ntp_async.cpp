@@ -0,0 +1,487 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : ntp_async.cpp
+  * @brief          : non-blocking SNTP client with multi-server selection
+  ******************************************************************************
+  * @attention
+  *
+  *   T1 : client transmit (local)    T2 : server receive
+  *   T3 : server transmit            T4 : client receive (local)
+  *
+  *     offset = ((T2 - T1) + (T3 - T4)) / 2
+  *     delay  =  (T4 - T1) - (T3 - T2)
+  *
+  *   T1 is also written to the transmit timestamp field of the request,
+  *   with server index in the lowest fraction byte (< 60 ns error).
+  *   server echoes it as originate timestamp, so every reply is matched
+  *   to its request and stale replies are dropped.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include <ESP8266WiFi.h>
+#include <lwip/dns.h>
+#include "ntp_async.h"
+#include "sys_clock.h"
+
+/* Defines -------------------------------------------------------------------*/
+#define NTP_UNIX_EPOCH_OFFSET         2208988800UL  // 1900-01-01 -> 1970-01-01
+
+/*** ntp_server_t::bDns ***/
+#define NTP_DNS_IDLE                  0
+#define NTP_DNS_BUSY                  1             // lookup started, callback pending
+#define NTP_DNS_DONE                  2             // callback fired (ip is valid or cleared)
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/**
+  * @brief      per-server state
+  */
+typedef struct {
+  const char  *szName;
+  IPAddress   ip;               // DNS cache
+  uint32_t    dwResolvedAt;     // millis()
+  uint8_t     bFailCnt;         // failures in a row
+  volatile uint8_t bDns;        // NTP_DNS_xxx, written by lwIP callback
+  uint8_t     bDnsRefresh;      // look up before next request, cached ip is kept until then
+  uint8_t     bWaitDns;         // request of this round waits for lookup
+  uint8_t     bPending;         // request in flight
+  uint8_t     bValid;           // reply of this round
+  uint8_t     bStratum;
+  uint8_t     bOrigin[8];       // transmit timestamp of request
+  uint64_t    qwT1;
+  int64_t     qOffsetMs;
+  uint32_t    dwDelayMs;
+} ntp_server_t;
+
+/* Variables -----------------------------------------------------------------*/
+static UDP                *pNtpUdp              = NULL;
+static ntp_server_t       ntpServer[NTP_ASYNC_SERVER_MAX];
+static uint8_t            bNtpServerNum         = 0;
+static uint8_t            bNtpState             = NTP_ASYNC_IDLE;
+static uint8_t            bNtpSocketOpen        = 0;
+static uint32_t           dwNtpSentMillis       = 0;
+static uint8_t            bNtpBuf[NTP_ASYNC_PACKET_SIZE];
+static ntp_async_result_t ntpResult             = {0};
+
+/* Function prototypes -------------------------------------------------------*/
+static void     ntp_ms_to_timestamp(uint64_t qwUtcMs, uint8_t *pDst);
+static int64_t  ntp_timestamp_to_ms(const uint8_t *pSrc);
+static uint8_t  ntp_resolve(ntp_server_t *pSrv);
+static void     ntp_dns_found(const char *szName, const ip_addr_t *pAddr, void *pArg);
+static uint8_t  ntp_send(uint8_t bIdx);
+static void     ntp_receive(void);
+static uint8_t  ntp_select(void);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      UTC ms -> 64-bit NTP timestamp (big endian)
+  */
+static void ntp_ms_to_timestamp(uint64_t qwUtcMs, uint8_t *pDst)
+{
+  uint32_t dwSec  = (uint32_t)(qwUtcMs / 1000) + NTP_UNIX_EPOCH_OFFSET;
+  uint32_t dwFrac = (uint32_t)((((uint64_t)(qwUtcMs % 1000)) << 32) / 1000);
+
+  pDst[0] = dwSec  >> 24;  pDst[1] = dwSec  >> 16;  pDst[2] = dwSec  >> 8;  pDst[3] = dwSec;
+  pDst[4] = dwFrac >> 24;  pDst[5] = dwFrac >> 16;  pDst[6] = dwFrac >> 8;  pDst[7] = dwFrac;
+}
+
+
+/**
+  * @brief      64-bit NTP timestamp (big endian) -> UTC ms
+  * @note       rounded to nearest millisecond
+  */
+static int64_t ntp_timestamp_to_ms(const uint8_t *pSrc)
+{
+  uint32_t dwSec  = ((uint32_t)pSrc[0] << 24) | ((uint32_t)pSrc[1] << 16) | ((uint32_t)pSrc[2] << 8) | pSrc[3];
+  uint32_t dwFrac = ((uint32_t)pSrc[4] << 24) | ((uint32_t)pSrc[5] << 16) | ((uint32_t)pSrc[6] << 8) | pSrc[7];
+
+  return ((int64_t)(dwSec - NTP_UNIX_EPOCH_OFFSET) * 1000) + (int64_t)((((uint64_t)dwFrac * 1000) + 0x80000000UL) >> 32);
+}
+
+
+/**
+  * @brief      resolve server address, cached for NTP_ASYNC_DNS_TTL_MS
+  * @return     NTP_DNS_DONE : address is valid / NTP_DNS_BUSY : lookup is running / NTP_DNS_IDLE : failed
+  * @note       never blocks. result of a running lookup arrives by ntp_dns_found().
+  *             failed lookup keeps previous address (used until next lookup succeeds).
+  */
+static uint8_t ntp_resolve(ntp_server_t *pSrv)
+{
+  ip_addr_t addr;
+  err_t     err;
+
+  if( pSrv->ip.isSet() && (!pSrv->bDnsRefresh) && ((millis() - pSrv->dwResolvedAt) < NTP_ASYNC_DNS_TTL_MS) )
+    return NTP_DNS_DONE;
+
+  if(NTP_DNS_BUSY == pSrv->bDns)
+    return NTP_DNS_BUSY;
+
+  pSrv->bDns = NTP_DNS_BUSY;
+  err = dns_gethostbyname(pSrv->szName, &addr, ntp_dns_found, pSrv);
+
+  if(ERR_INPROGRESS == err)
+    return NTP_DNS_BUSY;
+
+  pSrv->bDns = NTP_DNS_IDLE;
+
+  if(ERR_OK != err)
+    return (pSrv->ip.isSet()) ? NTP_DNS_DONE : NTP_DNS_IDLE;
+
+  // lwIP cache hit (or numeric address) : no callback
+  pSrv->ip            = IPAddress(&addr);
+  pSrv->dwResolvedAt  = millis();
+  pSrv->bDnsRefresh   = 0;
+  return NTP_DNS_DONE;
+}
+
+
+/**
+  * @brief      lwIP DNS callback
+  * @param      pAddr   NULL : lookup failed (previous address is kept)
+  * @note       runs in lwIP context (never inside a loop() task)
+  */
+static void ntp_dns_found(const char *szName, const ip_addr_t *pAddr, void *pArg)
+{
+  ntp_server_t *pSrv = (ntp_server_t *)pArg;
+
+  (void)szName;
+
+  if(pAddr)
+  {
+    pSrv->ip            = IPAddress(pAddr);
+    pSrv->dwResolvedAt  = millis();
+    pSrv->bDnsRefresh   = 0;
+  }
+
+  pSrv->bDns = NTP_DNS_DONE;
+}
+
+
+/**
+  * @brief      send request to one server (address is resolved)
+  * @return     0 : failed / 1 : sent
+  */
+static uint8_t ntp_send(uint8_t bIdx)
+{
+  ntp_server_t  *pSrv = &ntpServer[bIdx];
+  uint64_t      qwNow;
+
+  memset(bNtpBuf, 0, NTP_ASYNC_PACKET_SIZE);
+  bNtpBuf[0] = 0b11100011;    // LI (unsync), Version 4, Mode 3 (client)
+  bNtpBuf[2] = 6;             // Polling Interval
+  bNtpBuf[3] = 0xEC;          // Peer Clock Precision
+
+  qwNow = sys_clock_now_ms();
+  pSrv->qwT1 = qwNow;
+  ntp_ms_to_timestamp(qwNow, pSrv->bOrigin);
+  pSrv->bOrigin[7] = bIdx;                    // tag request
+  memcpy(&bNtpBuf[40], pSrv->bOrigin, 8);     // transmit timestamp
+
+  pNtpUdp->beginPacket(pSrv->ip, NTP_ASYNC_PORT);
+  pNtpUdp->write(bNtpBuf, NTP_ASYNC_PACKET_SIZE);
+  if(!pNtpUdp->endPacket())
+    return 0;
+
+  pSrv->bPending = 1;
+  return 1;
+}
+
+
+/**
+  * @brief      bind socket & server list
+  * @param      pUdp          UDP socket (WiFiUDP)
+  * @param      pServerList   host names of time servers
+  * @param      bServerNum    number of servers (max. NTP_ASYNC_SERVER_MAX)
+  */
+void ntp_async_init(UDP *pUdp, const char * const *pServerList, uint8_t bServerNum)
+{
+  if(bServerNum > NTP_ASYNC_SERVER_MAX)
+    bServerNum = NTP_ASYNC_SERVER_MAX;
+
+  for(uint8_t i = 0; i < NTP_ASYNC_SERVER_MAX; i++)
+    ntpServer[i] = ntp_server_t();
+
+  for(uint8_t i = 0; i < bServerNum; i++)
+    ntpServer[i].szName = pServerList[i];
+
+  pNtpUdp         = pUdp;
+  bNtpServerNum   = bServerNum;
+  bNtpState       = NTP_ASYNC_IDLE;
+  bNtpSocketOpen  = 0;
+}
+
+
+/**
+  * @brief      send requests to all servers and return immediately
+  * @return     0 : failed (no socket / no server reachable) / 1 : sent (or waiting for DNS)
+  * @note       servers failed NTP_ASYNC_FAIL_BACKOFF times in a row are
+  *             skipped unless every server is failing.
+  */
+uint8_t ntp_async_request(void)
+{
+  uint8_t  bSent = 0;
+  uint8_t  bAllFailing = 1;
+  uint8_t  bDns;
+
+  if((NULL == pNtpUdp) || (0 == bNtpServerNum))
+    return 0;
+
+  if(!bNtpSocketOpen)
+  {
+    if(!pNtpUdp->begin(NTP_ASYNC_LOCAL_PORT))
+      return 0;
+    bNtpSocketOpen = 1;
+  }
+
+  // drop late replies of previous request
+  while(pNtpUdp->parsePacket() > 0)
+    pNtpUdp->flush();
+
+  for(uint8_t i = 0; i < bNtpServerNum; i++)
+  {
+    if(ntpServer[i].bFailCnt < NTP_ASYNC_FAIL_BACKOFF)
+      bAllFailing = 0;
+  }
+
+  for(uint8_t i = 0; i < bNtpServerNum; i++)
+  {
+    ntp_server_t *pSrv = &ntpServer[i];
+
+    pSrv->bPending  = 0;
+    pSrv->bWaitDns  = 0;
+    pSrv->bValid    = 0;
+
+    // failover : give failing server a rest
+    if( (!bAllFailing) && (pSrv->bFailCnt >= NTP_ASYNC_FAIL_BACKOFF) )
+    {
+      pSrv->bFailCnt--;     // retry after a few rounds
+      continue;
+    }
+
+    bDns = ntp_resolve(pSrv);
+
+    if(NTP_DNS_BUSY == bDns)
+    {
+      pSrv->bWaitDns = 1;       // sent by ntp_async_process()
+      bSent++;
+      continue;
+    }
+
+    if( (NTP_DNS_DONE != bDns) || (!ntp_send(i)) )
+    {
+      pSrv->bFailCnt++;
+      continue;
+    }
+
+    bSent++;
+  }
+
+  if(0 == bSent)
+  {
+    bNtpState = NTP_ASYNC_ERROR;
+    return 0;
+  }
+
+  dwNtpSentMillis = millis();
+  bNtpState       = NTP_ASYNC_BUSY;
+  return 1;
+}
+
+
+/**
+  * @brief      read every queued reply and match it to its request
+  */
+static void ntp_receive(void)
+{
+  int64_t  T1, T2, T3, T4;
+  uint64_t qwT4;
+
+  while(pNtpUdp->parsePacket() >= NTP_ASYNC_PACKET_SIZE)
+  {
+    qwT4 = sys_clock_now_ms();      // take T4 first
+    pNtpUdp->read(bNtpBuf, NTP_ASYNC_PACKET_SIZE);
+
+    // unsynchronized server (LI=3 or stratum 0 : kiss-o'-death)
+    if( (0 == bNtpBuf[1]) || (0xC0 == (bNtpBuf[0] & 0xC0)) )
+      continue;
+
+    for(uint8_t i = 0; i < bNtpServerNum; i++)
+    {
+      ntp_server_t *pSrv = &ntpServer[i];
+
+      // reply to our request? (originate == our transmit)
+      if( (!pSrv->bPending) || (0 != memcmp(&bNtpBuf[24], pSrv->bOrigin, 8)) )
+        continue;
+
+      T1 = (int64_t)pSrv->qwT1;
+      T2 = ntp_timestamp_to_ms(&bNtpBuf[32]);   // receive timestamp
+      T3 = ntp_timestamp_to_ms(&bNtpBuf[40]);   // transmit timestamp
+      T4 = (int64_t)qwT4;
+
+      pSrv->qOffsetMs = ((T2 - T1) + (T3 - T4)) / 2;
+      pSrv->dwDelayMs = (uint32_t)( ((T4 - T1) - (T3 - T2)) < 0 ? 0 : ((T4 - T1) - (T3 - T2)) );
+      pSrv->bStratum  = bNtpBuf[1];
+      pSrv->bPending  = 0;
+      pSrv->bValid    = 1;
+      pSrv->bFailCnt  = 0;
+      break;
+    }
+  }
+}
+
+
+/**
+  * @brief      discard outliers & select the reply with lowest delay
+  * @return     number of valid replies (0 : nothing to select)
+  * @note       outlier : offset is far from median offset of all replies.
+  */
+static uint8_t ntp_select(void)
+{
+  int64_t  qSorted[NTP_ASYNC_SERVER_MAX];
+  int64_t  qMedian, qDiff;
+  uint8_t  bNum = 0;
+  int8_t   cBest = -1;
+
+  for(uint8_t i = 0; i < bNtpServerNum; i++)
+  {
+    if(ntpServer[i].bValid)
+      qSorted[bNum++] = ntpServer[i].qOffsetMs;
+  }
+
+  if(0 == bNum)
+    return 0;
+
+  // insertion sort, N <= NTP_ASYNC_SERVER_MAX
+  for(uint8_t i = 1; i < bNum; i++)
+  {
+    int64_t q = qSorted[i];
+    int8_t  j = i - 1;
+    while((j >= 0) && (qSorted[j] > q))
+    {
+      qSorted[j+1] = qSorted[j];
+      j--;
+    }
+    qSorted[j+1] = q;
+  }
+  qMedian = qSorted[bNum / 2];
+
+  for(uint8_t i = 0; i < bNtpServerNum; i++)
+  {
+    if(!ntpServer[i].bValid)
+      continue;
+
+    qDiff = ntpServer[i].qOffsetMs - qMedian;
+    if( (bNum > 2) && ((qDiff > NTP_ASYNC_OUTLIER_MS) || (qDiff < -NTP_ASYNC_OUTLIER_MS)) )
+      continue;   // falseticker
+
+    if( (cBest < 0) || (ntpServer[i].dwDelayMs < ntpServer[cBest].dwDelayMs) )
+      cBest = i;
+  }
+
+  if(cBest < 0)
+    return 0;
+
+  ntpResult.qOffsetMs = ntpServer[cBest].qOffsetMs;
+  ntpResult.dwDelayMs = ntpServer[cBest].dwDelayMs;
+  ntpResult.bStratum  = ntpServer[cBest].bStratum;
+  ntpResult.bServer   = cBest;
+  ntpResult.bReplies  = bNum;
+
+  return bNum;
+}
+
+
+/**
+  * @brief      poll replies, call repeatedly from loop()
+  * @return     NTP_ASYNC_*
+  * @note       finishes when every server answered or on timeout.
+  *             DONE / TIMEOUT / ERROR is reported once, then state is IDLE.
+  */
+uint8_t ntp_async_process(void)
+{
+  uint8_t  bRet;
+  uint8_t  bPending = 0;
+
+  if(NTP_ASYNC_BUSY != bNtpState)
+  {
+    bRet      = bNtpState;
+    bNtpState = NTP_ASYNC_IDLE;
+    return bRet;
+  }
+
+  // lookup of this round is finished : send now
+  for(uint8_t i = 0; i < bNtpServerNum; i++)
+  {
+    ntp_server_t *pSrv = &ntpServer[i];
+
+    if( (!pSrv->bWaitDns) || (NTP_DNS_DONE != pSrv->bDns) )
+      continue;
+
+    pSrv->bWaitDns  = 0;
+    pSrv->bDns      = NTP_DNS_IDLE;
+
+    if( (!pSrv->ip.isSet()) || (!ntp_send(i)) )
+      pSrv->bFailCnt++;
+  }
+
+  ntp_receive();
+
+  for(uint8_t i = 0; i < bNtpServerNum; i++)
+    bPending += ntpServer[i].bPending + ntpServer[i].bWaitDns;
+
+  if( (0 != bPending) && ((millis() - dwNtpSentMillis) <= NTP_ASYNC_TIMEOUT_MS) )
+    return NTP_ASYNC_BUSY;
+
+  // round is over. no answer -> failure count, cached address is kept
+  // (lost packet is far more likely than moved server) unless it fails repeatedly.
+  for(uint8_t i = 0; i < bNtpServerNum; i++)
+  {
+    if( (ntpServer[i].bPending) || (ntpServer[i].bWaitDns) )
+    {
+      ntpServer[i].bPending = 0;
+      ntpServer[i].bWaitDns = 0;    // lookup may still finish, result is cached
+      ntpServer[i].bFailCnt++;
+      if(ntpServer[i].bFailCnt >= NTP_ASYNC_DNS_REFRESH_FAILS)
+        ntpServer[i].bDnsRefresh = 1;
+    }
+  }
+
+  bNtpState = NTP_ASYNC_IDLE;
+
+  return (ntp_select()) ? NTP_ASYNC_DONE : NTP_ASYNC_TIMEOUT;
+}
+
+
+/**
+  * @brief      request is in flight
+  */
+uint8_t ntp_async_is_busy(void)
+{
+  return (NTP_ASYNC_BUSY == bNtpState) ? 1 : 0;
+}
+
+
+/**
+  * @brief      offset / delay of last successful exchange
+  */
+const ntp_async_result_t *ntp_async_get_result(void)
+{
+  return &ntpResult;
+}
+
+
+/**
+  * @brief      host name of server
+  * @param      bServer   index of server list
+  */
+const char *ntp_async_get_server_name(uint8_t bServer)
+{
+  return (bServer < bNtpServerNum) ? ntpServer[bServer].szName : "";
+}
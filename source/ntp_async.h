@@ -0,0 +1,74 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : ntp_async.h
+  * @brief          : Header for ntp_async.cpp file.
+  *                   non-blocking SNTP client with multi-server selection
+  ******************************************************************************
+  * @attention
+  *
+  *   ntp_async_request() sends requests to every server of the list on one
+  *   socket and returns immediately. server without cached address is
+  *   looked up asynchronously (lwIP DNS), its request is sent from
+  *   ntp_async_process() when the address is known.
+  *   ntp_async_process() polls the socket from loop() and, when replies
+  *   arrive, computes clock offset & round-trip delay in milliseconds
+  *   including NTP fractional seconds. (RFC 5905 on-wire calculation)
+  *   outliers are discarded and the reply with lowest delay is selected.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __NTP_ASYNC_H__
+#define __NTP_ASYNC_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <Udp.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define NTP_ASYNC_PORT                123
+#define NTP_ASYNC_LOCAL_PORT          1337
+#define NTP_ASYNC_PACKET_SIZE         48
+#define NTP_ASYNC_TIMEOUT_MS          2000        // per round, incl. DNS lookup
+#define NTP_ASYNC_DNS_TTL_MS          21600000UL  // 6 hours
+#define NTP_ASYNC_DNS_REFRESH_FAILS   2           // look up again after N timeouts in a row (server moved?)
+#define NTP_ASYNC_SERVER_MAX          4
+#define NTP_ASYNC_OUTLIER_MS          250         // max. distance from median offset
+#define NTP_ASYNC_FAIL_BACKOFF        3           // skip server after N failures in a row
+
+/*** ntp_async_process() result ***/
+#define NTP_ASYNC_IDLE                0
+#define NTP_ASYNC_BUSY                1     // waiting for reply
+#define NTP_ASYNC_DONE                2     // offset / delay is valid
+#define NTP_ASYNC_TIMEOUT             3
+#define NTP_ASYNC_ERROR               4     // DNS / socket error
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/**
+  * @brief      result of last exchange (selected server)
+  */
+typedef struct {
+  int64_t     qOffsetMs;        // true time - local time
+  uint32_t    dwDelayMs;        // round-trip delay (network only, server time excluded)
+  uint8_t     bStratum;
+  uint8_t     bServer;          // index of server list
+  uint8_t     bReplies;         // number of answered servers
+} ntp_async_result_t;
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      ntp_async_init(UDP *pUdp, const char * const *pServerList, uint8_t bServerNum);
+uint8_t   ntp_async_request(void);
+uint8_t   ntp_async_process(void);
+uint8_t   ntp_async_is_busy(void);
+const ntp_async_result_t *ntp_async_get_result(void);
+const char *ntp_async_get_server_name(uint8_t bServer);
+
+#endif /* __NTP_ASYNC_H__ */
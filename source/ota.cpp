@@ -0,0 +1,285 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : ota.cpp
+  * @brief          : firmware update over Wi-Fi (ArduinoOTA push & HTTP upload)
+  ******************************************************************************
+  * @attention
+  *
+  *   HTTP upload : web server parses the whole multipart body in one
+  *   handleClient() call, handing over HTTP_UPLOAD_BUFLEN (2 KB) chunks.
+  *   Update collects them into one flash sector and writes it. only one
+  *   update (either path) at a time.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "ota.h"
+#include <ArduinoOTA.h>
+#include <Updater.h>
+
+/* Defines -------------------------------------------------------------------*/
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+static ESP8266WebServer   *pOtaServer       = NULL;
+static ota_state_fn_t     pfnOtaState       = NULL;
+static const char         *szOtaPassword    = NULL;
+static char               szOtaHost[24]     = "";
+static uint8_t            bOtaStarted       = 0;      // listener & upload handler are up
+static uint8_t            bOtaState         = OTA_STATE_IDLE;
+static uint8_t            bOtaPercent       = 0xFF;
+static uint8_t            bOtaUpload        = 0;      // HTTP upload is accepted
+static uint8_t            bOtaRestart       = 0;      // HTTP update is done, restart pending
+static uint32_t           dwOtaRestartMs    = 0;
+
+/* Function prototypes -------------------------------------------------------*/
+static void     ota_set_state(uint8_t bState, uint32_t dwDone, uint32_t dwTotal);
+static void     ota_arduino_start(void);
+static void     ota_arduino_progress(unsigned int dwDone, unsigned int dwTotal);
+static void     ota_arduino_end(void);
+static void     ota_arduino_error(ota_error_t eError);
+static void     ota_http_upload(void);
+static void     ota_http_done(void);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      start ArduinoOTA listener & register HTTP upload handler
+  * @param      pServer     web server (begin() is called by application)
+  * @param      szPassword  ArduinoOTA password & HTTP basic auth password (required)
+  * @param      pfnState    state callback, may be NULL
+  * @return     none
+  * @note       call when Wi-Fi is connected, before pServer->begin().
+  *             NULL / "" password : nothing is started (no unauthenticated update).
+  */
+void ota_init(ESP8266WebServer *pServer, const char *szPassword, ota_state_fn_t pfnState)
+{
+  pOtaServer      = pServer;
+  pfnOtaState     = pfnState;
+  szOtaPassword   = ((NULL != szPassword) && ('\0' != szPassword[0])) ? szPassword : NULL;
+  bOtaState       = OTA_STATE_IDLE;
+  bOtaRestart     = 0;
+
+  if(NULL == szOtaPassword)
+    return;
+
+  snprintf(szOtaHost, sizeof(szOtaHost), "%s%06x", OTA_HOSTNAME_PREFIX, (unsigned)ESP.getChipId());
+
+  ArduinoOTA.setPort(OTA_PORT);
+  ArduinoOTA.setHostname(szOtaHost);
+  ArduinoOTA.setPassword(szOtaPassword);
+  ArduinoOTA.setRebootOnSuccess(true);
+  ArduinoOTA.onStart(ota_arduino_start);
+  ArduinoOTA.onProgress(ota_arduino_progress);
+  ArduinoOTA.onEnd(ota_arduino_end);
+  ArduinoOTA.onError(ota_arduino_error);
+  ArduinoOTA.begin();
+
+  pOtaServer->on(OTA_UPLOAD_URI, HTTP_POST, ota_http_done, ota_http_upload);
+  bOtaStarted = 1;
+}
+
+
+/**
+  * @brief      poll ArduinoOTA, restart after successful HTTP update
+  * @note       call periodically from loop() context
+  */
+void ota_process(void)
+{
+  if(!bOtaStarted)
+    return;
+
+  if( (bOtaRestart) && ((uint32_t)(millis() - dwOtaRestartMs) >= OTA_RESTART_DELAY_MS) )
+    ESP.restart();
+
+  ArduinoOTA.handle();
+}
+
+
+/**
+  * @brief      check whether update is in progress
+  * @return     1 : receiving / verified (restart pending), 0 : idle
+  */
+uint8_t ota_is_active(void)
+{
+  return ((OTA_STATE_START == bOtaState) || (OTA_STATE_PROGRESS == bOtaState) || (OTA_STATE_END == bOtaState)) ? 1 : 0;
+}
+
+
+/**
+  * @brief      current state
+  * @return     OTA_STATE_xxx
+  */
+uint8_t ota_get_state(void)
+{
+  return bOtaState;
+}
+
+
+/**
+  * @brief      ArduinoOTA / mDNS host name
+  */
+const char *ota_get_hostname(void)
+{
+  return szOtaHost;
+}
+
+
+/**
+  * @brief      update state & notify application
+  * @note       progress is reported on percent change only (display is slow)
+  */
+static void ota_set_state(uint8_t bState, uint32_t dwDone, uint32_t dwTotal)
+{
+  uint8_t bPercent = 0;
+
+  if(dwTotal)
+    bPercent = (uint8_t)(((uint64_t)((dwDone > dwTotal) ? dwTotal : dwDone) * 100) / dwTotal);
+
+  if(OTA_STATE_PROGRESS == bState)
+  {
+    if(bPercent == bOtaPercent)
+      return;
+  }
+  else if(OTA_STATE_START == bState)
+  {
+    bPercent = 0;
+  }
+
+  bOtaState   = bState;
+  bOtaPercent = bPercent;
+
+  if(pfnOtaState)
+    pfnOtaState(bState, dwDone, dwTotal);
+}
+
+
+/**
+  * @brief      ArduinoOTA callbacks
+  */
+static void ota_arduino_start(void)
+{
+  ota_set_state(OTA_STATE_START, 0, 0);
+}
+
+static void ota_arduino_progress(unsigned int dwDone, unsigned int dwTotal)
+{
+  ota_set_state(OTA_STATE_PROGRESS, dwDone, dwTotal);
+}
+
+static void ota_arduino_end(void)
+{
+  ota_set_state(OTA_STATE_END, 0, 0);
+}
+
+static void ota_arduino_error(ota_error_t eError)
+{
+  (void)eError;
+  ota_set_state(OTA_STATE_ERROR, 0, 0);
+}
+
+
+/**
+  * @brief      HTTP upload handler (one call per received chunk)
+  * @note       query args (md5) are parsed before body, available on start
+  */
+static void ota_http_upload(void)
+{
+  HTTPUpload  &upload   = pOtaServer->upload();
+  uint32_t    dwTotal   = pOtaServer->clientContentLength();   // includes multipart header
+  uint32_t    dwSpace;
+
+  switch(upload.status)
+  {
+    case UPLOAD_FILE_START:
+      bOtaUpload = 0;
+
+      if(!pOtaServer->authenticate(OTA_USER, szOtaPassword))
+        return;
+      if(ota_is_active())                                     // restart is pending
+        return;
+
+      // whole free area, rounded down to flash sector
+      dwSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+      if(!Update.begin(dwSpace, U_FLASH))
+        return;
+      if( (pOtaServer->hasArg("md5")) && (!Update.setMD5(pOtaServer->arg("md5").c_str())) )
+      {
+        Update.end();
+        return;
+      }
+
+      bOtaUpload = 1;
+      ota_set_state(OTA_STATE_START, 0, dwTotal);
+      break;
+
+    case UPLOAD_FILE_WRITE:
+      if(!bOtaUpload)
+        return;
+
+      if(Update.write(upload.buf, upload.currentSize) != upload.currentSize)
+      {
+        Update.end();
+        bOtaUpload = 0;
+        ota_set_state(OTA_STATE_ERROR, upload.totalSize, dwTotal);
+        return;
+      }
+
+      ota_set_state(OTA_STATE_PROGRESS, upload.totalSize, dwTotal);
+      break;
+
+    case UPLOAD_FILE_END:
+      if(!bOtaUpload)
+        return;
+
+      bOtaUpload = 0;
+
+      // verifies size, MD5 & image header, then image is copied on next boot
+      if(Update.end(true))
+        ota_set_state(OTA_STATE_END, upload.totalSize, upload.totalSize);
+      else
+        ota_set_state(OTA_STATE_ERROR, upload.totalSize, dwTotal);
+      break;
+
+    case UPLOAD_FILE_ABORTED:
+    default:
+      if(bOtaUpload)
+      {
+        Update.end();
+        bOtaUpload = 0;
+        ota_set_state(OTA_STATE_ERROR, upload.totalSize, dwTotal);
+      }
+      break;
+  }
+}
+
+
+/**
+  * @brief      HTTP request handler (after whole body is received)
+  */
+static void ota_http_done(void)
+{
+  if(!pOtaServer->authenticate(OTA_USER, szOtaPassword))
+  {
+    pOtaServer->requestAuthentication();
+    return;
+  }
+
+  pOtaServer->sendHeader("Connection", "close");
+
+  if(OTA_STATE_END == bOtaState)
+  {
+    pOtaServer->send(200, "text/plain", "OK\n");
+    bOtaRestart     = 1;
+    dwOtaRestartMs  = millis();
+    return;
+  }
+
+  pOtaServer->send(500, "text/plain", String("FAIL ") + Update.getErrorString() + "\n");
+}
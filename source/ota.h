@@ -0,0 +1,69 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : ota.h
+  * @brief          : Header for ota.cpp file.
+  *                   firmware update over Wi-Fi (ArduinoOTA push & HTTP upload)
+  ******************************************************************************
+  * @attention
+  *
+  *   ArduinoOTA : Arduino IDE / espota.py, port OTA_PORT, MD5 checked.
+  *                whole transfer runs inside ota_process() (blocking).
+  *   HTTP       : POST multipart image to OTA_UPLOAD_URI (web server port)
+  *                e.g. curl -F image=@fw.bin "http://<ip>/update?md5=<md5>"
+  *                whole body is read inside one handleClient() (blocking).
+  *
+  *   either path holds the caller (task_http) for the whole transfer, no
+  *   other task runs meanwhile. both stream image to flash through Update
+  *   (one flash sector buffer), image is never held in RAM. on success,
+  *   device restarts. application stops its timer & tasks from the state
+  *   callback, so nothing stale fires once an update fails and loop() resumes.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __OTA_H__
+#define __OTA_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define OTA_PORT                      8266
+#define OTA_UPLOAD_URI                "/update"
+#define OTA_HOSTNAME_PREFIX           "wificlock-"        // + chip id (hex), also mDNS name
+#define OTA_USER                      "admin"             // HTTP basic auth user
+#define OTA_RESTART_DELAY_MS          500                 // HTTP response is sent before restart
+
+/*** state (callback) ***/
+#define OTA_STATE_IDLE                0
+#define OTA_STATE_START               1
+#define OTA_STATE_PROGRESS            2                   // called on every percent step
+#define OTA_STATE_END                 3                   // image is verified, restart follows
+#define OTA_STATE_ERROR               4                   // update is aborted, application resumes
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/**
+  * @brief      state callback
+  * @param      bState      OTA_STATE_xxx
+  * @param      dwDone      bytes written
+  * @param      dwTotal     image size (HTTP : request size), 0 : unknown
+  */
+typedef void (*ota_state_fn_t)(uint8_t bState, uint32_t dwDone, uint32_t dwTotal);
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      ota_init(ESP8266WebServer *pServer, const char *szPassword, ota_state_fn_t pfnState);
+void      ota_process(void);
+uint8_t   ota_is_active(void);
+uint8_t   ota_get_state(void);
+const char *ota_get_hostname(void);
+
+#endif /* __OTA_H__ */
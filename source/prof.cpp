@@ -0,0 +1,298 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : prof.cpp
+  * @brief          : run-time profiling of tasks, timer ISR and heap
+  ******************************************************************************
+  * @attention
+  *
+  *   timer ISR only stores cycle count of its entry (no division, no flash
+  *   code). period error & dispatch latency are computed in task_timer()
+  *   by prof_isr_serviced(). sample is skipped when ISR fired again before
+  *   task_timer() has run (counted as missed redraw tick anyway).
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "prof.h"
+
+/* Defines -------------------------------------------------------------------*/
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+static const char * const prof_name[PROF_ID_NUM] = {
+  "render", "flush", "clcd", "ntp", "scan", "sensor", "http", "isr_lat", "isr_jitter"
+};
+
+static prof_probe_t       g_prof_probe[PROF_ID_NUM];
+static prof_sys_t         g_prof_sys;
+static uint32_t           dwProfCpuMHz          = 80;
+static uint32_t           dwProfIsrPeriodCyc    = 0;
+static uint32_t           dwProfLastTick        = 0;
+static volatile uint32_t  dwProfIsrStamp        = 0;    // cycle count of last ISR entry
+static volatile uint32_t  dwProfIsrDelta        = 0;    // cycles since previous entry, 0 : taken
+
+/* Function prototypes -------------------------------------------------------*/
+static void     prof_add(uint8_t bId, uint32_t dwUs);
+static uint8_t  prof_bucket(uint32_t dwUs);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      clear statistics & set timer ISR period
+  * @param      dwIsrPeriodUs   nominal timer1 period (us)
+  * @return     none
+  * @note       call before timer1 is started
+  */
+void prof_init(uint32_t dwIsrPeriodUs)
+{
+  dwProfCpuMHz        = ESP.getCpuFreqMHz();
+  dwProfIsrPeriodCyc  = dwIsrPeriodUs * dwProfCpuMHz;
+
+  prof_isr_rearm();
+  prof_reset();
+}
+
+
+/**
+  * @brief      forget last timer ISR entry, statistics are kept
+  * @return     none
+  * @note       call while timer1 is stopped, before it is restarted
+  *             (no jitter sample over the stopped interval)
+  */
+void prof_isr_rearm(void)
+{
+  dwProfIsrStamp      = 0;
+  dwProfIsrDelta      = 0;
+}
+
+
+/**
+  * @brief      clear statistics (e.g. before a measurement)
+  */
+void prof_reset(void)
+{
+  memset(g_prof_probe, 0, sizeof(g_prof_probe));
+  memset(&g_prof_sys, 0, sizeof(g_prof_sys));
+
+  g_prof_sys.dwHeapFreeMin  = 0xFFFFFFFF;
+  g_prof_sys.dwHeapBlockMin = 0xFFFFFFFF;
+}
+
+
+/**
+  * @brief      end of measured section
+  * @param      bId       PROF_ID_xxx
+  * @param      dwStart   return value of prof_start()
+  */
+void prof_stop(uint8_t bId, uint32_t dwStart)
+{
+  prof_add(bId, (ESP.getCycleCount() - dwStart) / dwProfCpuMHz);
+}
+
+
+/**
+  * @brief      timer ISR entry
+  * @note       first statement of ISR
+  */
+void ICACHE_RAM_ATTR prof_isr_enter(void)
+{
+  uint32_t dwNow = ESP.getCycleCount();
+
+  if(dwProfIsrStamp)
+    dwProfIsrDelta = dwNow - dwProfIsrStamp;
+  dwProfIsrStamp = dwNow;
+}
+
+
+/**
+  * @brief      timer event is handled by task
+  * @note       first statement of task_timer()
+  */
+void prof_isr_serviced(void)
+{
+  uint32_t dwNow = ESP.getCycleCount();
+  uint32_t dwStamp;
+  uint32_t dwDelta;
+
+  noInterrupts();
+  dwStamp         = dwProfIsrStamp;
+  dwDelta         = dwProfIsrDelta;
+  dwProfIsrDelta  = 0;
+  interrupts();
+
+  if(0 == dwStamp)
+    return;
+
+  prof_add(PROF_ID_ISR_LAT, (dwNow - dwStamp) / dwProfCpuMHz);
+
+  if(dwDelta)
+  {
+    // TIM_SINGLE is re-armed at end of ISR : period is nominal + entry latency + ISR body
+    uint32_t dwErr = (dwDelta > dwProfIsrPeriodCyc) ? (dwDelta - dwProfIsrPeriodCyc) : (dwProfIsrPeriodCyc - dwDelta);
+    prof_add(PROF_ID_ISR_JITTER, dwErr / dwProfCpuMHz);
+  }
+}
+
+
+/**
+  * @brief      redraw tick is handled
+  * @param      dwTick    timer tick counter
+  * @note       more than one tick since last call : redraw request(s) coalesced
+  */
+void prof_redraw_tick(uint32_t dwTick)
+{
+  uint32_t dwTicks = dwTick - dwProfLastTick;
+
+  if( (dwProfLastTick) && (dwTicks > 1) )
+    g_prof_sys.dwRedrawMissed += (dwTicks - 1);
+
+  dwProfLastTick = dwTick;
+}
+
+
+/**
+  * @brief      update heap watermarks
+  * @note       call periodically (task_sys)
+  */
+void prof_heap_sample(void)
+{
+  uint32_t  dwBlock = ESP.getMaxFreeBlockSize();
+  uint8_t   bFrag   = ESP.getHeapFragmentation();
+
+  g_prof_sys.dwHeapFree = ESP.getFreeHeap();
+
+  if(g_prof_sys.dwHeapFree < g_prof_sys.dwHeapFreeMin)
+    g_prof_sys.dwHeapFreeMin = g_prof_sys.dwHeapFree;
+  if(dwBlock < g_prof_sys.dwHeapBlockMin)
+    g_prof_sys.dwHeapBlockMin = dwBlock;
+  if(bFrag > g_prof_sys.bHeapFragMax)
+    g_prof_sys.bHeapFragMax = bFrag;
+}
+
+
+/**
+  * @brief      probe name (for statistics)
+  */
+const char *prof_get_name(uint8_t bId)
+{
+  return (bId < PROF_ID_NUM) ? prof_name[bId] : "";
+}
+
+
+/**
+  * @brief      probe statistics
+  * @return     NULL : invalid id
+  */
+const prof_probe_t *prof_get_probe(uint8_t bId)
+{
+  return (bId < PROF_ID_NUM) ? &g_prof_probe[bId] : NULL;
+}
+
+
+/**
+  * @brief      99th percentile (upper edge of bucket, not above max.)
+  * @return     us, 0 : no sample
+  */
+uint32_t prof_get_p99_us(uint8_t bId)
+{
+  const prof_probe_t  *pProbe = prof_get_probe(bId);
+  uint32_t            dwTarget;
+  uint32_t            dwSum = 0;
+  uint8_t             k;
+
+  if((NULL == pProbe) || (0 == pProbe->dwCount))
+    return 0;
+
+  dwTarget = pProbe->dwCount - (pProbe->dwCount / 100);
+
+  for(k = 0; k < (PROF_HIST_BUCKET_NUM - 1); k++)
+  {
+    dwSum += pProbe->dwHist[k];
+    if(dwSum >= dwTarget)
+      break;
+  }
+
+  if((k < (PROF_HIST_BUCKET_NUM - 1)) && ((1UL << (k + 3)) < pProbe->dwMaxUs))
+    return (1UL << (k + 3));
+
+  return pProbe->dwMaxUs;
+}
+
+
+/**
+  * @brief      heap & redraw statistics
+  */
+const prof_sys_t *prof_get_sys(void)
+{
+  return &g_prof_sys;
+}
+
+
+/**
+  * @brief      compact statistics dump
+  * @param      out     e.g. Serial
+  */
+void prof_dump(Print &out)
+{
+  out.printf(">> prof        n      avg    p99    max (us)\r\n");
+
+  for(uint8_t i = 0; i < PROF_ID_NUM; i++)
+  {
+    const prof_probe_t *pProbe = &g_prof_probe[i];
+
+    out.printf("%-10s %8lu %6lu %6lu %6lu\r\n", prof_name[i],
+               (unsigned long)pProbe->dwCount,
+               (unsigned long)(pProbe->dwCount ? (pProbe->qwSumUs / pProbe->dwCount) : 0),
+               (unsigned long)prof_get_p99_us(i),
+               (unsigned long)pProbe->dwMaxUs);
+  }
+
+  out.printf(">> heap %lu (min %lu, block min %lu, frag max %u %%), redraw missed %lu\r\n",
+             (unsigned long)g_prof_sys.dwHeapFree,
+             (unsigned long)g_prof_sys.dwHeapFreeMin,
+             (unsigned long)g_prof_sys.dwHeapBlockMin,
+             (unsigned)g_prof_sys.bHeapFragMax,
+             (unsigned long)g_prof_sys.dwRedrawMissed);
+}
+
+
+/**
+  * @brief      add one sample
+  */
+static void prof_add(uint8_t bId, uint32_t dwUs)
+{
+  prof_probe_t *pProbe;
+
+  if(bId >= PROF_ID_NUM)
+    return;
+
+  pProbe = &g_prof_probe[bId];
+
+  pProbe->dwCount++;
+  pProbe->qwSumUs += dwUs;
+  if(dwUs > pProbe->dwMaxUs)
+    pProbe->dwMaxUs = dwUs;
+  pProbe->dwHist[prof_bucket(dwUs)]++;
+}
+
+
+/**
+  * @brief      histogram bucket of a sample (log2)
+  */
+static uint8_t prof_bucket(uint32_t dwUs)
+{
+  uint8_t bLog2;
+
+  if(dwUs < 8)
+    return 0;
+
+  bLog2 = (uint8_t)(31 - __builtin_clz(dwUs));
+
+  return ((bLog2 - 2) >= PROF_HIST_BUCKET_NUM) ? (PROF_HIST_BUCKET_NUM - 1) : (bLog2 - 2);
+}
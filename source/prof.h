@@ -0,0 +1,87 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : prof.h
+  * @brief          : Header for prof.cpp file.
+  *                   run-time profiling of tasks, timer ISR and heap
+  ******************************************************************************
+  * @attention
+  *
+  *   probe : uint32_t dwT = prof_start();  ...  prof_stop(PROF_ID_xxx, dwT);
+  *   CPU cycle counter based (ESP.getCycleCount(), ~10 cycles per probe),
+  *   nothing is printed while measuring.
+  *
+  *   histogram has fixed log2 buckets (us) :
+  *     bucket 0 : < 8, bucket k : 2^(k+2) ~ 2^(k+3) - 1, last bucket : >= 2^17
+  *   p99 is upper edge of bucket where 99 % of samples are reached.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __PROF_H__
+#define __PROF_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define PROF_ID_RENDER                0       // clock screen widgets into framebuffer
+#define PROF_ID_FLUSH                 1       // framebuffer to OLED (sendBuffer / dirty tiles)
+#define PROF_ID_CLCD                  2       // CLCD update
+#define PROF_ID_NTP                   3       // NTP request / reply
+#define PROF_ID_SCAN                  4       // Wi-Fi scan & connect step
+#define PROF_ID_SENSOR                5       // sensor acquisition step
+#define PROF_ID_HTTP                  6       // web server handleClient()
+#define PROF_ID_ISR_LAT               7       // timer ISR -> task_timer() start
+#define PROF_ID_ISR_JITTER            8       // timer ISR period error
+#define PROF_ID_NUM                   9
+
+#define PROF_HIST_BUCKET_NUM          16
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+typedef struct {
+	uint32_t          dwCount;
+	uint32_t          dwMaxUs;
+	uint64_t          qwSumUs;
+	uint32_t          dwHist[PROF_HIST_BUCKET_NUM];
+} prof_probe_t;
+
+typedef struct {
+	uint32_t          dwHeapFree;
+	uint32_t          dwHeapFreeMin;    // low watermark
+	uint32_t          dwHeapBlockMin;   // low watermark of largest free block
+	uint8_t           bHeapFragMax;     // high watermark, %
+	uint32_t          dwRedrawMissed;   // redraw ticks coalesced (task_disp too late)
+} prof_sys_t;
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void                prof_init(uint32_t dwIsrPeriodUs);
+void                prof_reset(void);
+void                prof_isr_rearm(void);
+void                prof_stop(uint8_t bId, uint32_t dwStart);
+void ICACHE_RAM_ATTR prof_isr_enter(void);
+void                prof_isr_serviced(void);
+void                prof_redraw_tick(uint32_t dwTick);
+void                prof_heap_sample(void);
+const char          *prof_get_name(uint8_t bId);
+const prof_probe_t  *prof_get_probe(uint8_t bId);
+uint32_t            prof_get_p99_us(uint8_t bId);
+const prof_sys_t    *prof_get_sys(void);
+void                prof_dump(Print &out);
+
+/**
+  * @brief      start of measured section
+  * @return     cycle count, pass to prof_stop()
+  */
+static inline uint32_t prof_start(void)
+{
+  return ESP.getCycleCount();
+}
+
+#endif /* __PROF_H__ */
@@ -0,0 +1,250 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : rtc_store.cpp
+  * @brief          : keeps small records over reset & power cycle
+  ******************************************************************************
+  * @attention
+  *
+  *   every record starts with CRC32 of its payload.
+  *   load tries RTC memory first (fast, no flash access), then flash.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include <EEPROM.h>
+#include "rtc_store.h"
+
+extern "C" {
+#include <user_interface.h>
+}
+
+/* Defines -------------------------------------------------------------------*/
+
+/* Macros --------------------------------------------------------------------*/
+#define RTC_STORE_PAYLOAD(__P__)      ( ((const uint8_t *)(__P__)) + sizeof(uint32_t) )
+#define RTC_STORE_PAYLOAD_LEN(__T__)  ( sizeof(__T__) - sizeof(uint32_t) )
+
+/* Types ---------------------------------------------------------------------*/
+static_assert((RTC_STORE_WLAN_RTC_BLOCK * 4 + sizeof(wlan_cache_t)) <= (RTC_STORE_CLOCK_RTC_BLOCK * 4), "wlan cache overlaps clock cache");
+static_assert((RTC_STORE_CLOCK_RTC_BLOCK * 4 + sizeof(clock_cache_t)) <= 512, "clock cache exceeds RTC user memory");
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Function prototypes -------------------------------------------------------*/
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      open flash area
+  * @note       call once in setup()
+  */
+void rtc_store_init(void)
+{
+  EEPROM.begin(RTC_STORE_FLASH_SIZE);
+}
+
+
+/**
+  * @brief      standard CRC32 (poly 0xEDB88320), bitwise - records are small
+  */
+uint32_t rtc_store_crc32(const void *pData, size_t len)
+{
+  const uint8_t *p  = (const uint8_t *)pData;
+  uint32_t      crc = 0xFFFFFFFF;
+
+  while(len--)
+  {
+    crc ^= *p++;
+    for(uint8_t i = 0; i < 8; i++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+
+  return ~crc;
+}
+
+
+/**
+  * @brief      load Wi-Fi cache
+  * @param      pCache    destination
+  * @return     0 : no valid record / 1 : loaded
+  */
+uint8_t rtc_store_load_wlan(wlan_cache_t *pCache)
+{
+  // 1st : RTC user memory
+  if(ESP.rtcUserMemoryRead(RTC_STORE_WLAN_RTC_BLOCK, (uint32_t *)pCache, sizeof(wlan_cache_t)))
+  {
+    if(pCache->dwCRC == rtc_store_crc32(RTC_STORE_PAYLOAD(pCache), RTC_STORE_PAYLOAD_LEN(wlan_cache_t)))
+      return 1;
+  }
+
+  // 2nd : flash (after power cycle)
+  EEPROM.get(RTC_STORE_WLAN_FLASH_ADDR, *pCache);
+  if(pCache->dwCRC == rtc_store_crc32(RTC_STORE_PAYLOAD(pCache), RTC_STORE_PAYLOAD_LEN(wlan_cache_t)))
+  {
+    // copy back to RTC memory for next reset
+    ESP.rtcUserMemoryWrite(RTC_STORE_WLAN_RTC_BLOCK, (uint32_t *)pCache, sizeof(wlan_cache_t));
+    return 1;
+  }
+
+  memset(pCache, 0, sizeof(wlan_cache_t));
+  return 0;
+}
+
+
+/**
+  * @brief      store Wi-Fi cache
+  * @param      pCache    source (CRC is updated)
+  * @return     none
+  * @note       flash is written only when record is changed.
+  */
+void rtc_store_save_wlan(wlan_cache_t *pCache)
+{
+  wlan_cache_t  old;
+
+  pCache->dwCRC = rtc_store_crc32(RTC_STORE_PAYLOAD(pCache), RTC_STORE_PAYLOAD_LEN(wlan_cache_t));
+
+  ESP.rtcUserMemoryWrite(RTC_STORE_WLAN_RTC_BLOCK, (uint32_t *)pCache, sizeof(wlan_cache_t));
+
+  EEPROM.get(RTC_STORE_WLAN_FLASH_ADDR, old);
+  if(0 != memcmp(&old, pCache, sizeof(wlan_cache_t)))
+  {
+    EEPROM.put(RTC_STORE_WLAN_FLASH_ADDR, *pCache);
+    EEPROM.commit();
+  }
+}
+
+
+/**
+  * @brief      drop Wi-Fi cache (e.g. fast reconnect failed)
+  * @note       stale record would delay every reconnect. remove both copies.
+  */
+void rtc_store_invalidate_wlan(void)
+{
+  wlan_cache_t  empty, old;
+
+  memset(&empty, 0, sizeof(wlan_cache_t));
+  ESP.rtcUserMemoryWrite(RTC_STORE_WLAN_RTC_BLOCK, (uint32_t *)&empty, sizeof(wlan_cache_t));
+
+  EEPROM.get(RTC_STORE_WLAN_FLASH_ADDR, old);
+  if(0 != memcmp(&old, &empty, sizeof(wlan_cache_t)))
+  {
+    EEPROM.put(RTC_STORE_WLAN_FLASH_ADDR, empty);
+    EEPROM.commit();
+  }
+}
+
+
+/**
+  * @brief      load last known time, corrected by time spent in reset
+  * @param      pqwUtcMs    (out) UTC milliseconds now
+  * @param      plDriftPpb  (out) drift estimation of previous run
+  * @return     RTC_STORE_CLOCK_NONE / _MEASURED / _ESTIMATED
+  * @note       RTC timer keeps running over WDT / exception / soft reset and
+  *             deep sleep. on other reset, stored time is returned as it is.
+  *             record is valid once, it is rewritten by rtc_store_save_clock().
+  */
+uint8_t rtc_store_load_clock(uint64_t *pqwUtcMs, int32_t *plDriftPpb)
+{
+  clock_cache_t cache;
+  uint32_t      dwReason  = ESP.getResetInfoPtr()->reason;
+  uint64_t      qwGapUs;
+
+  if(!ESP.rtcUserMemoryRead(RTC_STORE_CLOCK_RTC_BLOCK, (uint32_t *)&cache, sizeof(clock_cache_t)))
+    return RTC_STORE_CLOCK_NONE;
+
+  if(cache.dwCRC != rtc_store_crc32(RTC_STORE_PAYLOAD(&cache), RTC_STORE_PAYLOAD_LEN(clock_cache_t)))
+    return RTC_STORE_CLOCK_NONE;
+
+  // consumed. (a reset loop must not replay the same time forever)
+  memset(&cache.dwCRC, 0, sizeof(cache.dwCRC));
+  ESP.rtcUserMemoryWrite(RTC_STORE_CLOCK_RTC_BLOCK, (uint32_t *)&cache, sizeof(clock_cache_t));
+
+  *pqwUtcMs   = cache.qwUtcMs;
+  *plDriftPpb = cache.lDriftPpb;
+
+  switch(dwReason)
+  {
+    case REASON_WDT_RST:
+    case REASON_EXCEPTION_RST:
+    case REASON_SOFT_WDT_RST:
+    case REASON_SOFT_RESTART:
+    case REASON_DEEP_SLEEP_AWAKE:
+      qwGapUs = ((uint64_t)(system_get_rtc_time() - cache.dwRtcTime) * cache.dwRtcCali) >> 12;
+      if((qwGapUs / 1000) > RTC_STORE_CLOCK_GAP_MAX_MS)
+        return RTC_STORE_CLOCK_NONE;
+      *pqwUtcMs += (qwGapUs / 1000) + millis();   // + time since boot
+      return RTC_STORE_CLOCK_MEASURED;
+
+    default:
+      *pqwUtcMs += millis();
+      return RTC_STORE_CLOCK_ESTIMATED;
+  }
+}
+
+
+/**
+  * @brief      store current time with RTC timer reference
+  * @param      qwUtcMs     UTC milliseconds now
+  * @param      lDriftPpb   current drift estimation
+  * @return     none
+  * @note       RTC memory only (no flash wear), cheap enough to call every second.
+  */
+void rtc_store_save_clock(uint64_t qwUtcMs, int32_t lDriftPpb)
+{
+  clock_cache_t cache;
+
+  cache.dwRtcTime = system_get_rtc_time();
+  cache.qwUtcMs   = qwUtcMs;
+  cache.lDriftPpb = lDriftPpb;
+  cache.dwRtcCali = system_rtc_clock_cali_proc();
+  cache.dwCRC     = rtc_store_crc32(RTC_STORE_PAYLOAD(&cache), RTC_STORE_PAYLOAD_LEN(clock_cache_t));
+
+  ESP.rtcUserMemoryWrite(RTC_STORE_CLOCK_RTC_BLOCK, (uint32_t *)&cache, sizeof(clock_cache_t));
+}
+
+
+/**
+  * @brief      load network settings
+  * @param      pConfig   destination
+  * @return     0 : not provisioned / 1 : loaded
+  * @note       flash only. settings are read once at boot.
+  */
+uint8_t rtc_store_load_config(net_config_t *pConfig)
+{
+  EEPROM.get(RTC_STORE_CONFIG_FLASH_ADDR, *pConfig);
+  if(pConfig->dwCRC == rtc_store_crc32(RTC_STORE_PAYLOAD(pConfig), RTC_STORE_PAYLOAD_LEN(net_config_t)))
+  {
+    // terminate strings in any case
+    pConfig->szSSID[sizeof(pConfig->szSSID)-1] = '\0';
+    pConfig->szPass[sizeof(pConfig->szPass)-1] = '\0';
+    pConfig->szNtp[sizeof(pConfig->szNtp)-1]   = '\0';
+    return 1;
+  }
+
+  memset(pConfig, 0, sizeof(net_config_t));
+  return 0;
+}
+
+
+/**
+  * @brief      store network settings
+  * @param      pConfig   source (CRC is updated)
+  * @return     none
+  * @note       flash is written only when record is changed.
+  */
+void rtc_store_save_config(net_config_t *pConfig)
+{
+  net_config_t  old;
+
+  pConfig->dwCRC = rtc_store_crc32(RTC_STORE_PAYLOAD(pConfig), RTC_STORE_PAYLOAD_LEN(net_config_t));
+
+  EEPROM.get(RTC_STORE_CONFIG_FLASH_ADDR, old);
+  if(0 != memcmp(&old, pConfig, sizeof(net_config_t)))
+  {
+    EEPROM.put(RTC_STORE_CONFIG_FLASH_ADDR, *pConfig);
+    EEPROM.commit();
+  }
+}
@@ -0,0 +1,103 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : rtc_store.h
+  * @brief          : Header for rtc_store.cpp file.
+  *                   keeps small records over reset (RTC user memory) and
+  *                   power cycle (flash)
+  ******************************************************************************
+  * @attention
+  *
+  *   RTC user memory : 512 bytes, survives reset / deep-sleep, lost at power off.
+  *                     blocks 0 ~ 31 are reserved : eboot command written by
+  *                     Update.end() (OTA) lives there until restart.
+  *   flash (EEPROM)  : survives power off, written only when content is changed.
+  *
+  *   clock record is kept in RTC memory only : without RTC timer reference,
+  *   stored time is meaningless after power off.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __RTC_STORE_H__
+#define __RTC_STORE_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define RTC_STORE_FLASH_SIZE          512     // EEPROM emulation sector size
+
+/*** record location (RTC : 4-byte block offset / flash : byte offset) ***/
+#define RTC_STORE_RTC_BLOCK_FIRST     32      // 0 ~ 31 : eboot command (OTA), never written here
+#define RTC_STORE_WLAN_RTC_BLOCK      (RTC_STORE_RTC_BLOCK_FIRST)
+#define RTC_STORE_WLAN_FLASH_ADDR     0
+#define RTC_STORE_CLOCK_RTC_BLOCK     (RTC_STORE_RTC_BLOCK_FIRST + 32)    // after wlan_cache_t (60 bytes), room for growth
+#define RTC_STORE_CONFIG_FLASH_ADDR   64      // after wlan_cache_t, flash only
+
+/*** rtc_store_load_clock() result ***/
+#define RTC_STORE_CLOCK_NONE          0       // no record (power on)
+#define RTC_STORE_CLOCK_MEASURED      1       // elapsed time over reset is measured by RTC timer
+#define RTC_STORE_CLOCK_ESTIMATED     2       // RTC timer restarted (ext. reset / brownout), elapsed time unknown
+
+#define RTC_STORE_CLOCK_GAP_MAX_MS    3600000UL   // longer gap is not trusted (RTC timer wraps in ~7 h)
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/**
+  * @brief      last successful Wi-Fi connection (fast reconnect)
+  */
+typedef struct {
+  uint32_t    dwCRC;              // CRC32 of following fields
+  char        szSSID[33];
+  uint8_t     bBSSID[6];
+  uint8_t     bChannel;
+  uint32_t    dwIP;               // DHCP lease (WLAN_FAST_CONNECT_STATIC_IP : reused as static config)
+  uint32_t    dwGateway;
+  uint32_t    dwSubnet;
+  uint32_t    dwDNS;
+} wlan_cache_t;
+
+/**
+  * @brief      network settings (provisioning portal)
+  */
+typedef struct {
+  uint32_t    dwCRC;              // CRC32 of following fields
+  char        szSSID[33];
+  char        szPass[65];
+  char        szNtp[64];          // "" : built-in server list only
+  int32_t     lTzOffsetSec;       // local time offset from UTC
+} net_config_t;
+
+/**
+  * @brief      last known time (resume after reset)
+  */
+typedef struct {
+  uint32_t    dwCRC;              // CRC32 of following fields
+  uint32_t    dwRtcTime;          // system_get_rtc_time() at qwUtcMs
+  uint64_t    qwUtcMs;            // UTC milliseconds
+  int32_t     lDriftPpb;          // clock discipline state
+  uint32_t    dwRtcCali;          // RTC timer period, us (Q12)
+} clock_cache_t;
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      rtc_store_init(void);
+uint32_t  rtc_store_crc32(const void *pData, size_t len);
+
+uint8_t   rtc_store_load_wlan(wlan_cache_t *pCache);
+void      rtc_store_save_wlan(wlan_cache_t *pCache);
+void      rtc_store_invalidate_wlan(void);
+
+uint8_t   rtc_store_load_config(net_config_t *pConfig);
+void      rtc_store_save_config(net_config_t *pConfig);
+
+uint8_t   rtc_store_load_clock(uint64_t *pqwUtcMs, int32_t *plDriftPpb);
+void      rtc_store_save_clock(uint64_t qwUtcMs, int32_t lDriftPpb);
+
+#endif /* __RTC_STORE_H__ */
@@ -0,0 +1,288 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : sched.c
+  * @brief          : cooperative task scheduler fed by event posting
+  ******************************************************************************
+  * @attention
+  *
+  *   pending events are single 32-bit word. ISR sets bits (ISR itself is not
+  *   interrupted by loop()), loop() side read-modify-write is done with
+  *   interrupts masked. no event is lost or cleared by other context.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include "sched.h"
+
+/* Defines -------------------------------------------------------------------*/
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+static sched_task_t       g_sched_task[SCHED_TASK_MAX];
+static uint8_t            g_sched_task_num  = 0;
+static uint8_t            g_sched_rejected  = 0;      // sched_add() calls refused (table full)
+static volatile uint32_t  g_sched_pending   = 0;
+static uint32_t           g_sched_run_start = 0;      // micros() of running task
+static uint32_t           g_sched_run_budget = 0;
+
+/* Function prototypes -------------------------------------------------------*/
+static uint32_t sched_take_events(uint32_t dwMask);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      remove all tasks & events
+  */
+void sched_init(void)
+{
+  uint8_t i;
+
+  for(i=0; i<SCHED_TASK_MAX; i++)
+    g_sched_task[i].pfnTask = 0;
+
+  g_sched_task_num  = 0;
+  g_sched_rejected  = 0;
+  g_sched_pending   = 0;
+}
+
+
+/**
+  * @brief      register task
+  * @param      szName        name (for statistics)
+  * @param      pfnTask       task entry
+  * @param      bPrio         SCHED_PRIO_HIGHEST ~ SCHED_PRIO_LOWEST
+  * @param      dwEventMask   events to wake-up the task
+  * @param      dwPeriodMs    periodic run, 0 : event only
+  * @param      dwDeadlineMs  max. latency from ready to run, 0 : no deadline
+  * @param      dwBudgetUs    expected max. run time, 0 : not checked
+  * @return     task id / SCHED_TASK_INVALID : table is full
+  */
+uint8_t sched_add(const char *szName, sched_task_fn_t pfnTask, uint8_t bPrio, uint32_t dwEventMask,
+                  uint32_t dwPeriodMs, uint32_t dwDeadlineMs, uint32_t dwBudgetUs)
+{
+  sched_task_t *pTask;
+
+  if((g_sched_task_num >= SCHED_TASK_MAX) || (0 == pfnTask))
+  {
+    g_sched_rejected++;
+    return SCHED_TASK_INVALID;
+  }
+
+  pTask = &g_sched_task[g_sched_task_num];
+
+  pTask->szName       = szName;
+  pTask->pfnTask      = pfnTask;
+  pTask->bPrio        = (bPrio > SCHED_PRIO_LOWEST) ? SCHED_PRIO_LOWEST : bPrio;
+  pTask->dwEventMask  = dwEventMask;
+  pTask->dwPeriodMs   = dwPeriodMs;
+  pTask->dwDeadlineMs = dwDeadlineMs;
+  pTask->dwBudgetUs   = dwBudgetUs;
+  pTask->dwLastRunMs  = millis();
+  pTask->dwReadyMs    = 0;
+  pTask->dwRuns       = 0;
+  pTask->dwOverruns   = 0;
+  pTask->dwMissed     = 0;
+  pTask->dwMaxUs      = 0;
+  pTask->bReady       = 0;
+  pTask->bSuspended   = 0;
+
+  return g_sched_task_num++;
+}
+
+
+/**
+  * @brief      post events (from loop() / task)
+  */
+void sched_post(uint32_t dwEvents)
+{
+  noInterrupts();
+  g_sched_pending |= dwEvents;
+  interrupts();
+}
+
+
+/**
+  * @brief      post events (from ISR)
+  * @note       ISR is not preempted by loop(), plain OR is atomic here.
+  */
+void ICACHE_RAM_ATTR sched_post_isr(uint32_t dwEvents)
+{
+  g_sched_pending |= dwEvents;
+}
+
+
+/**
+  * @brief      pending events (not taken by task yet)
+  */
+uint32_t sched_pending(void)
+{
+  return g_sched_pending;
+}
+
+
+/**
+  * @brief      fetch & clear events of given mask
+  */
+static uint32_t sched_take_events(uint32_t dwMask)
+{
+  uint32_t dwEvents;
+
+  noInterrupts();
+  dwEvents         = g_sched_pending & dwMask;
+  g_sched_pending &= ~dwEvents;
+  interrupts();
+
+  return dwEvents;
+}
+
+
+/**
+  * @brief      run one ready task
+  * @return     0 : nothing to run (idle) / 1 : a task is run
+  * @note       call from loop(). selection order :
+  *               1. highest priority level with a ready task
+  *               2. within that level : overdue task (ready longer than its
+  *                  deadline) first, oldest first, then registration order
+  */
+uint8_t sched_run(void)
+{
+  uint32_t      dwNow     = millis();
+  uint32_t      dwPending = g_sched_pending;
+  uint32_t      dwEvents;
+  uint32_t      dwElapsed;
+  uint32_t      dwAge;
+  uint32_t      dwOldest  = 0;
+  uint8_t       bSel      = SCHED_TASK_INVALID;
+  uint8_t       bOverdue  = 0;
+  uint8_t       bLate;
+  uint8_t       i;
+  sched_task_t  *pTask;
+
+  for(i=0; i<g_sched_task_num; i++)
+  {
+    pTask = &g_sched_task[i];
+
+    if(pTask->bSuspended)
+      continue;
+
+    if( (dwPending & pTask->dwEventMask) ||
+        ((pTask->dwPeriodMs) && ((uint32_t)(dwNow - pTask->dwLastRunMs) >= pTask->dwPeriodMs)) )
+    {
+      if(!pTask->bReady)
+      {
+        pTask->bReady    = 1;
+        pTask->dwReadyMs = dwNow;
+      }
+    }
+
+    if(!pTask->bReady)
+      continue;
+
+    dwAge = dwNow - pTask->dwReadyMs;
+    bLate = ( (pTask->dwDeadlineMs) && (dwAge > pTask->dwDeadlineMs) ) ? 1 : 0;
+
+    // deadline reorders a priority level only, never overtakes higher level
+    if( (SCHED_TASK_INVALID == bSel)                    ||
+        (pTask->bPrio < g_sched_task[bSel].bPrio)       ||
+        ( (pTask->bPrio == g_sched_task[bSel].bPrio) && (bLate) && ((!bOverdue) || (dwAge > dwOldest)) ) )
+    {
+      bSel      = i;
+      dwOldest  = dwAge;
+      bOverdue  = bLate;
+    }
+  }
+
+  if(SCHED_TASK_INVALID == bSel)
+    return 0;
+
+  pTask = &g_sched_task[bSel];
+  if(bOverdue)
+    pTask->dwMissed++;
+
+  dwEvents            = sched_take_events(pTask->dwEventMask);
+  pTask->bReady       = 0;
+  pTask->dwLastRunMs  = dwNow;
+
+  g_sched_run_budget  = pTask->dwBudgetUs;
+  g_sched_run_start   = micros();
+  pTask->pfnTask(dwEvents);
+  dwElapsed           = micros() - g_sched_run_start;
+  g_sched_run_budget  = 0;
+
+  pTask->dwRuns++;
+  if(dwElapsed > pTask->dwMaxUs)
+    pTask->dwMaxUs = dwElapsed;
+  if( (pTask->dwBudgetUs) && (dwElapsed > pTask->dwBudgetUs) )
+    pTask->dwOverruns++;
+
+  return 1;
+}
+
+
+/**
+  * @brief      remaining time budget of running task
+  * @return     us, 0 : budget is used up. 0xFFFFFFFF : no budget (outside task / not set)
+  */
+uint32_t sched_budget_left_us(void)
+{
+  uint32_t dwElapsed;
+
+  if(0 == g_sched_run_budget)
+    return 0xFFFFFFFF;
+
+  dwElapsed = micros() - g_sched_run_start;
+
+  return (dwElapsed >= g_sched_run_budget) ? 0 : (g_sched_run_budget - dwElapsed);
+}
+
+
+/**
+  * @brief      suspend / resume task
+  * @param      bId       return value of sched_add()
+  * @param      bSuspend  1 : suspend, 0 : resume
+  * @note       events of suspended task stay pending and wake it up on resume.
+  *             periodic task runs right after resume when its period is elapsed.
+  */
+void sched_suspend(uint8_t bId, uint8_t bSuspend)
+{
+  if(bId >= g_sched_task_num)
+    return;
+
+  g_sched_task[bId].bSuspended = (bSuspend) ? 1 : 0;
+  g_sched_task[bId].bReady     = 0;
+}
+
+
+/**
+  * @brief      number of registered tasks
+  */
+uint8_t sched_get_task_num(void)
+{
+  return g_sched_task_num;
+}
+
+
+/**
+  * @brief      number of refused registrations (SCHED_TASK_MAX too small / no entry)
+  */
+uint8_t sched_get_rejected(void)
+{
+  return g_sched_rejected;
+}
+
+
+/**
+  * @brief      task information (statistics)
+  * @return     NULL : invalid id
+  */
+const sched_task_t *sched_get_task(uint8_t bId)
+{
+  return (bId < g_sched_task_num) ? &g_sched_task[bId] : 0;
+}
@@ -0,0 +1,91 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : sched.h
+  * @brief          : Header for sched.c file.
+  *                   cooperative task scheduler fed by event posting
+  ******************************************************************************
+  * @attention
+  *
+  *   - task runs when one of its events is posted, or its period is elapsed.
+  *   - one task is run per sched_run() call, then loop() returns (Wi-Fi stack
+  *     runs in between). highest priority ready task is picked every time, so
+  *     latency-critical task waits for at most one task boundary.
+  *   - overdue task (ready longer than its deadline) is picked first among
+  *     tasks of the same priority, a higher level always wins. levels above
+  *     background work are short & event driven, so lower levels still run.
+  *   - time budget is not enforced (cooperative). long task should check
+  *     sched_budget_left_us() and continue on next run. overrun is counted.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define SCHED_TASK_MAX                12
+#define SCHED_TASK_INVALID            0xFF
+
+#define SCHED_PRIO_HIGHEST            0       // smaller value, higher priority
+#define SCHED_PRIO_LOWEST             7
+
+/* Macros --------------------------------------------------------------------*/
+#define SCHED_EV(__BIT__)             (1UL << (__BIT__))
+
+/* Types ---------------------------------------------------------------------*/
+
+/**
+  * @brief      task entry
+  * @param      dwEvents    posted events of this task (cleared before call), 0 : periodic run
+  */
+typedef void (*sched_task_fn_t)(uint32_t dwEvents);
+
+typedef struct {
+	const char        *szName;
+	sched_task_fn_t   pfnTask;
+	uint32_t          dwEventMask;      // events to wake-up
+	uint32_t          dwPeriodMs;       // 0 : event only
+	uint32_t          dwDeadlineMs;     // max. latency from ready to run, 0 : none
+	uint32_t          dwBudgetUs;       // expected max. run time
+	uint32_t          dwLastRunMs;
+	uint32_t          dwReadyMs;        // time when found ready
+	uint32_t          dwRuns;
+	uint32_t          dwOverruns;       // run time > budget
+	uint32_t          dwMissed;         // ready time > deadline
+	uint32_t          dwMaxUs;
+	uint8_t           bPrio;
+	uint8_t           bReady;
+	uint8_t           bSuspended;       // not run, events are kept pending
+} sched_task_t;
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void                sched_init(void);
+uint8_t             sched_add(const char *szName, sched_task_fn_t pfnTask, uint8_t bPrio, uint32_t dwEventMask,
+                              uint32_t dwPeriodMs, uint32_t dwDeadlineMs, uint32_t dwBudgetUs);
+void                sched_post(uint32_t dwEvents);
+void                sched_post_isr(uint32_t dwEvents);
+uint32_t            sched_pending(void);
+uint8_t             sched_run(void);
+uint32_t            sched_budget_left_us(void);
+void                sched_suspend(uint8_t bId, uint8_t bSuspend);
+uint8_t             sched_get_task_num(void);
+uint8_t             sched_get_rejected(void);
+const sched_task_t  *sched_get_task(uint8_t bId);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SCHED_H__ */
@@ -0,0 +1,491 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : sensor.cpp
+  * @brief          : non-blocking sensor registry with fused reading
+  ******************************************************************************
+  * @attention
+  *
+  *   state machine per device :
+  *     IDLE --(interval)--> start --> CONVERTING --(conversion time)--> collect --> IDLE
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor.h"
+#include "i2c_bus.h"
+#include "fmt.h"                  // fmt_float_to_centi()
+
+/* Defines -------------------------------------------------------------------*/
+#define SENSOR_STATE_IDLE             0
+#define SENSOR_STATE_CONVERTING       1
+
+#define AHT20_CMD_TRIGGER             0xAC
+#define AHT20_STATUS_BUSY             0x80
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+typedef struct {
+  uint8_t                 bType;
+  uint8_t                 bState;
+  uint8_t                 bAddr;          // AHT20
+  uint32_t                dwIntervalMs;
+  uint32_t                dwNextMs;       // next start
+  uint32_t                dwStartMs;
+  uint32_t                dwReadyMs;      // collect on / after this
+  TwoWire                 *pWire;         // AHT20
+  AM2302::AM2302_Sensor   *pAM2302;
+  Adafruit_BMP280         *pBMP280;
+  sensor_reading_t        reading;        // last result of this device
+} sensor_dev_t;
+
+/* Variables -----------------------------------------------------------------*/
+static sensor_dev_t     g_sensor_dev[SENSOR_DEV_MAX];
+static uint8_t          g_sensor_dev_num  = 0;
+static uint8_t          g_sensor_rr       = 0;      // round-robin start index
+static sensor_reading_t g_reading         = { SENSOR_VALUE_INVALID, SENSOR_VALUE_INVALID, SENSOR_VALUE_INVALID, 0, 0, 0, 0 };
+
+/* Function prototypes -------------------------------------------------------*/
+static sensor_dev_t *sensor_add(uint8_t bType, uint32_t dwIntervalMs);
+static uint8_t  sensor_start(sensor_dev_t *pDev, uint32_t dwNow);
+static uint8_t  sensor_collect(sensor_dev_t *pDev, uint32_t dwNow);
+static uint8_t  sensor_aht20_crc8(const uint8_t *pData, uint8_t bLen);
+static uint8_t  sensor_aht20_trigger(sensor_dev_t *pDev);
+static uint8_t  sensor_aht20_collect(sensor_dev_t *pDev);
+static void     sensor_dev_publish(sensor_dev_t *pDev, int32_t lTemp, int32_t lHumid, int32_t lPressure);
+static void     sensor_merge(uint32_t dwNow);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      register device
+  * @return     NULL : table is full
+  * @note       1st start is staggered by SENSOR_STAGGER_MS per device
+  */
+static sensor_dev_t *sensor_add(uint8_t bType, uint32_t dwIntervalMs)
+{
+  sensor_dev_t *pDev;
+
+  if(g_sensor_dev_num >= SENSOR_DEV_MAX)
+    return NULL;
+
+  pDev = &g_sensor_dev[g_sensor_dev_num];
+
+  pDev->bType         = bType;
+  pDev->bState        = SENSOR_STATE_IDLE;
+  pDev->bAddr         = 0;
+  pDev->dwIntervalMs  = dwIntervalMs;
+  pDev->dwNextMs      = millis() + (uint32_t)g_sensor_dev_num * SENSOR_STAGGER_MS;
+  pDev->dwStartMs     = 0;
+  pDev->dwReadyMs     = 0;
+  pDev->pWire         = NULL;
+  pDev->pAM2302       = NULL;
+  pDev->pBMP280       = NULL;
+
+  pDev->reading.lTemp       = SENSOR_VALUE_INVALID;
+  pDev->reading.lHumid      = SENSOR_VALUE_INVALID;
+  pDev->reading.lPressure   = SENSOR_VALUE_INVALID;
+  pDev->reading.dwTimeStamp = 0;
+  pDev->reading.bSources    = SENSOR_SRC_BIT(bType);
+  pDev->reading.bSeq        = 0;
+  pDev->reading.bValid      = 0;
+
+  g_sensor_dev_num++;
+
+  return pDev;
+}
+
+
+/**
+  * @brief      add AHT20 (raw I2C)
+  * @param      pWire         I2C instance (already started)
+  * @param      bAddr         7-bit address (SENSOR_AHT20_I2C_ADDR)
+  * @param      dwIntervalMs  readout interval
+  * @return     1 : ok / 0 : table is full
+  * @note       sensor must be calibrated already (Adafruit_AHTX0::begin())
+  */
+uint8_t sensor_attach_aht20(TwoWire *pWire, uint8_t bAddr, uint32_t dwIntervalMs)
+{
+  sensor_dev_t *pDev = sensor_add(SENSOR_TYPE_AHT20, dwIntervalMs);
+
+  if(NULL == pDev)
+    return 0;
+
+  pDev->pWire = pWire;
+  pDev->bAddr = bAddr;
+
+  return 1;
+}
+
+
+/**
+  * @brief      add AM2302 (DHT22)
+  * @note       interval is limited to SENSOR_AM2302_MIN_INTERVAL_MS
+  */
+uint8_t sensor_attach_am2302(AM2302::AM2302_Sensor *pSensor, uint32_t dwIntervalMs)
+{
+  sensor_dev_t *pDev;
+
+  if(dwIntervalMs < SENSOR_AM2302_MIN_INTERVAL_MS)
+    dwIntervalMs = SENSOR_AM2302_MIN_INTERVAL_MS;
+
+  pDev = sensor_add(SENSOR_TYPE_AM2302, dwIntervalMs);
+  if(NULL == pDev)
+    return 0;
+
+  pDev->pAM2302 = pSensor;
+
+  return 1;
+}
+
+
+/**
+  * @brief      add BMP280 (temperature & pressure)
+  * @note       sensor must be set to MODE_NORMAL
+  */
+uint8_t sensor_attach_bmp280(Adafruit_BMP280 *pSensor, uint32_t dwIntervalMs)
+{
+  sensor_dev_t *pDev = sensor_add(SENSOR_TYPE_BMP280, dwIntervalMs);
+
+  if(NULL == pDev)
+    return 0;
+
+  pDev->pBMP280 = pSensor;
+
+  return 1;
+}
+
+
+/**
+  * @brief      make every idle device due now (still staggered)
+  */
+void sensor_request_all(void)
+{
+  uint32_t dwNow = millis();
+  uint8_t  i;
+
+  for(i=0; i<g_sensor_dev_num; i++)
+  {
+    if(SENSOR_STATE_IDLE == g_sensor_dev[i].bState)
+      g_sensor_dev[i].dwNextMs = dwNow + (uint32_t)i * SENSOR_STAGGER_MS;
+  }
+}
+
+
+/**
+  * @brief      one step of acquisition
+  * @param      none
+  * @return     SENSOR_IDLE / SENSOR_BUSY / SENSOR_DONE (fused reading updated) / SENSOR_ERROR
+  * @note       poll from task. never waits for a conversion.
+  *             every due start is issued (short I2C write), at most one
+  *             collect is done per call (AM2302 takes ~5 ms).
+  */
+uint8_t sensor_process(void)
+{
+  uint32_t      dwNow     = millis();
+  uint8_t       bRet      = SENSOR_IDLE;
+  uint8_t       bCollect  = 0;
+  uint8_t       bIdx;
+  uint8_t       i;
+  sensor_dev_t  *pDev;
+
+  for(i=0; i<g_sensor_dev_num; i++)
+  {
+    bIdx = (uint8_t)((g_sensor_rr + i) % g_sensor_dev_num);
+    pDev = &g_sensor_dev[bIdx];
+
+    if(SENSOR_STATE_IDLE == pDev->bState)
+    {
+      if((int32_t)(dwNow - pDev->dwNextMs) >= 0)
+      {
+        // bus clash / NACK : schedule is kept, start again on next poll
+        if( (sensor_start(pDev, dwNow)) || ((dwNow - pDev->dwNextMs) > SENSOR_TIMEOUT_MS) )
+        {
+          if(SENSOR_STATE_IDLE == pDev->bState)           // gave up : this reading is lost
+            bRet = SENSOR_ERROR;
+
+          pDev->dwNextMs += pDev->dwIntervalMs;
+          if((int32_t)(dwNow - pDev->dwNextMs) >= 0)     // long stall : don't catch up
+            pDev->dwNextMs = dwNow + pDev->dwIntervalMs;
+        }
+      }
+    }
+
+    if((SENSOR_STATE_CONVERTING == pDev->bState) && (!bCollect))
+    {
+      if((int32_t)(dwNow - pDev->dwReadyMs) >= 0)
+      {
+        bCollect = 1;
+        switch(sensor_collect(pDev, dwNow))
+        {
+          case SENSOR_DONE:
+            bRet = SENSOR_DONE;
+            break;
+          case SENSOR_ERROR:
+            if(SENSOR_DONE != bRet)
+              bRet = SENSOR_ERROR;
+            break;
+          default:
+            break;
+        }
+        g_sensor_rr = (uint8_t)((bIdx + 1) % g_sensor_dev_num);    // fairness of collect
+      }
+    }
+
+    if((SENSOR_IDLE == bRet) && (SENSOR_STATE_CONVERTING == pDev->bState))
+      bRet = SENSOR_BUSY;
+  }
+
+  if(SENSOR_DONE == bRet)
+    sensor_merge(dwNow);
+
+  return bRet;
+}
+
+
+/**
+  * @brief      fused reading (shared, updated by sensor_process() only)
+  */
+const sensor_reading_t *sensor_get_reading(void)
+{
+  return &g_reading;
+}
+
+
+/**
+  * @brief      issue conversion
+  * @return     1 : started / 0 : bus busy or error, device stays idle
+  */
+static uint8_t sensor_start(sensor_dev_t *pDev, uint32_t dwNow)
+{
+  switch(pDev->bType)
+  {
+    case SENSOR_TYPE_AHT20:
+      if(!sensor_aht20_trigger(pDev))
+        return 0;
+      pDev->dwReadyMs = dwNow + SENSOR_AHT20_CONV_MS;
+      break;
+
+    case SENSOR_TYPE_AM2302:
+    case SENSOR_TYPE_BMP280:
+    default:
+      // nothing to trigger. collect on next step.
+      pDev->dwReadyMs = dwNow;
+      break;
+  }
+
+  pDev->dwStartMs = dwNow;
+  pDev->bState    = SENSOR_STATE_CONVERTING;
+
+  return 1;
+}
+
+
+/**
+  * @brief      collect result of one device
+  * @return     SENSOR_DONE / SENSOR_BUSY (retry later) / SENSOR_ERROR
+  */
+static uint8_t sensor_collect(sensor_dev_t *pDev, uint32_t dwNow)
+{
+  uint8_t bRet = SENSOR_DONE;
+
+  switch(pDev->bType)
+  {
+    case SENSOR_TYPE_AHT20:
+      bRet = sensor_aht20_collect(pDev);
+      break;
+
+    case SENSOR_TYPE_AM2302:
+      // timing-critical bit-banging (~5 ms), only collect of this step
+      if(0 == pDev->pAM2302->read())
+        sensor_dev_publish(pDev, fmt_float_to_centi(pDev->pAM2302->get_Temperature()), fmt_float_to_centi(pDev->pAM2302->get_Humidity()), SENSOR_VALUE_INVALID);
+      else
+        bRet = SENSOR_ERROR;
+      break;
+
+    case SENSOR_TYPE_BMP280:
+      if(i2c_bus_acquire(I2C_BUS_DEV_BMP280))
+      {
+        sensor_dev_publish(pDev, fmt_float_to_centi(pDev->pBMP280->readTemperature()), SENSOR_VALUE_INVALID,
+                           (int32_t)(pDev->pBMP280->readPressure() + 0.5f));
+        i2c_bus_release(I2C_BUS_DEV_BMP280);
+      }
+      else
+      {
+        bRet = SENSOR_BUSY;
+      }
+      break;
+
+    default:
+      bRet = SENSOR_ERROR;
+      break;
+  }
+
+  if(SENSOR_BUSY == bRet)
+  {
+    if((dwNow - pDev->dwStartMs) <= SENSOR_TIMEOUT_MS)
+    {
+      pDev->dwReadyMs = dwNow + SENSOR_AHT20_RETRY_MS;
+      return SENSOR_BUSY;
+    }
+    bRet = SENSOR_ERROR;
+  }
+
+  pDev->bState = SENSOR_STATE_IDLE;
+
+  return bRet;
+}
+
+
+/**
+  * @brief      AHT20 CRC-8 (poly 0x31, init 0xFF)
+  */
+static uint8_t sensor_aht20_crc8(const uint8_t *pData, uint8_t bLen)
+{
+  uint8_t bCrc = 0xFF;
+  uint8_t i;
+
+  while(bLen--)
+  {
+    bCrc ^= *pData++;
+    for(i=0; i<8; i++)
+      bCrc = (bCrc & 0x80) ? ((bCrc << 1) ^ 0x31) : (bCrc << 1);
+  }
+
+  return bCrc;
+}
+
+
+/**
+  * @brief      AHT20 : start measurement
+  * @return     1 : ok / 0 : bus busy or NACK
+  */
+static uint8_t sensor_aht20_trigger(sensor_dev_t *pDev)
+{
+  uint8_t bErr;
+
+  if(!i2c_bus_acquire(I2C_BUS_DEV_AHTX0))
+    return 0;
+
+  pDev->pWire->beginTransmission(pDev->bAddr);
+  pDev->pWire->write(AHT20_CMD_TRIGGER);
+  pDev->pWire->write((uint8_t)0x33);
+  pDev->pWire->write((uint8_t)0x00);
+  bErr = pDev->pWire->endTransmission();
+
+  i2c_bus_release(I2C_BUS_DEV_AHTX0);
+
+  return (0 == bErr);
+}
+
+
+/**
+  * @brief      AHT20 : read result
+  * @return     SENSOR_DONE / SENSOR_BUSY (not ready yet) / SENSOR_ERROR
+  * @note       status, humidity 20 bit, temperature 20 bit, CRC
+  *             RH = raw / 2^20 * 100, T = raw / 2^20 * 200 - 50
+  */
+static uint8_t sensor_aht20_collect(sensor_dev_t *pDev)
+{
+  uint8_t  bBuf[7];
+  uint8_t  bLen = 0;
+  uint32_t dwRawHumid;
+  uint32_t dwRawTemp;
+
+  if(!i2c_bus_acquire(I2C_BUS_DEV_AHTX0))
+    return SENSOR_BUSY;
+
+  if(sizeof(bBuf) == pDev->pWire->requestFrom(pDev->bAddr, (uint8_t)sizeof(bBuf)))
+  {
+    while((bLen < sizeof(bBuf)) && pDev->pWire->available())
+      bBuf[bLen++] = (uint8_t)pDev->pWire->read();
+  }
+
+  i2c_bus_release(I2C_BUS_DEV_AHTX0);
+
+  if(sizeof(bBuf) != bLen)
+    return SENSOR_ERROR;
+
+  if(bBuf[0] & AHT20_STATUS_BUSY)
+    return SENSOR_BUSY;
+
+  if(sensor_aht20_crc8(bBuf, 6) != bBuf[6])
+    return SENSOR_ERROR;
+
+  dwRawHumid = ((uint32_t)bBuf[1] << 12) | ((uint32_t)bBuf[2] << 4) | (bBuf[3] >> 4);
+  dwRawTemp  = ((uint32_t)(bBuf[3] & 0x0F) << 16) | ((uint32_t)bBuf[4] << 8) | bBuf[5];
+
+  sensor_dev_publish( pDev,
+                      (int32_t)(((uint64_t)dwRawTemp * 20000) >> 20) - 5000,
+                      (int32_t)(((uint64_t)dwRawHumid * 10000) >> 20),
+                      SENSOR_VALUE_INVALID );
+
+  return SENSOR_DONE;
+}
+
+
+/**
+  * @brief      update reading of one device
+  */
+static void sensor_dev_publish(sensor_dev_t *pDev, int32_t lTemp, int32_t lHumid, int32_t lPressure)
+{
+  pDev->reading.lTemp       = lTemp;
+  pDev->reading.lHumid      = lHumid;
+  pDev->reading.lPressure   = lPressure;
+  pDev->reading.dwTimeStamp = millis();
+  pDev->reading.bSeq++;
+  pDev->reading.bValid      = 1;
+}
+
+
+/**
+  * @brief      merge device readings into shared reading
+  * @note       average of valid & fresh values per quantity
+  */
+static void sensor_merge(uint32_t dwNow)
+{
+  int32_t   lSumTemp  = 0;
+  int32_t   lSumHumid = 0;
+  int32_t   lPressure = SENSOR_VALUE_INVALID;
+  uint8_t   bNumTemp  = 0;
+  uint8_t   bNumHumid = 0;
+  uint8_t   bSources  = 0;
+  uint8_t   i;
+  const sensor_dev_t *pDev;
+
+  for(i=0; i<g_sensor_dev_num; i++)
+  {
+    pDev = &g_sensor_dev[i];
+
+    if(!pDev->reading.bValid)
+      continue;
+    if((dwNow - pDev->reading.dwTimeStamp) > (pDev->dwIntervalMs * SENSOR_STALE_INTERVALS))
+      continue;
+
+    bSources |= SENSOR_SRC_BIT(pDev->bType);
+
+    if(SENSOR_VALUE_INVALID != pDev->reading.lTemp)
+    {
+      lSumTemp += pDev->reading.lTemp;
+      bNumTemp++;
+    }
+    if(SENSOR_VALUE_INVALID != pDev->reading.lHumid)
+    {
+      lSumHumid += pDev->reading.lHumid;
+      bNumHumid++;
+    }
+    if(SENSOR_VALUE_INVALID != pDev->reading.lPressure)
+      lPressure = pDev->reading.lPressure;
+  }
+
+  g_reading.lTemp       = (bNumTemp)  ? (lSumTemp  / bNumTemp)  : SENSOR_VALUE_INVALID;
+  g_reading.lHumid      = (bNumHumid) ? (lSumHumid / bNumHumid) : SENSOR_VALUE_INVALID;
+  g_reading.lPressure   = lPressure;
+  g_reading.dwTimeStamp = dwNow;
+  g_reading.bSources    = bSources;
+  g_reading.bSeq++;
+  g_reading.bValid      = (0 != bSources);
+}
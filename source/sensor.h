@@ -0,0 +1,89 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : sensor.h
+  * @brief          : Header for sensor.cpp file.
+  *                   non-blocking sensor registry with fused reading
+  ******************************************************************************
+  * @attention
+  *
+  *   every attached device is polled on its own interval. start times are
+  *   staggered, so a conversion of one device overlaps with readout of others.
+  *   sensor_process() is polled from a task : issues conversion and returns,
+  *   collects result when conversion time is over (one device per call).
+  *   results are merged into one shared reading, renderer never touches the bus.
+  *
+  *   AHT20  : trigger (0xAC) -> wait 80 ms -> read 7 bytes. raw I2C access,
+  *            Adafruit_AHTX0 is used for detection & calibration only.
+  *   BMP280 : normal mode (continuous conversion), collect = register read.
+  *            temperature & pressure.
+  *   AM2302 : single-wire with timing-critical bit-banging, can not be split.
+  *            read is done alone in its own pipeline step.
+  *
+  *   fusion : temperature = average of valid devices, humidity = average of
+  *            AHT20 / AM2302, pressure = BMP280. stale value (no update for
+  *            SENSOR_STALE_INTERVALS x interval) is excluded.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SENSOR_H__
+#define __SENSOR_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <Wire.h>
+#include <AM2302-Sensor.h>
+#include <Adafruit_BMP280.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define SENSOR_TYPE_NONE              0
+#define SENSOR_TYPE_AHT20             1
+#define SENSOR_TYPE_AM2302            2
+#define SENSOR_TYPE_BMP280            3
+
+#define SENSOR_DEV_MAX                3
+
+#define SENSOR_IDLE                   0       // sensor_process() return
+#define SENSOR_BUSY                   1
+#define SENSOR_DONE                   2       // fused reading is updated
+#define SENSOR_ERROR                  3
+
+#define SENSOR_AHT20_I2C_ADDR         0x38
+#define SENSOR_AHT20_CONV_MS          80      // datasheet : >= 75 ms
+#define SENSOR_AHT20_RETRY_MS         10      // still busy : poll again
+#define SENSOR_AM2302_MIN_INTERVAL_MS 2000    // datasheet : >= 2 sec between reads
+#define SENSOR_TIMEOUT_MS             500
+#define SENSOR_STAGGER_MS             20      // start offset between devices
+#define SENSOR_STALE_INTERVALS        3
+
+#define SENSOR_VALUE_INVALID          INT32_MIN   // same as FMT_VALUE_INVALID
+
+/* Macros --------------------------------------------------------------------*/
+#define SENSOR_SRC_BIT(__TYPE__)      (1 << (__TYPE__))
+
+/* Types ---------------------------------------------------------------------*/
+typedef struct {
+	int32_t     lTemp;            // 'C x 100, SENSOR_VALUE_INVALID : not available
+	int32_t     lHumid;           // %RH x 100, SENSOR_VALUE_INVALID : not available
+	int32_t     lPressure;        // Pa (= hPa x 100), SENSOR_VALUE_INVALID : not available
+	uint32_t    dwTimeStamp;      // millis() of last update
+	uint8_t     bSources;         // SENSOR_SRC_BIT(SENSOR_TYPE_xxx) of merged devices
+	uint8_t     bSeq;             // increased on every update
+	uint8_t     bValid;
+} sensor_reading_t;
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+uint8_t   sensor_attach_aht20(TwoWire *pWire, uint8_t bAddr, uint32_t dwIntervalMs);
+uint8_t   sensor_attach_am2302(AM2302::AM2302_Sensor *pSensor, uint32_t dwIntervalMs);
+uint8_t   sensor_attach_bmp280(Adafruit_BMP280 *pSensor, uint32_t dwIntervalMs);
+
+void      sensor_request_all(void);
+uint8_t   sensor_process(void);
+const sensor_reading_t *sensor_get_reading(void);
+
+#endif /* __SENSOR_H__ */
@@ -0,0 +1,160 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : sse.cpp
+  * @brief          : Server-Sent Events push channel of web server
+  ******************************************************************************
+  * @attention
+  *
+  *   response header is written here directly, ESP8266WebServer only sees
+  *   a handler that sent nothing. WiFiClient is reference counted, so the
+  *   copy in g_sse_client[] keeps the connection after handleClient().
+  *
+  *   event format :  "event: <name>\ndata: <payload>\n\n"
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sse.h"
+
+/* Defines -------------------------------------------------------------------*/
+#define SSE_EVENT_LEN_MAX             256
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+typedef struct {
+	WiFiClient  client;
+	uint8_t     bUsed;
+	uint8_t     bMiss;            // consecutive events not written (TX buffer full)
+} sse_client_t;
+
+/* Variables -----------------------------------------------------------------*/
+static sse_client_t       g_sse_client[SSE_CLIENT_MAX];
+
+static const char         sse_header[] PROGMEM =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/event-stream\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Connection: keep-alive\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "\r\n";
+
+/* Function prototypes -------------------------------------------------------*/
+static void sse_drop(sse_client_t *pSub);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      release subscriber slot
+  */
+static void sse_drop(sse_client_t *pSub)
+{
+  pSub->client.stop();
+  pSub->client  = WiFiClient();   // release connection reference
+  pSub->bUsed   = 0;
+  pSub->bMiss   = 0;
+}
+
+
+/**
+  * @brief      take over the connection of current request as subscriber
+  * @param      client    myServer.client()
+  * @return     1 : subscribed  / 0 : no free slot (caller sends error response)
+  * @note       disconnected subscribers are released first.
+  */
+uint8_t sse_subscribe(WiFiClient &client)
+{
+  char          szRetry[24];
+  sse_client_t  *pFree = NULL;
+  uint8_t       i;
+
+  for(i=0; i<SSE_CLIENT_MAX; i++)
+  {
+    if(g_sse_client[i].bUsed && !g_sse_client[i].client.connected())
+      sse_drop(&g_sse_client[i]);
+
+    if((NULL == pFree) && !g_sse_client[i].bUsed)
+      pFree = &g_sse_client[i];
+  }
+
+  if(NULL == pFree)
+    return 0;
+
+  pFree->client = client;
+  pFree->bUsed  = 1;
+  pFree->bMiss  = 0;
+
+  pFree->client.setNoDelay(true);     // events are small, don't wait for Nagle
+  pFree->client.write_P(sse_header, sizeof(sse_header) - 1);
+  snprintf(szRetry, sizeof(szRetry), "retry: %u\n\n", (unsigned)SSE_RETRY_MS);
+  pFree->client.write((const uint8_t *)szRetry, strlen(szRetry));
+
+  return 1;
+}
+
+
+/**
+  * @brief      send one event to every subscriber
+  * @param      szEvent   event name
+  * @param      szData    payload, single line
+  * @return     number of subscribers the event is written to
+  * @note       never blocks : if TX buffer of a client has no room, the event
+  *             is skipped for it. client is dropped after SSE_MISS_MAX misses.
+  */
+uint8_t sse_broadcast(const char *szEvent, const char *szData)
+{
+  char          szMsg[SSE_EVENT_LEN_MAX];
+  int           nLen;
+  uint8_t       bSent = 0;
+  uint8_t       i;
+
+  nLen = snprintf(szMsg, sizeof(szMsg), "event: %s\ndata: %s\n\n", szEvent, szData);
+  if((nLen <= 0) || (nLen >= (int)sizeof(szMsg)))
+    return 0;
+
+  for(i=0; i<SSE_CLIENT_MAX; i++)
+  {
+    sse_client_t *pSub = &g_sse_client[i];
+
+    if(!pSub->bUsed)
+      continue;
+
+    if(!pSub->client.connected())
+    {
+      sse_drop(pSub);
+      continue;
+    }
+
+    if(pSub->client.availableForWrite() < nLen)
+    {
+      if(++pSub->bMiss >= SSE_MISS_MAX)
+        sse_drop(pSub);
+      continue;
+    }
+
+    pSub->client.write((const uint8_t *)szMsg, (size_t)nLen);
+    pSub->bMiss = 0;
+    bSent++;
+  }
+
+  return bSent;
+}
+
+
+/**
+  * @brief      get number of subscribers
+  * @return     number of occupied slots (incl. not yet detected disconnection)
+  */
+uint8_t sse_get_client_num(void)
+{
+  uint8_t bNum = 0;
+  uint8_t i;
+
+  for(i=0; i<SSE_CLIENT_MAX; i++)
+    bNum += g_sse_client[i].bUsed;
+
+  return bNum;
+}
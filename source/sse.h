@@ -0,0 +1,42 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : sse.h
+  * @brief          : Header for sse.cpp file.
+  *                   Server-Sent Events push channel of web server
+  ******************************************************************************
+  * @attention
+  *
+  *   a subscriber is the TCP connection of GET request, taken over from
+  *   ESP8266WebServer and kept open. events are written to every subscriber
+  *   without waiting, so a slow client loses events instead of stalling loop.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SSE_H__
+#define __SSE_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define SSE_CLIENT_MAX                3       // lwIP has only a few TCP PCBs, keep one for requests
+#define SSE_RETRY_MS                  3000    // reconnect delay hint for browser
+#define SSE_MISS_MAX                  5       // consecutive lost events before a client is dropped
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+uint8_t   sse_subscribe(WiFiClient &client);
+uint8_t   sse_broadcast(const char *szEvent, const char *szData);
+uint8_t   sse_get_client_num(void);
+
+#endif /* __SSE_H__ */
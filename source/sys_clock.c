@@ -0,0 +1,344 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : sys_clock.c
+  * @brief          : local time base with millisecond resolution
+  ******************************************************************************
+  * @attention
+  *
+  *   getters are read-only and may be called from timer ISR.
+  *   reference is modified only from loop() with interrupts masked.
+  *
+  *   now = ref + elapsed + (elapsed * drift) + slew(elapsed)
+  *     elapsed : millis() since reference
+  *     drift   : estimated crystal error (ppb)
+  *     slew    : pending correction, applied at max. SYS_CLOCK_SLEW_MAX_PPM
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include "sys_clock.h"
+
+/* Defines -------------------------------------------------------------------*/
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+static volatile uint64_t  qwRefUtcMs        = 0;    // UTC ms at dwRefMillis
+static volatile uint32_t  dwRefMillis       = 0;
+static volatile int32_t   lDriftPpb         = 0;    // +: local clock is slow
+static volatile int32_t   lSlewMs           = 0;    // correction not applied yet
+static volatile uint8_t   bClockSet         = 0;
+static int32_t            lTzOffsetSec      = 0;
+
+static uint32_t           dwLastSyncMillis  = 0;    // for drift estimation
+static uint8_t            bLastSyncValid    = 0;
+static uint32_t           dwSyncMinSec      = 1800;
+static uint32_t           dwSyncMaxSec      = 14400;
+static uint32_t           dwSyncIntervalSec = 1800;
+static uint32_t           dwSyncRetrySec    = 0;    // 0 : last sync was fine
+
+/* Function prototypes -------------------------------------------------------*/
+static int64_t  sys_clock_correction(uint32_t dwElapsed, int32_t lDrift, int32_t lSlew, int32_t *pSlewDone);
+static void     sys_clock_rebase(void);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      correction of elapsed time (drift + slew)
+  * @param      dwElapsed   ms since reference
+  * @param      lDrift      ppb
+  * @param      lSlew       pending slew, ms
+  * @param      pSlewDone   (out) part of slew already applied, may be NULL
+  * @return     correction in ms
+  */
+static int64_t sys_clock_correction(uint32_t dwElapsed, int32_t lDrift, int32_t lSlew, int32_t *pSlewDone)
+{
+  int64_t qDrift  = ((int64_t)dwElapsed * lDrift) / 1000000000LL;
+  int32_t lMax    = (int32_t)(((int64_t)dwElapsed * SYS_CLOCK_SLEW_MAX_PPM) / 1000000LL);
+  int32_t lDone;
+
+  if(lSlew > lMax)          lDone =  lMax;
+  else if(lSlew < -lMax)    lDone = -lMax;
+  else                      lDone =  lSlew;
+
+  if(pSlewDone)
+    *pSlewDone = lDone;
+
+  return qDrift + lDone;
+}
+
+
+/**
+  * @brief      move reference to now, fold applied corrections in
+  * @note       called from loop() only
+  */
+static void sys_clock_rebase(void)
+{
+  uint32_t dwNow = millis();
+  uint32_t dwElapsed;
+  int32_t  lSlewDone;
+  int64_t  qCorr;
+
+  noInterrupts();
+  dwElapsed   = dwNow - dwRefMillis;
+  qCorr       = sys_clock_correction(dwElapsed, lDriftPpb, lSlewMs, &lSlewDone);
+  qwRefUtcMs  = (uint64_t)((int64_t)qwRefUtcMs + dwElapsed + qCorr);
+  dwRefMillis = dwNow;
+  lSlewMs    -= lSlewDone;
+  interrupts();
+}
+
+
+/**
+  * @brief      initialize time base
+  * @param      lTimeZoneOffset   local time offset from UTC in seconds (GMT+9 : 32400)
+  */
+void sys_clock_init(int32_t lTimeZoneOffset)
+{
+  lTzOffsetSec  = lTimeZoneOffset;
+  qwRefUtcMs    = 0;
+  dwRefMillis   = millis();
+  lSlewMs       = 0;
+  bClockSet     = 0;
+}
+
+
+/**
+  * @brief      housekeeping, call from loop()
+  * @note       moves reference forward so that (millis() - dwRefMillis) never wraps
+  *             and 32-bit slew/drift arithmetic stays in range.
+  */
+void sys_clock_update(void)
+{
+  if((millis() - dwRefMillis) < SYS_CLOCK_REBASE_MS)
+    return;
+
+  sys_clock_rebase();
+}
+
+
+/**
+  * @brief      set absolute UTC time (step)
+  * @param      qwUtcMs   milliseconds since 1970-01-01 00:00:00 UTC
+  * @note       pending slew is dropped
+  */
+void sys_clock_set_ms(uint64_t qwUtcMs)
+{
+  uint32_t dwNow = millis();
+
+  noInterrupts();
+  qwRefUtcMs  = qwUtcMs;
+  dwRefMillis = dwNow;
+  lSlewMs     = 0;
+  bClockSet   = 1;
+  interrupts();
+}
+
+
+/**
+  * @brief      correct time by measured offset immediately (step)
+  * @param      qOffsetMs   (true time - local time) in milliseconds
+  */
+void sys_clock_apply_offset(int64_t qOffsetMs)
+{
+  sys_clock_set_ms((uint64_t)((int64_t)sys_clock_now_ms() + qOffsetMs));
+}
+
+
+/**
+  * @brief      check time is valid
+  * @return     0 : never synchronized / 1 : valid
+  */
+uint8_t sys_clock_is_set(void)
+{
+  return bClockSet;
+}
+
+
+/**
+  * @brief      feed a sync result (NTP offset) to clock discipline
+  * @param      qOffsetMs   (true time - local time) in milliseconds
+  * @return     none
+  * @note       - 1st sync or |offset| > SYS_CLOCK_STEP_THRESHOLD_MS : step
+  *             - else : slew, and offset over the last span updates drift
+  *             - sync interval is doubled / halved by size of offset
+  */
+void sys_clock_discipline(int64_t qOffsetMs)
+{
+  uint32_t dwNow  = millis();
+  uint32_t dwSpan = dwNow - dwLastSyncMillis;
+  int64_t  qAbs   = (qOffsetMs < 0) ? -qOffsetMs : qOffsetMs;
+  int64_t  qDrift;
+
+  dwSyncRetrySec = 0;
+
+  if( (!bClockSet) || (qAbs > SYS_CLOCK_STEP_THRESHOLD_MS) )
+  {
+    sys_clock_apply_offset(qOffsetMs);
+
+    // span contains a step, can't be used for drift. start again.
+    dwSyncIntervalSec = dwSyncMinSec;
+    dwLastSyncMillis  = dwNow;
+    bLastSyncValid    = 1;
+    return;
+  }
+
+  // offset accumulated since last sync = residual drift (previous correction is done by slew)
+  if( (bLastSyncValid) && (dwSpan >= SYS_CLOCK_DRIFT_MIN_SPAN_MS) )
+  {
+    qDrift  = (qOffsetMs * 1000000000LL) / (int64_t)dwSpan;
+    qDrift  = lDriftPpb + (qDrift / 2);         // gain 1/2, smooths NTP jitter
+
+    if(qDrift >  SYS_CLOCK_DRIFT_MAX_PPB)  qDrift =  SYS_CLOCK_DRIFT_MAX_PPB;
+    if(qDrift < -SYS_CLOCK_DRIFT_MAX_PPB)  qDrift = -SYS_CLOCK_DRIFT_MAX_PPB;
+
+    sys_clock_rebase();                         // keep past time with old drift
+    noInterrupts();
+    lDriftPpb = (int32_t)qDrift;
+    interrupts();
+  }
+
+  // slew
+  sys_clock_rebase();
+  noInterrupts();
+  lSlewMs += (int32_t)qOffsetMs;
+  interrupts();
+
+  dwLastSyncMillis = dwNow;
+  bLastSyncValid   = 1;
+
+  // adaptive sync interval
+  if(qAbs < SYS_CLOCK_STABLE_MS)
+  {
+    dwSyncIntervalSec *= 2;
+    if(dwSyncIntervalSec > dwSyncMaxSec)
+      dwSyncIntervalSec = dwSyncMaxSec;
+  }
+  else if(qAbs > SYS_CLOCK_UNSTABLE_MS)
+  {
+    dwSyncIntervalSec /= 2;
+    if(dwSyncIntervalSec < dwSyncMinSec)
+      dwSyncIntervalSec = dwSyncMinSec;
+  }
+}
+
+
+/**
+  * @brief      limits of adaptive sync interval
+  * @param      dwMinSec    interval after start / step
+  * @param      dwMaxSec    upper bound while drift is stable
+  */
+void sys_clock_set_sync_limits(uint32_t dwMinSec, uint32_t dwMaxSec)
+{
+  dwSyncMinSec      = dwMinSec;
+  dwSyncMaxSec      = (dwMaxSec < dwMinSec) ? dwMinSec : dwMaxSec;
+  dwSyncIntervalSec = dwMinSec;
+}
+
+
+/**
+  * @brief      recommended interval until next sync
+  * @return     seconds
+  */
+uint32_t sys_clock_get_sync_interval(void)
+{
+  return dwSyncIntervalSec;
+}
+
+
+/**
+  * @brief      sync attempt failed (timeout / no reply)
+  * @return     seconds until retry
+  * @note       interval restarts from minimum, retry delay doubles on
+  *             every failure in a row (SYS_CLOCK_RETRY_MIN_SEC ~ minimum).
+  */
+uint32_t sys_clock_sync_failed(void)
+{
+  dwSyncIntervalSec = dwSyncMinSec;
+
+  dwSyncRetrySec = (dwSyncRetrySec) ? (dwSyncRetrySec * 2) : SYS_CLOCK_RETRY_MIN_SEC;
+  if(dwSyncRetrySec > dwSyncMinSec)
+    dwSyncRetrySec = dwSyncMinSec;
+
+  return dwSyncRetrySec;
+}
+
+
+/**
+  * @brief      estimated crystal drift
+  * @return     ppb (+ : local clock is slow and is advanced)
+  */
+int32_t sys_clock_get_drift_ppb(void)
+{
+  return lDriftPpb;
+}
+
+
+/**
+  * @brief      restore drift estimation (e.g. from previous run)
+  */
+void sys_clock_set_drift_ppb(int32_t lDrift)
+{
+  sys_clock_rebase();
+  noInterrupts();
+  lDriftPpb = lDrift;
+  interrupts();
+}
+
+
+/**
+  * @brief      current UTC time in milliseconds
+  */
+uint64_t sys_clock_now_ms(void)
+{
+  uint64_t qwRef;
+  uint32_t dwRef;
+  int32_t  lDrift, lSlew;
+  uint32_t dwElapsed;
+
+  noInterrupts();
+  qwRef   = qwRefUtcMs;
+  dwRef   = dwRefMillis;
+  lDrift  = lDriftPpb;
+  lSlew   = lSlewMs;
+  interrupts();
+
+  dwElapsed = millis() - dwRef;
+
+  return (uint64_t)((int64_t)qwRef + dwElapsed + sys_clock_correction(dwElapsed, lDrift, lSlew, NULL));
+}
+
+
+/**
+  * @brief      current local time (UTC + time zone) in seconds
+  * @note       drop-in for NTPClient::getEpochTime()
+  */
+uint32_t sys_clock_get_epoch(void)
+{
+  return (uint32_t)(sys_clock_now_ms() / 1000) + lTzOffsetSec;
+}
+
+
+/**
+  * @brief      sub-second part of current time (0 ~ 999)
+  */
+uint16_t sys_clock_get_millis(void)
+{
+  return (uint16_t)(sys_clock_now_ms() % 1000);
+}
+
+
+/**
+  * @brief      day of week of local time
+  * @return     0 : SUN ~ 6 : SAT (same as NTPClient::getDay())
+  */
+uint8_t sys_clock_get_day(void)
+{
+  return (uint8_t)(((sys_clock_get_epoch() / 86400L) + 4) % 7);   // 1970-01-01 is THU
+}
@@ -0,0 +1,78 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : sys_clock.h
+  * @brief          : Header for sys_clock.c file.
+  *                   local time base with millisecond resolution
+  ******************************************************************************
+  * @attention
+  *
+  *   keeps UTC in milliseconds as (reference time @ reference millis()).
+  *   NTP result is applied as an offset, so sub-second phase is preserved.
+  *
+  *   clock discipline :
+  *     - crystal drift (ppb) is estimated from successive sync results
+  *       and compensated continuously.
+  *     - small offsets are slewed (max. SYS_CLOCK_SLEW_MAX_PPM), large
+  *       offsets are stepped.
+  *     - sync interval doubles while offset stays small, up to the limit.
+  *     - failed sync falls back to the minimum interval and retries after
+  *       a short backoff (SYS_CLOCK_RETRY_MIN_SEC, doubled per failure).
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SYS_CLOCK_H__
+#define __SYS_CLOCK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define SYS_CLOCK_REBASE_MS           600000UL    // re-anchor before millis() wraps (49 days)
+
+#define SYS_CLOCK_STEP_THRESHOLD_MS   1000        // step instead of slew above this
+#define SYS_CLOCK_SLEW_MAX_PPM        5000        // 5 ms per second
+#define SYS_CLOCK_DRIFT_MAX_PPB       1000000L    // +-1000 ppm, clamp of estimation
+#define SYS_CLOCK_DRIFT_MIN_SPAN_MS   300000UL    // shorter span is too noisy for drift estimation
+#define SYS_CLOCK_STABLE_MS           50          // offset below this : interval x2
+#define SYS_CLOCK_UNSTABLE_MS         200         // offset above this : interval /2
+#define SYS_CLOCK_RETRY_MIN_SEC       60          // first retry after a failed sync
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      sys_clock_init(int32_t lTimeZoneOffset);
+void      sys_clock_update(void);
+
+void      sys_clock_set_ms(uint64_t qwUtcMs);
+void      sys_clock_apply_offset(int64_t qOffsetMs);
+uint8_t   sys_clock_is_set(void);
+
+void      sys_clock_discipline(int64_t qOffsetMs);
+void      sys_clock_set_sync_limits(uint32_t dwMinSec, uint32_t dwMaxSec);
+uint32_t  sys_clock_get_sync_interval(void);
+uint32_t  sys_clock_sync_failed(void);
+int32_t   sys_clock_get_drift_ppb(void);
+void      sys_clock_set_drift_ppb(int32_t lDrift);
+
+uint64_t  sys_clock_now_ms(void);
+uint32_t  sys_clock_get_epoch(void);
+uint16_t  sys_clock_get_millis(void);
+uint8_t   sys_clock_get_day(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SYS_CLOCK_H__ */
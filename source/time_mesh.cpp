@@ -0,0 +1,383 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : time_mesh.cpp
+  * @brief          : LAN time sharing between clocks (one NTP client per site)
+  ******************************************************************************
+  * @attention
+  *
+  *   packet (32 bytes, little endian : every node is ESP8266) :
+  *     BEACON  leader -> broadcast     T2 : leader time
+  *     REQ     follower -> leader      T1 : follower transmit
+  *     RESP    leader -> follower      T1 : echo, T2 : leader receive,
+  *                                     T3 : leader transmit
+  *
+  *     offset = ((T2 - T1) + (T3 - T4)) / 2
+  *     delay  =  (T4 - T1) - (T3 - T2)
+  *
+  *   poll delay of leader is inside (T3 - T2) and cancels out. poll delay of
+  *   follower is part of delay, keep polling period short while busy.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "time_mesh.h"
+#include "sys_clock.h"
+
+/* Defines -------------------------------------------------------------------*/
+#define TIME_MESH_TYPE_BEACON         1
+#define TIME_MESH_TYPE_REQ            2
+#define TIME_MESH_TYPE_RESP           3
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+typedef struct __attribute__((packed)) {
+  uint16_t    wMagic;           // TIME_MESH_MAGIC
+  uint8_t     bType;
+  uint8_t     bSeq;             // request tag
+  uint32_t    dwNodeId;         // sender
+  uint64_t    qwT1;
+  uint64_t    qwT2;
+  uint64_t    qwT3;
+} time_mesh_pkt_t;
+
+/* Variables -----------------------------------------------------------------*/
+static UDP                *pMeshUdp             = NULL;
+static uint32_t           dwMeshNodeId          = 0;
+static uint8_t            bMeshRole             = TIME_MESH_ROLE_NONE;
+
+static uint8_t            bMeshNtpSynced        = 0;    // own NTP sync is fresh
+static uint32_t           dwMeshNtpSyncMs       = 0;
+
+static uint8_t            bMeshLeaderValid      = 0;
+static uint32_t           dwMeshLeaderId        = 0;
+static IPAddress          meshLeaderIp;
+static uint32_t           dwMeshLeaderSeenMs    = 0;
+static uint32_t           dwMeshNoLeaderMs      = 0;    // start of hold-off
+static uint8_t            bMeshHoldoffDone      = 0;
+
+static uint32_t           dwMeshBeaconMs        = 0;
+static uint8_t            bMeshBeaconNow        = 0;
+
+static uint8_t            bMeshPending          = 0;
+static uint8_t            bMeshSeq              = 0;
+static uint64_t           qwMeshT1              = 0;
+static uint32_t           dwMeshSentMs          = 0;
+static time_mesh_result_t meshResult            = {0};
+
+/* Function prototypes -------------------------------------------------------*/
+static uint32_t time_mesh_holdoff_ms(void);
+static uint8_t  time_mesh_on_beacon(const time_mesh_pkt_t *pPkt, uint32_t dwNow);
+static void     time_mesh_on_request(time_mesh_pkt_t *pPkt, uint64_t qwRx);
+static uint8_t  time_mesh_on_response(const time_mesh_pkt_t *pPkt, uint64_t qwRx);
+static void     time_mesh_send_beacon(void);
+
+/* User code -----------------------------------------------------------------*/
+
+/**
+  * @brief      open socket & start listening for a leader
+  * @param      pUdp      UDP instance (not shared with NTP)
+  * @param      dwNodeId  unique id of this clock (e.g. ESP.getChipId())
+  * @return     none
+  */
+void time_mesh_init(UDP *pUdp, uint32_t dwNodeId)
+{
+  pMeshUdp          = pUdp;
+  dwMeshNodeId      = dwNodeId;
+  bMeshRole         = TIME_MESH_ROLE_NONE;
+  bMeshLeaderValid  = 0;
+  bMeshNtpSynced    = 0;
+  bMeshPending      = 0;
+  bMeshHoldoffDone  = 0;
+  dwMeshNoLeaderMs  = millis();
+
+  pMeshUdp->begin(TIME_MESH_PORT);
+}
+
+
+/**
+  * @brief      receive packets, run election, send beacon
+  * @return     TIME_MESH_xxx
+  * @note       poll from loop()
+  */
+uint8_t time_mesh_process(void)
+{
+  time_mesh_pkt_t pkt;
+  uint32_t        dwNow   = millis();
+  uint8_t         bResult = TIME_MESH_IDLE;
+  uint8_t         bRes;
+
+  if(NULL == pMeshUdp)
+    return TIME_MESH_IDLE;
+
+  // leader is gone : hold-off starts again
+  if( bMeshLeaderValid && ((dwNow - dwMeshLeaderSeenMs) > TIME_MESH_LOST_MS) )
+  {
+    bMeshLeaderValid  = 0;
+    dwMeshNoLeaderMs  = dwNow;
+    bMeshHoldoffDone  = 0;
+    bResult           = TIME_MESH_SYNC_REQ;
+  }
+
+  while(pMeshUdp->parsePacket() >= (int)sizeof(pkt))
+  {
+    uint64_t qwRx = sys_clock_now_ms();     // take receive time first
+
+    pMeshUdp->read((uint8_t *)&pkt, sizeof(pkt));
+    if( (TIME_MESH_MAGIC != pkt.wMagic) || (dwMeshNodeId == pkt.dwNodeId) )
+      continue;
+
+    switch(pkt.bType)
+    {
+      case TIME_MESH_TYPE_BEACON:
+        if(time_mesh_on_beacon(&pkt, dwNow))
+          bResult = TIME_MESH_SYNC_REQ;
+        break;
+
+      case TIME_MESH_TYPE_REQ:
+        time_mesh_on_request(&pkt, qwRx);
+        break;
+
+      case TIME_MESH_TYPE_RESP:
+        bRes = time_mesh_on_response(&pkt, qwRx);
+        if(TIME_MESH_IDLE != bRes)
+          bResult = bRes;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  // no answer
+  if( bMeshPending && ((dwNow - dwMeshSentMs) > TIME_MESH_TIMEOUT_MS) )
+  {
+    bMeshPending  = 0;
+    bResult       = TIME_MESH_TIMEOUT;
+  }
+
+  // NTP of this node has failed for too long : do not lead
+  if( bMeshNtpSynced && ((dwNow - dwMeshNtpSyncMs) > TIME_MESH_NTP_STALE_MS) )
+    bMeshNtpSynced = 0;
+
+  // election
+  if( bMeshNtpSynced && ((!bMeshLeaderValid) || (dwMeshLeaderId > dwMeshNodeId)) )
+    bMeshRole = TIME_MESH_ROLE_LEADER;
+  else
+    bMeshRole = bMeshLeaderValid ? TIME_MESH_ROLE_FOLLOWER : TIME_MESH_ROLE_NONE;
+
+  if(TIME_MESH_ROLE_LEADER == bMeshRole)
+  {
+    if( bMeshBeaconNow || ((dwNow - dwMeshBeaconMs) >= TIME_MESH_BEACON_MS) )
+      time_mesh_send_beacon();
+  }
+  else if( (TIME_MESH_ROLE_NONE == bMeshRole) && (!bMeshHoldoffDone) &&
+           ((dwNow - dwMeshNoLeaderMs) >= time_mesh_holdoff_ms()) )
+  {
+    // nobody leads : this node may ask NTP now
+    bMeshHoldoffDone  = 1;
+    bResult           = TIME_MESH_SYNC_REQ;
+  }
+
+  if( bMeshPending && (TIME_MESH_IDLE == bResult) )
+    bResult = TIME_MESH_BUSY;
+
+  return bResult;
+}
+
+
+/**
+  * @brief      send time request to leader
+  * @return     0 : no leader / busy / send failed, 1 : sent
+  */
+uint8_t time_mesh_request(void)
+{
+  time_mesh_pkt_t pkt;
+
+  if( (NULL == pMeshUdp) || bMeshPending || (TIME_MESH_ROLE_FOLLOWER != bMeshRole) )
+    return 0;
+
+  memset(&pkt, 0, sizeof(pkt));
+  pkt.wMagic    = TIME_MESH_MAGIC;
+  pkt.bType     = TIME_MESH_TYPE_REQ;
+  pkt.bSeq      = ++bMeshSeq;
+  pkt.dwNodeId  = dwMeshNodeId;
+  pkt.qwT1      = sys_clock_now_ms();
+
+  pMeshUdp->beginPacket(meshLeaderIp, TIME_MESH_PORT);
+  pMeshUdp->write((const uint8_t *)&pkt, sizeof(pkt));
+  if(!pMeshUdp->endPacket())
+    return 0;
+
+  qwMeshT1      = pkt.qwT1;
+  dwMeshSentMs  = millis();
+  bMeshPending  = 1;
+  return 1;
+}
+
+
+/**
+  * @brief      exchange with leader is in flight
+  */
+uint8_t time_mesh_is_busy(void)
+{
+  return bMeshPending;
+}
+
+
+/**
+  * @brief      this node is synced by NTP (may lead)
+  */
+void time_mesh_ntp_done(void)
+{
+  bMeshNtpSynced  = 1;
+  dwMeshNtpSyncMs = millis();
+  bMeshBeaconNow  = 1;      // followers get new time at once
+}
+
+
+/**
+  * @brief      follower of a live leader : sync by time_mesh_request(), not NTP
+  */
+uint8_t time_mesh_has_leader(void)
+{
+  return (TIME_MESH_ROLE_FOLLOWER == bMeshRole);
+}
+
+
+/**
+  * @brief      NTP may be asked by this node
+  * @return     1 : leader / own NTP sync is fresh / hold-off is over without leader
+  */
+uint8_t time_mesh_ntp_allowed(void)
+{
+  if(TIME_MESH_ROLE_FOLLOWER == bMeshRole)
+    return 0;
+
+  return ( (TIME_MESH_ROLE_LEADER == bMeshRole) || bMeshNtpSynced || bMeshHoldoffDone );
+}
+
+
+/**
+  * @brief      current role (TIME_MESH_ROLE_xxx)
+  */
+uint8_t time_mesh_get_role(void)
+{
+  return bMeshRole;
+}
+
+
+/**
+  * @brief      result of last exchange
+  */
+const time_mesh_result_t *time_mesh_get_result(void)
+{
+  return &meshResult;
+}
+
+
+/**
+  * @brief      wait before asking NTP without leader, spread by node id
+  */
+static uint32_t time_mesh_holdoff_ms(void)
+{
+  return TIME_MESH_LISTEN_MS + ((dwMeshNodeId % TIME_MESH_HOLDOFF_SLOTS) * TIME_MESH_HOLDOFF_SLOT_MS);
+}
+
+
+/**
+  * @brief      beacon : keep lowest id as leader
+  * @return     1 : leader is changed (sync now)
+  */
+static uint8_t time_mesh_on_beacon(const time_mesh_pkt_t *pPkt, uint32_t dwNow)
+{
+  uint8_t bNew;
+
+  if( bMeshLeaderValid && (pPkt->dwNodeId > dwMeshLeaderId) )
+    return 0;
+
+  bNew                = (!bMeshLeaderValid) || (pPkt->dwNodeId != dwMeshLeaderId);
+  bMeshLeaderValid    = 1;
+  dwMeshLeaderId      = pPkt->dwNodeId;
+  meshLeaderIp        = pMeshUdp->remoteIP();
+  dwMeshLeaderSeenMs  = dwNow;
+
+  // higher id than this leader : this node keeps leading, nothing to sync
+  return ( bNew && ((!bMeshNtpSynced) || (pPkt->dwNodeId < dwMeshNodeId)) );
+}
+
+
+/**
+  * @brief      request : answer when leading
+  */
+static void time_mesh_on_request(time_mesh_pkt_t *pPkt, uint64_t qwRx)
+{
+  if(TIME_MESH_ROLE_LEADER != bMeshRole)
+    return;
+
+  pPkt->bType     = TIME_MESH_TYPE_RESP;
+  pPkt->dwNodeId  = dwMeshNodeId;
+  pPkt->qwT2      = qwRx;
+  pPkt->qwT3      = sys_clock_now_ms();
+
+  pMeshUdp->beginPacket(pMeshUdp->remoteIP(), pMeshUdp->remotePort());
+  pMeshUdp->write((const uint8_t *)pPkt, sizeof(*pPkt));
+  pMeshUdp->endPacket();
+}
+
+
+/**
+  * @brief      response : match to pending request & compute offset
+  * @return     TIME_MESH_DONE / TIME_MESH_TIMEOUT (too slow) / TIME_MESH_IDLE (stale)
+  */
+static uint8_t time_mesh_on_response(const time_mesh_pkt_t *pPkt, uint64_t qwRx)
+{
+  int64_t  T1, T2, T3, T4, qDelay;
+
+  if( (!bMeshPending) || (pPkt->bSeq != bMeshSeq) || (pPkt->qwT1 != qwMeshT1) )
+    return TIME_MESH_IDLE;
+
+  bMeshPending = 0;
+
+  T1 = (int64_t)qwMeshT1;
+  T2 = (int64_t)pPkt->qwT2;
+  T3 = (int64_t)pPkt->qwT3;
+  T4 = (int64_t)qwRx;
+
+  qDelay = (T4 - T1) - (T3 - T2);
+  if(qDelay < 0)
+    qDelay = 0;
+  if(qDelay > TIME_MESH_DELAY_MAX_MS)
+    return TIME_MESH_TIMEOUT;
+
+  meshResult.qOffsetMs  = ((T2 - T1) + (T3 - T4)) / 2;
+  meshResult.dwDelayMs  = (uint32_t)qDelay;
+  meshResult.dwLeaderId = pPkt->dwNodeId;
+
+  return TIME_MESH_DONE;
+}
+
+
+/**
+  * @brief      broadcast beacon (leader)
+  */
+static void time_mesh_send_beacon(void)
+{
+  time_mesh_pkt_t pkt;
+
+  memset(&pkt, 0, sizeof(pkt));
+  pkt.wMagic    = TIME_MESH_MAGIC;
+  pkt.bType     = TIME_MESH_TYPE_BEACON;
+  pkt.dwNodeId  = dwMeshNodeId;
+  pkt.qwT2      = sys_clock_now_ms();
+
+  pMeshUdp->beginPacket(IPAddress(255, 255, 255, 255), TIME_MESH_PORT);
+  pMeshUdp->write((const uint8_t *)&pkt, sizeof(pkt));
+  pMeshUdp->endPacket();
+
+  dwMeshBeaconMs  = millis();
+  bMeshBeaconNow  = 0;
+}
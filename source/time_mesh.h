@@ -0,0 +1,87 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : time_mesh.h
+  * @brief          : Header for time_mesh.cpp file.
+  *                   LAN time sharing between clocks (one NTP client per site)
+  ******************************************************************************
+  * @attention
+  *
+  *   leader   : synced by NTP, broadcasts beacon every TIME_MESH_BEACON_MS
+  *              and answers time requests of followers.
+  *   follower : hears a beacon, then syncs by 2-way exchange with leader
+  *              (same on-wire calculation as NTP, LAN round-trip only).
+  *              NTP is used only while no leader is heard.
+  *
+  *   election : node with NTP sync and lowest node id leads. leader hearing
+  *              a lower id steps down. without leader, NTP is allowed after a
+  *              hold-off of (id % TIME_MESH_HOLDOFF_SLOTS) slots : after a
+  *              site-wide power restore, first node asks NTP & starts to
+  *              beacon, others follow before their hold-off is over.
+  *
+  *   time_mesh_process() is polled from a task (short period, receive time
+  *   stamps are taken on poll).
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TIME_MESH_H__
+#define __TIME_MESH_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <Arduino.h>
+#include <Udp.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define TIME_MESH_PORT                12123
+#define TIME_MESH_MAGIC               0x4D54      // "TM"
+#define TIME_MESH_BEACON_MS           10000
+#define TIME_MESH_LOST_MS             35000       // no beacon : leader is gone
+#define TIME_MESH_LISTEN_MS           12000       // hold-off base, > 1 beacon period
+#define TIME_MESH_HOLDOFF_SLOTS       8
+#define TIME_MESH_HOLDOFF_SLOT_MS     5000
+#define TIME_MESH_TIMEOUT_MS          500
+#define TIME_MESH_DELAY_MAX_MS        200         // slower exchange is discarded
+#define TIME_MESH_NTP_STALE_MS        86400000UL  // leader without NTP sync for 1 day steps down
+
+/*** role ***/
+#define TIME_MESH_ROLE_NONE           0           // no leader heard
+#define TIME_MESH_ROLE_FOLLOWER       1
+#define TIME_MESH_ROLE_LEADER         2
+
+/*** time_mesh_process() result ***/
+#define TIME_MESH_IDLE                0
+#define TIME_MESH_BUSY                1           // waiting for response
+#define TIME_MESH_DONE                2           // offset / delay is valid
+#define TIME_MESH_TIMEOUT             3
+#define TIME_MESH_SYNC_REQ            4           // leader found / lost / hold-off over : sync now
+
+/* Macros --------------------------------------------------------------------*/
+
+/* Types ---------------------------------------------------------------------*/
+
+/**
+  * @brief      result of last exchange with leader
+  */
+typedef struct {
+  int64_t     qOffsetMs;        // leader time - local time
+  uint32_t    dwDelayMs;        // round-trip delay
+  uint32_t    dwLeaderId;
+} time_mesh_result_t;
+
+/* Variables -----------------------------------------------------------------*/
+
+/* Functions prototypes ------------------------------------------------------*/
+void      time_mesh_init(UDP *pUdp, uint32_t dwNodeId);
+uint8_t   time_mesh_process(void);
+uint8_t   time_mesh_request(void);
+uint8_t   time_mesh_is_busy(void);
+void      time_mesh_ntp_done(void);
+uint8_t   time_mesh_has_leader(void);
+uint8_t   time_mesh_ntp_allowed(void);
+uint8_t   time_mesh_get_role(void);
+const time_mesh_result_t *time_mesh_get_result(void);
+
+#endif /* __TIME_MESH_H__ */